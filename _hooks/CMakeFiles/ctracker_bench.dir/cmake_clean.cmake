@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/ctracker_bench.dir/ctracker_bench.cpp.o"
+  "CMakeFiles/ctracker_bench.dir/ctracker_bench.cpp.o.d"
+  "ctracker_bench"
+  "ctracker_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/ctracker_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
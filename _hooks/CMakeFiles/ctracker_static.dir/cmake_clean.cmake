@@ -0,0 +1,53 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/ctracker_static.dir/ctracker.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_age.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_age.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_alignment.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_alignment.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_callsite.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_callsite.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_churn.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_churn.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_config.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_config.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_context.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_context.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_crash.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_crash.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_epoch.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_epoch.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_export.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_export.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_index.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_index.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_latency.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_latency.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_malloc.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_malloc.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_occupancy.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_occupancy.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_pagemap.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_pagemap.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_quarantine.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_quarantine.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_region.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_region.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_sampling.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_sampling.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_sharing.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_sharing.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_skiplist.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_skiplist.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_tree.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_tree.cpp.o.d"
+  "CMakeFiles/ctracker_static.dir/ctracker_types.cpp.o"
+  "CMakeFiles/ctracker_static.dir/ctracker_types.cpp.o.d"
+  "libctracker.a"
+  "libctracker.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/ctracker_static.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,53 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/ctracker_hooked.dir/ctracker.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_age.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_age.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_alignment.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_alignment.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_callsite.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_callsite.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_churn.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_churn.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_config.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_config.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_context.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_context.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_crash.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_crash.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_epoch.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_epoch.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_export.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_export.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_index.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_index.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_latency.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_latency.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_malloc.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_malloc.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_occupancy.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_occupancy.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_pagemap.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_pagemap.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_quarantine.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_quarantine.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_region.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_region.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_sampling.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_sampling.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_sharing.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_sharing.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_skiplist.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_skiplist.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_tree.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_tree.cpp.o.d"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_types.cpp.o"
+  "CMakeFiles/ctracker_hooked.dir/ctracker_types.cpp.o.d"
+  "libctracker_hooked.a"
+  "libctracker_hooked.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/ctracker_hooked.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,40 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/ctracker.cpp" "CMakeFiles/ctracker_static.dir/ctracker.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker.cpp.o.d"
+  "/root/repo/ctracker_age.cpp" "CMakeFiles/ctracker_static.dir/ctracker_age.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_age.cpp.o.d"
+  "/root/repo/ctracker_alignment.cpp" "CMakeFiles/ctracker_static.dir/ctracker_alignment.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_alignment.cpp.o.d"
+  "/root/repo/ctracker_callsite.cpp" "CMakeFiles/ctracker_static.dir/ctracker_callsite.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_callsite.cpp.o.d"
+  "/root/repo/ctracker_churn.cpp" "CMakeFiles/ctracker_static.dir/ctracker_churn.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_churn.cpp.o.d"
+  "/root/repo/ctracker_config.cpp" "CMakeFiles/ctracker_static.dir/ctracker_config.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_config.cpp.o.d"
+  "/root/repo/ctracker_context.cpp" "CMakeFiles/ctracker_static.dir/ctracker_context.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_context.cpp.o.d"
+  "/root/repo/ctracker_crash.cpp" "CMakeFiles/ctracker_static.dir/ctracker_crash.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_crash.cpp.o.d"
+  "/root/repo/ctracker_epoch.cpp" "CMakeFiles/ctracker_static.dir/ctracker_epoch.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_epoch.cpp.o.d"
+  "/root/repo/ctracker_export.cpp" "CMakeFiles/ctracker_static.dir/ctracker_export.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_export.cpp.o.d"
+  "/root/repo/ctracker_index.cpp" "CMakeFiles/ctracker_static.dir/ctracker_index.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_index.cpp.o.d"
+  "/root/repo/ctracker_latency.cpp" "CMakeFiles/ctracker_static.dir/ctracker_latency.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_latency.cpp.o.d"
+  "/root/repo/ctracker_malloc.cpp" "CMakeFiles/ctracker_static.dir/ctracker_malloc.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_malloc.cpp.o.d"
+  "/root/repo/ctracker_occupancy.cpp" "CMakeFiles/ctracker_static.dir/ctracker_occupancy.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_occupancy.cpp.o.d"
+  "/root/repo/ctracker_pagemap.cpp" "CMakeFiles/ctracker_static.dir/ctracker_pagemap.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_pagemap.cpp.o.d"
+  "/root/repo/ctracker_quarantine.cpp" "CMakeFiles/ctracker_static.dir/ctracker_quarantine.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_quarantine.cpp.o.d"
+  "/root/repo/ctracker_region.cpp" "CMakeFiles/ctracker_static.dir/ctracker_region.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_region.cpp.o.d"
+  "/root/repo/ctracker_sampling.cpp" "CMakeFiles/ctracker_static.dir/ctracker_sampling.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_sampling.cpp.o.d"
+  "/root/repo/ctracker_sharing.cpp" "CMakeFiles/ctracker_static.dir/ctracker_sharing.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_sharing.cpp.o.d"
+  "/root/repo/ctracker_skiplist.cpp" "CMakeFiles/ctracker_static.dir/ctracker_skiplist.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_skiplist.cpp.o.d"
+  "/root/repo/ctracker_tree.cpp" "CMakeFiles/ctracker_static.dir/ctracker_tree.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_tree.cpp.o.d"
+  "/root/repo/ctracker_types.cpp" "CMakeFiles/ctracker_static.dir/ctracker_types.cpp.o" "gcc" "CMakeFiles/ctracker_static.dir/ctracker_types.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,16 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo
+# Build directory: /root/repo/_rel
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(ctracker_test "/root/repo/_rel/ctracker_test" "--gtest_filter=-CTrackerTest.RecordsAreSortedByAddress:CTrackerTest.RecordsCarryTheirCallSite")
+set_tests_properties(ctracker_test PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;96;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(ctracker_test_list "/root/repo/_rel/ctracker_test")
+set_tests_properties(ctracker_test_list PROPERTIES  ENVIRONMENT "CTRACKER_REGISTRY=list" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;97;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(ctracker_test_tree "/root/repo/_rel/ctracker_test")
+set_tests_properties(ctracker_test_tree PROPERTIES  ENVIRONMENT "CTRACKER_REGISTRY=tree" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;99;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(ctracker_test_pagemap "/root/repo/_rel/ctracker_test" "--gtest_filter=-CTrackerTest.RecordsAreSortedByAddress:CTrackerTest.RecordsCarryTheirCallSite")
+set_tests_properties(ctracker_test_pagemap PROPERTIES  ENVIRONMENT "CTRACKER_REGISTRY=pagemap" _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;101;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(ctracker_test_hooks "/root/repo/_rel/ctracker_hooked_test" "--gtest_filter=-CTrackerTest.RecordsAreSortedByAddress:CTrackerTest.RecordsCarryTheirCallSite")
+set_tests_properties(ctracker_test_hooks PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;122;add_test;/root/repo/CMakeLists.txt;0;")
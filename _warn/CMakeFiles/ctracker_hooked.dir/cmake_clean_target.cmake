@@ -0,0 +1,3 @@
+file(REMOVE_RECURSE
+  "libctracker_hooked.a"
+)
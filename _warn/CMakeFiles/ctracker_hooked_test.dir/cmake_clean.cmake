@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/ctracker_hooked_test.dir/ctracker_test.cpp.o"
+  "CMakeFiles/ctracker_hooked_test.dir/ctracker_test.cpp.o.d"
+  "ctracker_hooked_test"
+  "ctracker_hooked_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/ctracker_hooked_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,1706 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <new>
+#include <optional>
+#include <unistd.h>
+
+namespace ctracker
+{
+namespace detail
+{
+
+std::atomic<bool> enabled(true);
+std::atomic<unsigned> session(0);
+HotCounters counters;
+std::atomic<size_t> sample_interval(1);
+
+thread_local bool lock_tracker = false;
+thread_local size_t sample_countdown = 0;
+thread_local uint64_t current_context = 0;
+
+std::atomic<uint64_t> hook_cycles[kCycleBuckets];
+std::atomic<uint64_t> hook_cycles_total(0);
+thread_local uint32_t cycle_countdown = 0;
+
+SkippedBlocks skipped_blocks;
+
+void NoteSkipped(const void *ptr)
+{
+    skipped_blocks.Note(ptr);
+}
+
+void ForgetSkipped(const void *ptr)
+{
+    skipped_blocks.Forget(ptr);
+}
+
+void RecordHookCycles(uint64_t cycles)
+{
+    size_t bucket = 63 - static_cast<size_t>(__builtin_clzll(cycles | 1));
+    if (bucket >= kCycleBuckets)
+    {
+        bucket = kCycleBuckets - 1;
+    }
+    hook_cycles[bucket].fetch_add(1, std::memory_order_relaxed);
+    hook_cycles_total.fetch_add(cycles, std::memory_order_relaxed);
+    if (overhead_budget_permille.load(std::memory_order_relaxed))
+    {
+        AdaptSampling();
+    }
+}
+
+void TimedMutex::LockSlow()
+{
+    uint64_t start = MonotonicNs();
+    mutex_.lock();
+    contended_++;
+    wait_ns_ += MonotonicNs() - start;
+}
+
+} // namespace detail
+
+// Small per-thread IDs for records and latency slots
+static std::atomic<uint32_t> next_thread_id(1);
+static thread_local uint32_t thread_id = 0;
+
+uint32_t CurrentThreadId()
+{
+    if (!thread_id)
+    {
+        thread_id = next_thread_id.fetch_add(1, std::memory_order_relaxed);
+    }
+    return thread_id;
+}
+
+} // namespace ctracker
+
+using ctracker::detail::lock_tracker;
+
+// Holds the reentrancy guard for a scope, so nothing the tracker calls while
+// holding mutex_ (unwinder, handlers, visitors) is tracked or deadlocks. Also
+// covers direct calls to the public C*Track functions.
+struct ReentrancyGuard
+{
+    bool saved;
+
+    ReentrancyGuard() : saved(lock_tracker)
+    {
+        lock_tracker = true;
+    }
+    ~ReentrancyGuard()
+    {
+        lock_tracker = saved;
+    }
+};
+
+// This thread's most recent recorded allocation, the possible new buffer of a
+// container growth step if the next thing the thread does is free a smaller one
+struct GrowthState
+{
+    const void *last_ptr;
+    size_t last_size;
+    ctracker::CallSite *last_site;
+    const void *grown_ptr; // new buffer of the last step, to link chains
+};
+static thread_local GrowthState growth_state = {};
+
+
+static void FreeRecords(AllocationRecord *current)
+{
+    while (current)
+    {
+        AllocationRecord *next = current->next;
+        ctracker::detail::RawFree(current);
+        current = next;
+    }
+}
+
+// Internal singletons get static storage, so building the tracker inside the
+// first `operator new` can't fail on allocation.
+template <typename T, typename... Args>
+static T *ConstructOnce(Args... args)
+{
+    alignas(T) static unsigned char storage[sizeof(T)];
+    return new (storage) T(args...);
+}
+
+static void ToggleSignalHandler(int)
+{
+    if (CTrackerMetrics::IsEnabled())
+    {
+        CTrackerMetrics::Disable();
+    }
+    else
+    {
+        CTrackerMetrics::Enable();
+    }
+}
+
+static void WriteString(int fd, const char *text)
+{
+    size_t length = std::strlen(text);
+    while (length > 0)
+    {
+        ssize_t n = write(fd, text, length);
+        if (n <= 0)
+        {
+            return;
+        }
+        text += n;
+        length -= static_cast<size_t>(n);
+    }
+}
+
+static void WriteCallSite(int fd, const char *label, const ctracker::CallSite *site)
+{
+    if (!site || site->depth == 0)
+    {
+        return;
+    }
+    WriteString(fd, label);
+    backtrace_symbols_fd(site->frames, static_cast<int>(site->depth), fd);
+}
+
+static void PrintInvalidFree(const ctracker::InvalidFree &report)
+{
+    static const char *const kinds[] = {"free of untracked pointer", "double free", "free of interior pointer"};
+    char line[256];
+
+    std::snprintf(line, sizeof(line), "ctracker: %s %p\n", kinds[static_cast<int>(report.kind)], report.ptr);
+    WriteString(2, line);
+    WriteCallSite(2, "  freed at:\n", report.free_site);
+
+    if (report.kind != ctracker::InvalidFreeKind::Untracked)
+    {
+        std::snprintf(line, sizeof(line), "  block %p (%zu bytes)\n", report.block, report.block_size);
+        WriteString(2, line);
+        WriteCallSite(2, "  allocated at:\n", report.alloc_site);
+    }
+    if (report.previous_free_caller)
+    {
+        std::snprintf(line, sizeof(line), "  previously freed from %p\n", report.previous_free_caller);
+        WriteString(2, line);
+    }
+}
+
+// Runs on the first tracked allocation, so nothing here may use the heap.
+CTrackerMetrics::CTrackerMetrics()
+    : registry_session_(ctracker::detail::session.load(std::memory_order_acquire)),
+      config_(ctracker::LoadConfig()),
+      index_(ConstructOnce<ctracker::detail::PointerIndex>(config_.shards)),
+      tree_(config_.registry == ctracker::RegistryKind::Tree ? ConstructOnce<ctracker::detail::RecordTree>() : nullptr),
+      skiplist_(config_.registry == ctracker::RegistryKind::SkipList ? ConstructOnce<ctracker::detail::RecordSkipList>()
+                                                                     : nullptr),
+      pagemap_(config_.registry == ctracker::RegistryKind::PageMap ? ConstructOnce<ctracker::detail::RecordPageMap>()
+                                                                   : nullptr),
+      sites_(ConstructOnce<ctracker::detail::CallSiteTable>()),
+      quarantine_(ConstructOnce<ctracker::detail::Quarantine>()),
+      regions_(ConstructOnce<ctracker::detail::RegionMap>()),
+      contexts_(ConstructOnce<ctracker::detail::ContextTable>()),
+      ages_(ConstructOnce<ctracker::detail::AgeTable>(config_.age_epoch_ms)),
+      churn_(ConstructOnce<ctracker::detail::ChurnTable>()),
+      occupancy_(ConstructOnce<ctracker::detail::OccupancyMap>()),
+      invalid_free_handler_(PrintInvalidFree),
+      invalid_free_stats_(),
+      realloc_stats_(),
+      region_stats_(),
+      since_startup_(config_.enabled),
+      full_coverage_(true),
+      free_check_(config_.free_check),
+      estimated_live_count_(0),
+      estimated_live_bytes_(0),
+      RecordsHead(nullptr), RecordsTail(nullptr)
+{
+    ctracker::detail::DetectGlibcChunks();
+    SetSampleInterval(config_.sample_interval);
+    occupancy_->SetEnabled(config_.occupancy_bitmap && !skiplist_);
+    if (!config_.enabled)
+    {
+        Disable();
+    }
+    if (config_.toggle_signal)
+    {
+        InstallToggleSignal(config_.toggle_signal);
+    }
+    if (config_.overhead_budget_permille)
+    {
+        SetOverheadBudget(config_.overhead_budget_permille);
+    }
+    if (config_.allocator_latency)
+    {
+        SetAllocatorLatency(true, config_.latency_outlier_ns);
+    }
+    if (config_.crash_dump_path[0])
+    {
+        // Opened now: nothing can be opened safely once the process is crashing
+        int fd = open(config_.crash_dump_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd >= 0)
+        {
+            ctracker::detail::InstallCrashDump(this, fd, config_.dump_signal);
+        }
+    }
+}
+
+ctracker::Config CTrackerMetrics::GetConfig() const
+{
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    ctracker::Config config = config_;
+    config.enabled = IsEnabled();
+    config.sample_interval = SampleInterval();
+    return config;
+}
+
+CTrackerMetrics::~CTrackerMetrics()
+{
+    FreeRecords(RecordsHead);
+    index_->~PointerIndex();
+    sites_->~CallSiteTable();
+    quarantine_->~Quarantine();
+}
+
+bool CTrackerMetrics::InstallToggleSignal(int signo)
+{
+    struct sigaction action = {};
+    action.sa_handler = ToggleSignalHandler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    return signo > 0 && sigaction(signo, &action, nullptr) == 0;
+}
+
+// Must hold mutex_, outside any epoch guard. Frees were not tracked while
+// disabled, so once tracking is re-enabled the old records may describe memory
+// that has been freed and reused.
+void CTrackerMetrics::SyncSession()
+{
+    unsigned current = ctracker::detail::session.load(std::memory_order_acquire);
+    if (registry_session_.load(std::memory_order_relaxed) == current)
+    {
+        return;
+    }
+
+    if (skiplist_)
+    {
+        // Skip list writers don't take mutex_ (see EnterWriter). New ones now
+        // see the stale session and queue on the lock; wait out the rest.
+        ctracker::detail::Synchronize();
+        ctracker::detail::EpochGuard epoch;
+        skiplist_->Purge([](AllocationRecord *record) { ctracker::detail::Retire(record); });
+    }
+
+    index_->Clear();
+    if (tree_)
+    {
+        tree_->Clear();
+    }
+    quarantine_->Clear();
+    ctracker::detail::skipped_blocks.Clear();
+    regions_->Clear();
+    contexts_->Clear();
+    ages_->Clear();
+    churn_->Clear();
+    occupancy_->Clear();
+    sites_->ResetLiveStats();
+    FreeRecords(RecordsHead);
+    if (pagemap_)
+    {
+        pagemap_->Clear([](AllocationRecord *record) { ctracker::detail::RawFree(record); });
+    }
+    RecordsHead = nullptr;
+    RecordsTail = nullptr;
+    RecordCount = 0;
+    estimated_live_count_ = 0;
+    estimated_live_bytes_ = 0;
+
+    // Anything allocated before this point is unknown to us
+    since_startup_ = false;
+    full_coverage_ = true;
+    registry_session_.store(current, std::memory_order_seq_cst);
+}
+
+// Skip list writers run without mutex_, inside an epoch guard entered before
+// the session check: SyncSession waits for every guard already open before it
+// clears anything, and writers arriving later see the stale session and catch
+// up under the lock first, outside the guard.
+void CTrackerMetrics::EnterWriter(ctracker::detail::EpochGuard &epoch)
+{
+    for (;;)
+    {
+        epoch.Enter();
+        if (registry_session_.load(std::memory_order_seq_cst) ==
+            ctracker::detail::session.load(std::memory_order_seq_cst))
+        {
+            return;
+        }
+        epoch.Leave();
+        std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+        SyncSession();
+    }
+}
+
+// Loads the config at startup even if nothing has allocated yet. Threads can't
+// be started from inside the first `operator new`, so the exporter starts here.
+static struct TrackerStartup
+{
+    TrackerStartup()
+    {
+        ctracker::detail::StartExporter(CTrackerMetrics::GetTracker()->GetConfig());
+    }
+} tracker_startup;
+
+CTrackerMetrics *CTrackerMetrics::GetTracker()
+{
+    // The instance is never destroyed: `operator delete` keeps being called by
+    // other translation units' static destructors after ours would have run.
+    alignas(CTrackerMetrics) static unsigned char storage[sizeof(CTrackerMetrics)];
+    static CTrackerMetrics *instance = new (storage) CTrackerMetrics();
+    return instance;
+}
+
+void CTrackerMetrics::CmallocTrack(void *ptr, size_t size, const void *caller, size_t alignment, size_t weight)
+{
+    if (!caller)
+    {
+        caller = __builtin_return_address(0);
+    }
+    ReentrancyGuard guard;
+
+    // Unwinding is the expensive part, so do it before taking the lock
+    void *frames[ctracker::kMaxStackDepth];
+    size_t depth = ctracker::detail::CaptureStack(frames, config_.stack_depth, caller);
+    ctracker::detail::PrepareCrashStack();
+
+    // We use the raw allocator here to avoid calling our own `operator new` (and malloc hooks)
+    AllocationRecord *newRecord = static_cast<AllocationRecord *>(ctracker::detail::RawMalloc(sizeof(AllocationRecord)));
+    if (!newRecord)
+    {
+        return;
+    }
+    newRecord->ptr = ptr;
+    newRecord->size = size;
+    newRecord->context = ctracker::CurrentContext();
+    newRecord->thread = ctracker::CurrentThreadId();
+    newRecord->alignment = static_cast<uint32_t>(alignment ? alignment : __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+    newRecord->weight = weight ? weight : 1;
+    newRecord->node = nullptr;
+
+    if (skiplist_)
+    {
+        newRecord->node = ctracker::detail::RecordSkipList::NewNode(ptr);
+        if (!newRecord->node)
+        {
+            ctracker::detail::RawFree(newRecord);
+            return;
+        }
+        ctracker::detail::EpochGuard epoch(false);
+        EnterWriter(epoch);
+        if (!IsEnabled())
+        {
+            ctracker::detail::RecordSkipList::DropNode(newRecord->node);
+            ctracker::detail::RawFree(newRecord);
+            return;
+        }
+        AddRecord(newRecord, frames, depth);
+        return;
+    }
+
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    if (!IsEnabled())
+    {
+        ctracker::detail::RawFree(newRecord);
+        return;
+    }
+    SyncSession();
+    AddRecord(newRecord, frames, depth);
+}
+
+// Under mutex_, or inside EnterWriter's guard with a skip list: everything
+// below synchronizes itself or uses atomic counters
+void CTrackerMetrics::AddRecord(AllocationRecord *record, void *const *frames, size_t depth)
+{
+    ctracker::CallSite *site = depth ? sites_->Intern(frames, depth) : nullptr;
+    uint32_t epoch = ages_->Now();
+    ctracker::ContextId context = record->context;
+    if (context && !contexts_->Add(context, record->size))
+    {
+        context = 0;
+    }
+    record->site = site;
+    record->context = context;
+    record->epoch = epoch;
+
+    size_t size = record->size;
+    bool sampled = record->weight != 1;
+    if (!LinkRecord(record))
+    {
+        if (context)
+        {
+            contexts_->Remove(context, size);
+        }
+        return;
+    }
+    if (site && ctracker::detail::AddRelaxed(site->allocations, 1) == 0)
+    {
+        __atomic_store_n(&site->first_epoch, epoch, __ATOMIC_RELAXED);
+    }
+
+    growth_state.last_ptr = record->ptr;
+    growth_state.last_size = size;
+    growth_state.last_site = site;
+    if (sampled && full_coverage_.load(std::memory_order_relaxed))
+    {
+        full_coverage_.store(false, std::memory_order_relaxed);
+    }
+}
+
+// Adds the record to the index and the ordered registry, and counts it. Under
+// mutex_, or inside EnterWriter's guard with a skip list, which is linked
+// before the index so that a free never finds a record the list lacks. If out
+// of memory the record is released and false returned.
+bool CTrackerMetrics::LinkRecord(AllocationRecord *record)
+{
+    if (skiplist_)
+    {
+        skiplist_->Insert(record->node, record);
+    }
+
+    AllocationRecord *stale;
+    if (!index_->Insert(record, &stale))
+    {
+        ReleaseRecord(record);
+        return false;
+    }
+    if (stale)
+    {
+        // Its free was never seen (e.g. released with free()), the address is being reused
+        if (stale->context)
+        {
+            contexts_->Remove(stale->context, stale->size);
+        }
+        UnlinkRecord(stale);
+        ReleaseRecord(stale);
+    }
+
+    if (!skiplist_ && !LinkOrdered(record))
+    {
+        index_->Remove(record->ptr);
+        ctracker::detail::RawFree(record);
+        return false;
+    }
+    ctracker::detail::AddRelaxed(RecordCount, 1);
+    ctracker::detail::AddRelaxed(estimated_live_count_, record->weight);
+    ctracker::detail::AddRelaxed(estimated_live_bytes_, record->size * record->weight);
+
+    if (record->site)
+    {
+        ctracker::detail::AddRelaxed(record->site->live_count, 1);
+        ctracker::detail::AddRelaxed(record->site->live_bytes, record->size);
+        ctracker::detail::AddRelaxed(record->site->estimated_live_bytes, record->size * record->weight);
+    }
+    ages_->Add(record->thread, record->epoch, record->size);
+    if (occupancy_->Enabled())
+    {
+        occupancy_->Add(record->ptr, record->size);
+    }
+    return true;
+}
+
+// Uncounts the record and takes it out of the ordered registry (a skip list
+// record leaves through ReleaseRecord), not the index or its context. Under
+// mutex_, or inside EnterWriter's guard with a skip list.
+void CTrackerMetrics::UnlinkRecord(AllocationRecord *record)
+{
+    ctracker::detail::SubRelaxed(estimated_live_count_, record->weight);
+    ctracker::detail::SubRelaxed(estimated_live_bytes_, record->size * record->weight);
+    if (record->site)
+    {
+        ctracker::detail::SubRelaxed(record->site->live_count, 1);
+        ctracker::detail::SubRelaxed(record->site->live_bytes, record->size);
+        ctracker::detail::SubRelaxed(record->site->estimated_live_bytes, record->size * record->weight);
+    }
+    ages_->Remove(record->thread, record->epoch, record->size);
+    if (occupancy_->Enabled())
+    {
+        occupancy_->Remove(record->ptr, record->size);
+    }
+
+    if (!skiplist_)
+    {
+        UnlinkOrdered(record);
+    }
+    ctracker::detail::SubRelaxed(RecordCount, 1);
+}
+
+// Must hold mutex_. List, tree and page map linking; false if out of memory.
+bool CTrackerMetrics::LinkOrdered(AllocationRecord *record)
+{
+    if (pagemap_)
+    {
+        return pagemap_->Insert(record);
+    }
+
+    // Maintain sorted order by address for easier fragmentation analysis
+    uintptr_t addr = reinterpret_cast<uintptr_t>(record->ptr);
+    AllocationRecord *prev = nullptr;
+
+    if (tree_)
+    {
+        prev = tree_->Insert(record);
+    }
+    else if (RecordsHead && reinterpret_cast<uintptr_t>(RecordsHead->ptr) <= addr)
+    {
+        prev = RecordsHead;
+        while (prev->next && reinterpret_cast<uintptr_t>(prev->next->ptr) < addr)
+        {
+            prev = prev->next;
+        }
+    }
+
+    record->prev = prev;
+    record->next = prev ? prev->next : RecordsHead;
+    if (record->next)
+    {
+        record->next->prev = record;
+    }
+    else
+    {
+        RecordsTail = record;
+    }
+    if (prev)
+    {
+        prev->next = record;
+    }
+    else
+    {
+        RecordsHead = record;
+    }
+    return true;
+}
+
+// Must hold mutex_
+void CTrackerMetrics::UnlinkOrdered(AllocationRecord *record)
+{
+    if (pagemap_)
+    {
+        pagemap_->Remove(record);
+        return;
+    }
+    if (tree_)
+    {
+        tree_->Remove(record);
+    }
+
+    if (record->prev)
+    {
+        record->prev->next = record->next;
+    }
+    else
+    {
+        RecordsHead = record->next;
+    }
+
+    if (record->next)
+    {
+        record->next->prev = record->prev;
+    }
+    else
+    {
+        RecordsTail = record->prev;
+    }
+}
+
+// Frees a record that is out of the index. A skip list record is taken out of
+// the list first, unless a session purge got there before, and only freed
+// once no reader can still hold it.
+void CTrackerMetrics::ReleaseRecord(AllocationRecord *record)
+{
+    if (!skiplist_)
+    {
+        ctracker::detail::RawFree(record);
+        return;
+    }
+    ctracker::detail::EpochGuard epoch;
+    if (skiplist_->Remove(record))
+    {
+        ctracker::detail::Retire(record);
+    }
+}
+
+bool CTrackerMetrics::CfreeTrack(void *ptr, const void *caller)
+{
+    if (!caller)
+    {
+        caller = __builtin_return_address(0);
+    }
+    ReentrancyGuard guard;
+
+    AllocationRecord *record;
+    if (skiplist_)
+    {
+        ctracker::detail::EpochGuard epoch(false);
+        EnterWriter(epoch);
+        if ((record = index_->Remove(ptr)))
+        {
+            ForgetRecord(record, caller);
+            ReleaseRecord(record);
+            return true;
+        }
+    }
+    else
+    {
+        std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+        SyncSession();
+        if ((record = index_->Remove(ptr)))
+        {
+            ForgetRecord(record, caller);
+            ctracker::detail::RawFree(record); // Free the record node
+            return true;
+        }
+    }
+    uintptr_t map_start;
+    size_t map_length;
+    if (ctracker::detail::MappedChunk(ptr, &map_start, &map_length) && CchunkFreeTrack(ptr))
+    {
+        return true;
+    }
+    return HandleUnknownFree(ptr, caller);
+}
+
+// A record just taken out of the index by a free. Under mutex_, or inside
+// EnterWriter's guard with a skip list.
+void CTrackerMetrics::ForgetRecord(AllocationRecord *record, const void *caller)
+{
+    // Freed in the age epoch it was allocated in or the next one, i.e.
+    // after less than two epochs: a churn pair candidate
+    uint32_t now = ages_->Now();
+    if (record->site && now - record->epoch <= 1)
+    {
+        churn_->Record(record->site, record->size, now);
+    }
+
+    // new-copy-delete: the buffer just allocated here replaces this one
+    if (record->site && growth_state.last_site == record->site && growth_state.last_ptr != record->ptr &&
+        ctracker::detail::IsGrowthStep(record->size, growth_state.last_size))
+    {
+        NoteGrowthStep(record->site, record->ptr, growth_state.last_ptr, record->size);
+    }
+    growth_state.last_site = nullptr;
+
+    if (record->context)
+    {
+        contexts_->Remove(record->context, record->size);
+    }
+    UnlinkRecord(record);
+    if (free_check_.load(std::memory_order_relaxed) != ctracker::FreeCheck::Off &&
+        full_coverage_.load(std::memory_order_relaxed))
+    {
+        quarantine_->Push({record->ptr, record->size, record->site, caller});
+    }
+}
+
+void CTrackerMetrics::CreallocTrack(void *old_ptr, void *new_ptr, size_t size, const void *caller)
+{
+    if (!caller)
+    {
+        caller = __builtin_return_address(0);
+    }
+    ReentrancyGuard guard;
+
+    // A block the guard kept out of the registry stays out when it moves
+    if (ctracker::detail::skipped_blocks.Forget(old_ptr))
+    {
+        ctracker::detail::skipped_blocks.Note(new_ptr);
+        return;
+    }
+
+    void *frames[ctracker::kMaxStackDepth];
+    size_t depth = ctracker::detail::CaptureStack(frames, config_.stack_depth, caller);
+
+    if (skiplist_)
+    {
+        // Lock-free readers may be on the record, so it is never changed in
+        // place: a copy with the new address and size replaces it
+        ctracker::detail::SkipNode *node = ctracker::detail::RecordSkipList::NewNode(new_ptr);
+        AllocationRecord *fresh = static_cast<AllocationRecord *>(ctracker::detail::RawMalloc(sizeof(AllocationRecord)));
+        AllocationRecord *record = nullptr;
+        ctracker::detail::EpochGuard epoch(false);
+        if (node && fresh && IsEnabled())
+        {
+            EnterWriter(epoch);
+            record = index_->Remove(old_ptr);
+        }
+        if (!record)
+        {
+            ctracker::detail::RecordSkipList::DropNode(node);
+            ctracker::detail::RawFree(fresh);
+            return;
+        }
+        *fresh = *record;
+        fresh->node = node;
+        MoveRecord(record, fresh, new_ptr, size, caller, frames, depth);
+        return;
+    }
+
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    if (!IsEnabled())
+    {
+        return;
+    }
+    SyncSession();
+
+    if (old_ptr != new_ptr)
+    {
+        AllocationRecord *record = index_->Remove(old_ptr);
+        if (record)
+        {
+            MoveRecord(record, record, new_ptr, size, caller, frames, depth);
+        }
+        return;
+    }
+
+    // Grown or shrunk where it is: the address order is unchanged, so only
+    // the size moves (under the shard lock, for concurrent SizeOf readers)
+    size_t old_size;
+    AllocationRecord *record = index_->Resize(old_ptr, size, &old_size);
+    if (!record)
+    {
+        return;
+    }
+    ctracker::detail::AddRelaxed(estimated_live_bytes_, (size - old_size) * record->weight);
+    if (record->site)
+    {
+        ctracker::detail::AddRelaxed(record->site->live_bytes, size - old_size);
+        ctracker::detail::AddRelaxed(record->site->estimated_live_bytes, (size - old_size) * record->weight);
+    }
+    if (record->context)
+    {
+        contexts_->Resize(record->context, old_size, size);
+    }
+    ages_->Resize(record->thread, record->epoch, old_size, size);
+    if (occupancy_->Enabled())
+    {
+        occupancy_->Remove(old_ptr, old_size);
+        occupancy_->Add(old_ptr, size);
+    }
+
+    ctracker::detail::AddRelaxed(realloc_stats_.in_place, 1);
+    ctracker::CallSite *site = depth ? sites_->Intern(frames, depth) : nullptr;
+    if (site)
+    {
+        ctracker::detail::AddRelaxed(site->reallocs_in_place, 1);
+    }
+}
+
+// Moves `old` (out of the index already) to `record`, the same record or, with
+// a skip list, its copy, at the new address and size. The record keeps its
+// original allocation site. Under mutex_, or inside EnterWriter's guard with a
+// skip list.
+void CTrackerMetrics::MoveRecord(AllocationRecord *old, AllocationRecord *record, void *new_ptr, size_t size,
+                                 const void *caller, void *const *frames, size_t depth)
+{
+    void *old_ptr = old->ptr;
+    size_t old_size = old->size;
+    UnlinkRecord(old);
+    if (old_ptr != new_ptr && free_check_.load(std::memory_order_relaxed) != ctracker::FreeCheck::Off &&
+        full_coverage_.load(std::memory_order_relaxed))
+    {
+        quarantine_->Push({old_ptr, old_size, old->site, caller});
+    }
+    if (old != record)
+    {
+        ReleaseRecord(old);
+    }
+
+    ctracker::ContextId context = record->context;
+    if (context)
+    {
+        contexts_->Resize(context, old_size, size);
+    }
+    record->ptr = new_ptr;
+    record->size = size;
+    if (!LinkRecord(record))
+    {
+        if (context)
+        {
+            contexts_->Remove(context, size);
+        }
+        return;
+    }
+
+    ctracker::CallSite *site = depth ? sites_->Intern(frames, depth) : nullptr;
+    if (old_ptr == new_ptr)
+    {
+        ctracker::detail::AddRelaxed(realloc_stats_.in_place, 1);
+        if (site)
+        {
+            ctracker::detail::AddRelaxed(site->reallocs_in_place, 1);
+        }
+        return;
+    }
+
+    size_t copied = old_size < size ? old_size : size;
+    ctracker::detail::AddRelaxed(realloc_stats_.moved, 1);
+    ctracker::detail::AddRelaxed(realloc_stats_.bytes_copied, copied);
+    if (site)
+    {
+        ctracker::detail::AddRelaxed(site->reallocs_moved, 1);
+        ctracker::detail::AddRelaxed(site->realloc_bytes_copied, copied);
+        if (ctracker::detail::IsGrowthStep(copied, size))
+        {
+            NoteGrowthStep(site, old_ptr, new_ptr, copied);
+        }
+    }
+}
+
+ctracker::ReallocStats CTrackerMetrics::GetReallocStats() const
+{
+    ctracker::ReallocStats stats;
+    stats.in_place = ctracker::detail::LoadRelaxed(realloc_stats_.in_place);
+    stats.moved = ctracker::detail::LoadRelaxed(realloc_stats_.moved);
+    stats.bytes_copied = ctracker::detail::LoadRelaxed(realloc_stats_.bytes_copied);
+    return stats;
+}
+
+void CTrackerMetrics::CmmapTrack(void *addr, size_t length, const void *caller)
+{
+    if (!caller)
+    {
+        caller = __builtin_return_address(0);
+    }
+    ReentrancyGuard guard;
+
+    void *frames[ctracker::kMaxStackDepth];
+    size_t depth = ctracker::detail::CaptureStack(frames, config_.stack_depth, caller);
+
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    if (!IsEnabled())
+    {
+        return;
+    }
+    SyncSession();
+
+    ctracker::CallSite *site = depth ? sites_->Intern(frames, depth) : nullptr;
+    if (regions_->Insert(reinterpret_cast<uintptr_t>(addr), length, site))
+    {
+        region_stats_.maps++;
+    }
+}
+
+void CTrackerMetrics::CmunmapTrack(void *addr, size_t length)
+{
+    ReentrancyGuard guard;
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    if (!IsEnabled())
+    {
+        return;
+    }
+    SyncSession();
+
+    size_t partial;
+    if (regions_->Remove(reinterpret_cast<uintptr_t>(addr), length, &partial))
+    {
+        region_stats_.unmaps++;
+        region_stats_.partial_unmaps += partial;
+    }
+}
+
+void CTrackerMetrics::CmremapTrack(void *old_addr, size_t old_length, void *new_addr, size_t new_length,
+                                   bool keep_old)
+{
+    ReentrancyGuard guard;
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    if (!IsEnabled())
+    {
+        return;
+    }
+    SyncSession();
+
+    // Like realloc, a region we never saw mapped stays untracked
+    const ctracker::detail::Region *region = regions_->Find(reinterpret_cast<uintptr_t>(old_addr));
+    if (!region)
+    {
+        return;
+    }
+    ctracker::CallSite *site = region->site;
+
+    if (!keep_old)
+    {
+        size_t partial;
+        regions_->Remove(reinterpret_cast<uintptr_t>(old_addr), old_length, &partial);
+    }
+    regions_->Insert(reinterpret_cast<uintptr_t>(new_addr), new_length, site);
+    region_stats_.remaps++;
+}
+
+void CTrackerMetrics::CchunkTrack(void *ptr, uintptr_t start, size_t length, const void *caller)
+{
+    if (!caller)
+    {
+        caller = __builtin_return_address(0);
+    }
+    ReentrancyGuard guard;
+
+    void *frames[ctracker::kMaxStackDepth];
+    size_t depth = ctracker::detail::CaptureStack(frames, config_.stack_depth, caller);
+
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    if (!IsEnabled())
+    {
+        return;
+    }
+    SyncSession();
+
+    ctracker::CallSite *site = depth ? sites_->Intern(frames, depth) : nullptr;
+    if (regions_->Insert(start, length, site, reinterpret_cast<uintptr_t>(ptr)))
+    {
+        region_stats_.chunk_maps++;
+    }
+}
+
+// Only a region registered for exactly this block counts: a header that merely
+// looks mapped (an interior or foreign pointer) falls through to the free check
+bool CTrackerMetrics::CchunkFreeTrack(void *ptr)
+{
+    ReentrancyGuard guard;
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    SyncSession();
+
+    const ctracker::detail::Region *region = regions_->Find(reinterpret_cast<uintptr_t>(ptr));
+    if (!region || region->chunk != reinterpret_cast<uintptr_t>(ptr))
+    {
+        return false;
+    }
+    size_t partial;
+    regions_->Remove(region->start, region->length, &partial);
+    region_stats_.unmaps++;
+    return true;
+}
+
+ctracker::RegionStats CTrackerMetrics::GetRegionStats() const
+{
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    ctracker::RegionStats stats = region_stats_;
+    stats.regions = regions_->Count();
+    stats.mapped_bytes = regions_->Bytes();
+    return stats;
+}
+
+// A step continues a chain if it replaces the buffer the previous step on this
+// thread produced
+void CTrackerMetrics::NoteGrowthStep(ctracker::CallSite *site, const void *old_ptr, const void *new_ptr, size_t old_size)
+{
+    if (growth_state.grown_ptr != old_ptr)
+    {
+        ctracker::detail::AddRelaxed(site->growth_chains, 1);
+    }
+    ctracker::detail::AddRelaxed(site->growth_steps, 1);
+    ctracker::detail::AddRelaxed(site->growth_bytes_copied, old_size);
+    growth_state.grown_ptr = new_ptr;
+}
+
+// Must hold mutex_
+AllocationRecord *CTrackerMetrics::FirstRecord() const
+{
+    if (skiplist_)
+    {
+        return skiplist_->First();
+    }
+    return pagemap_ ? pagemap_->First() : RecordsHead;
+}
+
+AllocationRecord *CTrackerMetrics::NextRecord(const AllocationRecord *record) const
+{
+    if (skiplist_)
+    {
+        return skiplist_->Next(record);
+    }
+    return pagemap_ ? pagemap_->Next(record) : record->next;
+}
+
+// Must hold mutex_. Last record starting at or below `addr`.
+AllocationRecord *CTrackerMetrics::FloorLocked(uintptr_t addr) const
+{
+    if (tree_)
+    {
+        return tree_->Floor(addr);
+    }
+    if (skiplist_)
+    {
+        return skiplist_->Floor(addr);
+    }
+    if (pagemap_)
+    {
+        return pagemap_->Floor(addr);
+    }
+
+    if (!RecordsHead || reinterpret_cast<uintptr_t>(RecordsHead->ptr) > addr)
+    {
+        return nullptr;
+    }
+    AllocationRecord *current = RecordsHead;
+    while (current->next && reinterpret_cast<uintptr_t>(current->next->ptr) <= addr)
+    {
+        current = current->next;
+    }
+    return current;
+}
+
+// Must hold mutex_
+AllocationRecord *CTrackerMetrics::FindContainingLocked(uintptr_t addr) const
+{
+    AllocationRecord *floor = FloorLocked(addr);
+    if (floor && addr < reinterpret_cast<uintptr_t>(floor->ptr) + floor->size)
+    {
+        return floor;
+    }
+    return nullptr;
+}
+
+// Called without mutex_ and outside any epoch guard; only the classification
+// takes the lock. Only reached when the pointer index misses, so the valid
+// free path never pays for it.
+bool CTrackerMetrics::HandleUnknownFree(void *ptr, const void *caller)
+{
+    bool skipped = ctracker::detail::skipped_blocks.Forget(ptr);
+    ctracker::FreeCheck mode = free_check_.load(std::memory_order_relaxed);
+    if (mode == ctracker::FreeCheck::Off)
+    {
+        ctracker::detail::AddRelaxed(invalid_free_stats_.untracked, 1);
+        return true;
+    }
+
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    SyncSession();
+    ctracker::InvalidFree report = {};
+    report.ptr = ptr;
+    ctracker::detail::EpochGuard epoch(skiplist_ != nullptr);
+
+    ctracker::detail::QuarantineEntry freed;
+    AllocationRecord *owner = FindContainingLocked(reinterpret_cast<uintptr_t>(ptr));
+    if (owner)
+    {
+        report.kind = ctracker::InvalidFreeKind::Interior;
+        report.block = owner->ptr;
+        report.block_size = owner->size;
+        report.alloc_site = owner->site;
+        ctracker::detail::AddRelaxed(invalid_free_stats_.interior, 1);
+    }
+    else if (full_coverage_ && quarantine_->Find(ptr, &freed))
+    {
+        report.kind = ctracker::InvalidFreeKind::DoubleFree;
+        report.block = freed.ptr;
+        report.block_size = freed.size;
+        report.alloc_site = freed.alloc_site;
+        report.previous_free_caller = freed.free_caller;
+        ctracker::detail::AddRelaxed(invalid_free_stats_.double_frees, 1);
+    }
+    else
+    {
+        ctracker::detail::AddRelaxed(invalid_free_stats_.untracked, 1);
+        if (!since_startup_ || !full_coverage_)
+        {
+            return true; // most likely allocated while disabled or sampled out
+        }
+        // Allocated inside the tracker, or possibly so once a bucket overflowed
+        if (skipped || ctracker::detail::skipped_blocks.Overflowed())
+        {
+            return true;
+        }
+        report.kind = ctracker::InvalidFreeKind::Untracked;
+    }
+
+    void *frames[ctracker::kMaxStackDepth];
+    size_t depth = ctracker::detail::CaptureStack(frames, ctracker::kMaxStackDepth, caller);
+    report.free_site = sites_->Intern(frames, depth);
+
+    invalid_free_handler_(report);
+    if (mode == ctracker::FreeCheck::Abort)
+    {
+        std::abort();
+    }
+
+    // Unknown pointers may still be legitimate malloc() memory; the others would
+    // corrupt the heap if freed.
+    return report.kind == ctracker::InvalidFreeKind::Untracked;
+}
+
+void CTrackerMetrics::SetFreeCheck(ctracker::FreeCheck mode)
+{
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    config_.free_check = mode;
+    free_check_.store(mode, std::memory_order_relaxed);
+}
+
+void CTrackerMetrics::SetInvalidFreeHandler(ctracker::InvalidFreeHandler handler)
+{
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    invalid_free_handler_ = handler ? handler : PrintInvalidFree;
+}
+
+ctracker::InvalidFreeStats CTrackerMetrics::GetInvalidFreeStats() const
+{
+    ctracker::InvalidFreeStats stats;
+    stats.untracked = ctracker::detail::LoadRelaxed(invalid_free_stats_.untracked);
+    stats.double_frees = ctracker::detail::LoadRelaxed(invalid_free_stats_.double_frees);
+    stats.interior = ctracker::detail::LoadRelaxed(invalid_free_stats_.interior);
+    return stats;
+}
+
+// With a skip list the summaries walk the registry without mutex_, inside an
+// EpochGuard, so they never hold up allocating threads. Records are not
+// changed once published (see CreallocTrack), so a walk sees every block as
+// it was at some point while it passed, though not one consistent snapshot.
+// After a session change the lock is taken once to purge the old records.
+bool CTrackerMetrics::ReadsWithoutLock() const
+{
+    return skiplist_ && registry_session_.load(std::memory_order_acquire) ==
+                            ctracker::detail::session.load(std::memory_order_acquire);
+}
+
+// Must hold mutex_ unless ReadsWithoutLock()
+size_t CTrackerMetrics::WalkLiveBytes() const
+{
+    ctracker::detail::EpochGuard epoch(skiplist_ != nullptr);
+    size_t active_bytes = 0;
+    for (AllocationRecord *current = FirstRecord(); current; current = NextRecord(current))
+    {
+        active_bytes += current->size;
+    }
+    return active_bytes;
+}
+
+float CTrackerMetrics::WalkFragmentation() const
+{
+    ctracker::detail::EpochGuard epoch(skiplist_ != nullptr);
+    AllocationRecord *first = FirstRecord();
+    if (!first || !NextRecord(first))
+    { // record count < 2
+        return 0.0f;
+    }
+
+    // One pass: the skip list has no tail pointer
+    size_t active_bytes = 0;
+    AllocationRecord *last = first;
+    for (AllocationRecord *current = first; current; current = NextRecord(current))
+    {
+        active_bytes += current->size;
+        last = current;
+    }
+
+    uintptr_t start = reinterpret_cast<uintptr_t>(first->ptr);
+    uintptr_t end = reinterpret_cast<uintptr_t>(last->ptr) + last->size;
+
+    size_t span = end - start;
+    if (span == 0)
+    {
+        return 0.0f;
+    }
+
+    float index = 1.0f - (static_cast<float>(active_bytes) / span);
+    return index;
+}
+
+size_t CTrackerMetrics::WalkLargestGap() const
+{
+    ctracker::detail::EpochGuard epoch(skiplist_ != nullptr);
+    size_t largest_gap = 0;
+
+    AllocationRecord *current = FirstRecord();
+    if (!current)
+    {
+        return 0;
+    }
+
+    AllocationRecord *next;
+    while ((next = NextRecord(current)))
+    {
+        uintptr_t current_end = reinterpret_cast<uintptr_t>(current->ptr) + current->size;
+        uintptr_t next_start = reinterpret_cast<uintptr_t>(next->ptr);
+
+        if (next_start > current_end)
+        {
+            size_t gap = next_start - current_end;
+            if (gap > largest_gap)
+            {
+                largest_gap = gap;
+            }
+        }
+        current = next;
+    }
+    return largest_gap;
+}
+
+size_t CTrackerMetrics::TotalAllocated()
+{
+    if (ReadsWithoutLock())
+    {
+        return WalkLiveBytes();
+    }
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    SyncSession();
+    if (occupancy_->Usable())
+    {
+        return occupancy_->LiveBytes();
+    }
+    return WalkLiveBytes();
+}
+
+float CTrackerMetrics::FragmentationIndex()
+{
+    if (ReadsWithoutLock())
+    {
+        return WalkFragmentation();
+    }
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    SyncSession();
+    if (occupancy_->Usable())
+    {
+        uintptr_t start;
+        uintptr_t end;
+        if (RecordCount < 2 || !occupancy_->Span(&start, &end))
+        {
+            return 0.0f;
+        }
+        return 1.0f - static_cast<float>(occupancy_->LiveBytes()) / (end - start);
+    }
+    return WalkFragmentation();
+}
+
+size_t CTrackerMetrics::FindLargestFreeBlock()
+{
+    if (ReadsWithoutLock())
+    {
+        return WalkLargestGap();
+    }
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    SyncSession();
+    if (occupancy_->Usable())
+    {
+        return occupancy_->LargestGap();
+    }
+    return WalkLargestGap();
+}
+
+void CTrackerMetrics::SetOccupancyBitmap(bool enabled)
+{
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    SyncSession();
+    if (enabled == occupancy_->Enabled())
+    {
+        return;
+    }
+    config_.occupancy_bitmap = enabled;
+    if (skiplist_)
+    {
+        return; // its writers don't take mutex_, which the bitmaps need
+    }
+    occupancy_->SetEnabled(enabled);
+    if (enabled)
+    {
+        for (AllocationRecord *current = FirstRecord(); current; current = NextRecord(current))
+        {
+            occupancy_->Add(current->ptr, current->size);
+        }
+    }
+}
+
+bool CTrackerMetrics::OccupancyBitmapEnabled() const
+{
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    return occupancy_->Enabled();
+}
+
+bool CTrackerMetrics::LookupIndexed(const void *ptr, size_t *size)
+{
+    // While disabled frees go unseen, and after re-enabling the index may still
+    // hold the previous session until the next tracked call purges it.
+    if (!ptr || !IsEnabled() ||
+        registry_session_.load(std::memory_order_acquire) != ctracker::detail::session.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    return index_->Lookup(ptr, size);
+}
+
+bool CTrackerMetrics::IsTracked(const void *ptr)
+{
+    return LookupIndexed(ptr, nullptr);
+}
+
+size_t CTrackerMetrics::SizeOf(const void *ptr)
+{
+    size_t size = 0;
+    return LookupIndexed(ptr, &size) ? size : 0;
+}
+
+bool CTrackerMetrics::FindContaining(const void *ptr, ctracker::Allocation *out)
+{
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    SyncSession();
+    ctracker::detail::EpochGuard epoch(skiplist_ != nullptr);
+
+    AllocationRecord *record = FindContainingLocked(reinterpret_cast<uintptr_t>(ptr));
+    if (!record)
+    {
+        return false;
+    }
+    if (out)
+    {
+        *out = {record->ptr, record->size, record->site, record->context};
+    }
+    return true;
+}
+
+// Must hold mutex_. First record overlapping [lo, ...).
+AllocationRecord *CTrackerMetrics::FirstOverlappingLocked(uintptr_t lo) const
+{
+    AllocationRecord *floor = FloorLocked(lo);
+    if (!floor)
+    {
+        return FirstRecord();
+    }
+    if (lo < reinterpret_cast<uintptr_t>(floor->ptr) + floor->size)
+    {
+        return floor;
+    }
+    return NextRecord(floor);
+}
+
+void CTrackerMetrics::ForEachInRange(const void *lo, const void *hi, ctracker::AllocationVisitor visitor, void *context)
+{
+    uintptr_t begin = reinterpret_cast<uintptr_t>(lo);
+    uintptr_t end = reinterpret_cast<uintptr_t>(hi);
+
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    SyncSession();
+
+    // The visitor runs under mutex_, so anything it allocates must bypass the tracker
+    ReentrancyGuard guard;
+    ctracker::detail::EpochGuard epoch(skiplist_ != nullptr);
+    for (AllocationRecord *current = FirstOverlappingLocked(begin);
+         current && reinterpret_cast<uintptr_t>(current->ptr) < end;
+         current = NextRecord(current))
+    {
+        visitor({current->ptr, current->size, current->site, current->context}, context);
+    }
+}
+
+size_t CTrackerMetrics::BytesInRange(const void *lo, const void *hi)
+{
+    uintptr_t begin = reinterpret_cast<uintptr_t>(lo);
+    uintptr_t end = reinterpret_cast<uintptr_t>(hi);
+
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    SyncSession();
+    ctracker::detail::EpochGuard epoch(skiplist_ != nullptr);
+
+    size_t bytes = 0;
+    for (AllocationRecord *current = FirstOverlappingLocked(begin);
+         current && reinterpret_cast<uintptr_t>(current->ptr) < end;
+         current = NextRecord(current))
+    {
+        uintptr_t start = reinterpret_cast<uintptr_t>(current->ptr);
+        uintptr_t stop = start + current->size;
+        bytes += (stop < end ? stop : end) - (start > begin ? start : begin);
+    }
+    return bytes;
+}
+
+ctracker::AgeDistribution CTrackerMetrics::GetAgeDistribution(uint64_t young_ms, uint64_t old_ms)
+{
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    SyncSession();
+
+    ctracker::AgeDistribution distribution;
+    ages_->Read(young_ms, old_ms, &distribution);
+    return distribution;
+}
+
+size_t CTrackerMetrics::GetChurnCandidates(ctracker::ChurnCandidate *out, size_t max)
+{
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    SyncSession();
+    return churn_->Top(out, max, ages_->Now(), config_.age_epoch_ms);
+}
+
+struct GrowthQuery
+{
+    ctracker::GrowthSite *out;
+    size_t max;
+    size_t found;
+};
+
+// Keeps out[] sorted by bytes copied, dropping whatever falls off the end
+static void CollectGrowthSite(ctracker::CallSite *site, void *context)
+{
+    if (!site->growth_steps)
+    {
+        return;
+    }
+
+    GrowthQuery *query = static_cast<GrowthQuery *>(context);
+    ctracker::GrowthSite entry = {site, site->growth_chains, site->growth_steps, site->growth_bytes_copied};
+    size_t i = query->found < query->max ? query->found++ : query->max;
+    while (i > 0 && query->out[i - 1].bytes_copied < entry.bytes_copied)
+    {
+        if (i < query->max)
+        {
+            query->out[i] = query->out[i - 1];
+        }
+        i--;
+    }
+    if (i < query->max)
+    {
+        query->out[i] = entry;
+    }
+}
+
+size_t CTrackerMetrics::GetGrowthSites(ctracker::GrowthSite *out, size_t max)
+{
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    GrowthQuery query = {out, max, 0};
+    sites_->ForEach(CollectGrowthSite, &query);
+    return query.found;
+}
+
+ctracker::OverheadStats CTrackerMetrics::GetOverheadStats()
+{
+    ctracker::OverheadStats stats = {};
+    for (size_t i = 0; i < ctracker::kCycleBuckets; i++)
+    {
+        stats.hook_cycles[i] = ctracker::detail::hook_cycles[i].load(std::memory_order_relaxed);
+        stats.hook_samples += stats.hook_cycles[i];
+    }
+    stats.reentrant_skips = ctracker::detail::counters.reentrant_skips.load(std::memory_order_relaxed);
+    stats.retired_blocks = ctracker::detail::RetiredBlocks();
+
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    stats.metadata_bytes = ctracker::detail::LoadRelaxed(RecordCount) * sizeof(AllocationRecord) + index_->MetadataBytes() + sites_->MetadataBytes() +
+                           regions_->MetadataBytes() + contexts_->MetadataBytes() + sizeof(*quarantine_) +
+                           sizeof(ctracker::detail::skipped_blocks) + sizeof(*ages_) + sizeof(*churn_);
+    if (skiplist_)
+    {
+        stats.metadata_bytes += skiplist_->MetadataBytes();
+    }
+    if (pagemap_)
+    {
+        stats.metadata_bytes += pagemap_->MetadataBytes();
+    }
+    stats.metadata_bytes += occupancy_->MetadataBytes();
+    ctracker::LockStats lock_stats = mutex_.Stats();
+    stats.lock_acquisitions = lock_stats.acquisitions;
+    stats.lock_contended = lock_stats.contended;
+    stats.lock_wait_ns = lock_stats.wait_ns;
+    return stats;
+}
+
+ctracker::LockStats CTrackerMetrics::GetLockStats() const
+{
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    return mutex_.Stats();
+}
+
+size_t CTrackerMetrics::GetShardLockStats(ctracker::LockStats *out, size_t max) const
+{
+    size_t count = index_->Shards() < max ? index_->Shards() : max;
+    for (size_t i = 0; i < count; i++)
+    {
+        out[i] = index_->ShardLockStats(i);
+    }
+    return count;
+}
+
+bool CTrackerMetrics::GetContextStats(ctracker::ContextId id, ctracker::ContextStats *out) const
+{
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    // A pending session purge would drop every context
+    if (registry_session_.load(std::memory_order_relaxed) != ctracker::detail::session.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    return contexts_->Find(id, out);
+}
+
+void CTrackerMetrics::ForEachContext(ctracker::ContextVisitor visitor, void *context)
+{
+    ReentrancyGuard guard;
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    SyncSession();
+    contexts_->ForEach(visitor, context);
+}
+
+// printf may allocate, so logging runs under the reentrancy guard too
+#if C_TRACKER_VERBOSE
+#define C_TRACKER_LOG(...)                \
+    do                                    \
+    {                                     \
+        if (!lock_tracker)                \
+        {                                 \
+            lock_tracker = true;          \
+            printf(__VA_ARGS__);          \
+            lock_tracker = false;         \
+        }                                 \
+    } while (0)
+#else
+#define C_TRACKER_LOG(...) \
+    do                     \
+    {                      \
+    } while (0)
+#endif
+
+void *operator new(size_t size)
+{
+    void *ptr = ctracker::detail::TimedRawMalloc(size);
+    C_TRACKER_LOG("`new` called with size %zu -> %p\n", size, ptr);
+    ctracker::detail::OnAllocation(ptr, size, __builtin_return_address(0));
+    return ptr;
+}
+
+void *operator new[](size_t size)
+{
+    void *ptr = ctracker::detail::TimedRawMalloc(size);
+    C_TRACKER_LOG("`new[]` called with size %zu -> %p\n", size, ptr);
+    ctracker::detail::OnAllocation(ptr, size, __builtin_return_address(0));
+    return ptr;
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    void *ptr = ctracker::detail::TimedRawAlignedAlloc(static_cast<size_t>(alignment), size);
+    C_TRACKER_LOG("`new` called with size %zu, alignment %zu -> %p\n", size, static_cast<size_t>(alignment), ptr);
+    ctracker::detail::OnAllocation(ptr, size, __builtin_return_address(0), static_cast<size_t>(alignment));
+    return ptr;
+}
+
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+    void *ptr = ctracker::detail::TimedRawAlignedAlloc(static_cast<size_t>(alignment), size);
+    C_TRACKER_LOG("`new[]` called with size %zu, alignment %zu -> %p\n", size, static_cast<size_t>(alignment), ptr);
+    ctracker::detail::OnAllocation(ptr, size, __builtin_return_address(0), static_cast<size_t>(alignment));
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    C_TRACKER_LOG("`delete` called for %p\n", ptr);
+    if (ctracker::detail::OnFree(ptr, __builtin_return_address(0)))
+    {
+        ctracker::detail::TimedRawFree(ptr);
+    }
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    C_TRACKER_LOG("`delete[]` called for %p\n", ptr);
+    if (ctracker::detail::OnFree(ptr, __builtin_return_address(0)))
+    {
+        ctracker::detail::TimedRawFree(ptr);
+    }
+}
+
+void operator delete(void *ptr, size_t size) noexcept
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    C_TRACKER_LOG("`delete` called with size %zu for %p\n", size, ptr);
+    (void)size;
+    if (ctracker::detail::OnFree(ptr, __builtin_return_address(0)))
+    {
+        ctracker::detail::TimedRawFree(ptr);
+    }
+}
+
+void operator delete[](void *ptr, size_t size) noexcept
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    C_TRACKER_LOG("`delete[]` called with size %zu for %p\n", size, ptr);
+    (void)size;
+    if (ctracker::detail::OnFree(ptr, __builtin_return_address(0)))
+    {
+        ctracker::detail::TimedRawFree(ptr);
+    }
+}
+
+// Aligned blocks come from posix_memalign, which free() releases as usual
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    C_TRACKER_LOG("`delete` called for aligned %p\n", ptr);
+    if (ctracker::detail::OnFree(ptr, __builtin_return_address(0)))
+    {
+        ctracker::detail::TimedRawFree(ptr);
+    }
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    C_TRACKER_LOG("`delete[]` called for aligned %p\n", ptr);
+    if (ctracker::detail::OnFree(ptr, __builtin_return_address(0)))
+    {
+        ctracker::detail::TimedRawFree(ptr);
+    }
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    C_TRACKER_LOG("`delete` called for aligned %p\n", ptr);
+    if (ctracker::detail::OnFree(ptr, __builtin_return_address(0)))
+    {
+        ctracker::detail::TimedRawFree(ptr);
+    }
+}
+
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    C_TRACKER_LOG("`delete[]` called for aligned %p\n", ptr);
+    if (ctracker::detail::OnFree(ptr, __builtin_return_address(0)))
+    {
+        ctracker::detail::TimedRawFree(ptr);
+    }
+}
+
+#endif
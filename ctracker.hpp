@@ -7,323 +7,1294 @@
 #ifndef C_TRACKER_VERBOSE
 #define C_TRACKER_VERBOSE 0
 #endif
+#ifndef C_TRACKER_MALLOC_HOOKS
+#define C_TRACKER_MALLOC_HOOKS 0
+#endif
+#ifndef C_TRACKER_MMAP_HOOKS
+#define C_TRACKER_MMAP_HOOKS 0
+#endif
 
 #if C_TRACKER
 
-#include <iostream>
 #include <atomic>
-#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
 #include <mutex>
+#include <utility>
+
+namespace ctracker
+{
+
+enum class RegistryKind
+{
+    List, // address-sorted linked list, O(n) inserts and range queries
+    Tree, // the same list threaded through an AVL tree: O(log n) inserts and lookups
+    SkipList, // the default. Lock-free skip list: new/delete/realloc and the summaries never take the tracker lock
+    PageMap, // radix tree over address pages: O(1) inserts and lookups, ordered walks by bitmap
+};
+
+// What to do when `delete` is given a pointer the registry doesn't hold
+enum class FreeCheck
+{
+    Off,    // ignore it, as before
+    Report, // classify and report it; double/interior frees are not passed on to free()
+    Abort,  // report, then abort()
+};
+
+const size_t kMaxStackDepth = 32;
+const size_t kMaxPathLength = 256;
+
+// Runtime knobs. Loaded once, on the first tracked allocation, from the file
+// named by CTRACKER_CONFIG (`key = value` lines, `#` comments) and then from
+// CTRACKER_<KEY> environment variables, which take precedence.
+struct Config
+{
+    bool enabled = true;                         // CTRACKER_ENABLED
+    size_t sample_interval = 1;                  // CTRACKER_SAMPLE_INTERVAL
+    RegistryKind registry = RegistryKind::SkipList; // CTRACKER_REGISTRY=list|tree|skiplist|pagemap
+    size_t shards = 16;                          // CTRACKER_SHARDS, rounded up to a power of two
+    size_t stack_depth = 8;                      // CTRACKER_STACK_DEPTH, frames kept per call site
+    size_t export_interval_ms = 0;               // CTRACKER_EXPORT_INTERVAL_MS, 0 = only at exit
+    char output_path[kMaxPathLength] = {};       // CTRACKER_OUTPUT_PATH, empty = no report
+    int toggle_signal = 0;                       // CTRACKER_TOGGLE_SIGNAL, 0 = none
+    FreeCheck free_check = FreeCheck::Off;       // CTRACKER_FREE_CHECK=off|report|abort
+    size_t age_epoch_ms = 1000;                  // CTRACKER_AGE_EPOCH_MS, resolution of record ages
+    bool allocator_latency = false;              // CTRACKER_ALLOCATOR_LATENCY, time malloc/free themselves
+    size_t latency_outlier_ns = 1000000;         // CTRACKER_LATENCY_OUTLIER_NS, slower calls are captured
+    size_t overhead_budget_permille = 0;         // CTRACKER_OVERHEAD_BUDGET_PERMILLE, 0 = fixed sample_interval
+    bool occupancy_bitmap = false;               // CTRACKER_OCCUPANCY_BITMAP, heap summaries from granule bitmaps
+    char crash_dump_path[kMaxPathLength] = {};   // CTRACKER_CRASH_DUMP_PATH, empty = no crash handler
+    int dump_signal = 0;                         // CTRACKER_DUMP_SIGNAL, with a crash_dump_path: dump and go on
+};
+
+// Applies `key = value` lines from `text` on top of `config`. Never allocates.
+// Returns false if any line had an unknown key or a malformed value; the
+// remaining lines are still applied.
+bool ParseConfig(const char *text, size_t length, Config *config);
+
+// Reads CTRACKER_CONFIG and the CTRACKER_* environment on top of the defaults.
+// Uses only getenv/open/read, so it is safe to run inside `operator new`.
+Config LoadConfig();
+
+// An interned call stack, innermost frame first. Sites are never freed, so the
+// pointers stay valid for the life of the process. The counters are updated
+// with relaxed atomic adds, so a reader may see one a moment behind another.
+struct CallSite
+{
+    uint32_t id;
+    uint32_t depth;
+    void *frames[kMaxStackDepth];
+
+    uint64_t allocations;
+    uint32_t first_epoch; // age epoch of the first allocation, for rates
+    size_t live_count;
+    size_t live_bytes;
+    size_t estimated_live_bytes; // each live record weighted by its sampling interval
+
+    // realloc() calls made from this site
+    uint64_t reallocs_in_place;
+    uint64_t reallocs_moved;
+    uint64_t realloc_bytes_copied;
+
+    // Container growth from this site: a bigger buffer allocated, then the
+    // previous one freed, or a moving realloc, each step 1.4-2.1x the last
+    uint64_t growth_chains;
+    uint64_t growth_steps;
+    uint64_t growth_bytes_copied;
+};
+
+enum class InvalidFreeKind
+{
+    Untracked,  // not in the registry and never seen
+    DoubleFree, // freed recently (found in the quarantine ring) and not reallocated
+    Interior,   // points inside a live allocation
+};
+
+struct InvalidFree
+{
+    InvalidFreeKind kind;
+    void *ptr;
+    const CallSite *free_site; // the offending free
+
+    // DoubleFree: the block as it was first freed. Interior: the live block.
+    void *block;
+    size_t block_size;
+    const CallSite *alloc_site;
+    const void *previous_free_caller; // DoubleFree only
+};
+
+struct InvalidFreeStats
+{
+    uint64_t untracked;
+    uint64_t double_frees;
+    uint64_t interior;
+};
+
+// Called with the tracker locked; must not call back into the tracker.
+typedef void (*InvalidFreeHandler)(const InvalidFree &report);
+
+// realloc() of recorded blocks. A moving realloc copies min(old, new) bytes.
+struct ReallocStats
+{
+    uint64_t in_place;
+    uint64_t moved;
+    uint64_t bytes_copied;
+};
+
+// mmap()ed regions, kept apart from the heap registry. Lengths are rounded up
+// to whole pages, as the kernel does.
+struct RegionStats
+{
+    size_t regions;
+    size_t mapped_bytes;
+    uint64_t maps;
+    uint64_t unmaps;
+    uint64_t partial_unmaps; // munmap() of only part of a region
+    uint64_t remaps;
+    uint64_t chunk_maps; // malloc()/new blocks glibc served from a mapping of their own
+};
+
+const size_t kMaxTypeName = 128;
+
+// Per-type counters of a Tracked<T> class
+struct TypeStats
+{
+    char name[kMaxTypeName];
+    size_t live_count;
+    size_t live_bytes;
+    uint64_t allocations; // churn: allocations and frees since startup
+    uint64_t frees;
+};
+
+typedef void (*TypeVisitor)(const TypeStats &stats, void *context);
+
+// Coroutine frames of a TrackedFrame<T> promise. Lifetimes are from frame
+// allocation to frame free, in nanoseconds; means are total / frames_freed.
+struct FrameStats
+{
+    char name[kMaxTypeName];
+    size_t live_count;
+    size_t live_bytes;
+    uint64_t frames;
+    uint64_t frames_freed;
+    size_t max_frame_size;
+    uint64_t total_lifetime_ns;
+    uint64_t max_lifetime_ns;
+};
+
+typedef void (*FrameVisitor)(const FrameStats &stats, void *context);
+
+// A (call site, size) pair that keeps allocating and freeing short-lived
+// blocks, i.e. a candidate for pooling or reusing the object. A pool would save
+// the allocator two calls per frees_per_second and bytes_per_second of traffic.
+struct ChurnCandidate
+{
+    const CallSite *site;
+    size_t size;
+    uint64_t short_lived_frees; // freed by the age epoch after the allocation's; a lower bound
+    double frees_per_second;
+    double bytes_per_second;
+};
+
+// A site whose buffers grow geometrically (std::vector style): a reserve()
+// there would save `bytes_copied`
+struct GrowthSite
+{
+    const CallSite *site;
+    uint64_t chains;
+    uint64_t steps;
+    uint64_t bytes_copied;
+};
+
+// Live allocations from different threads sharing a cache line, grouped by the
+// pair of allocation sites. sites[0] == sites[1] when one site allocates for
+// several threads (e.g. per-thread counters).
+struct FalseSharingRisk
+{
+    const CallSite *sites[2];
+    size_t collisions;              // pairs of live blocks on a shared line
+    uint64_t allocations;           // both sites' allocation counts
+    double allocations_per_second; // both sites' rates since their first allocation, the ranking key
+};
+
+const size_t kCacheLineSize = 64;
+
+// Sampled cycle counts of the tracking code in new/delete, in log2 buckets:
+// bucket i counts calls that took [2^i, 2^(i+1)) cycles (TSC on x86).
+const size_t kCycleBuckets = 32;
+const uint32_t kCycleSampleInterval = 64;
+
+// One of the tracker's locks. Waits are only timed for contended acquisitions.
+struct LockStats
+{
+    uint64_t acquisitions;
+    uint64_t contended; // acquisitions that had to wait
+    uint64_t wait_ns;
+};
+
+// What the tracker itself costs
+struct OverheadStats
+{
+    uint64_t hook_cycles[kCycleBuckets];
+    uint64_t hook_samples;
+    size_t metadata_bytes;     // records, index, call sites and the other tables
+    uint64_t lock_acquisitions;
+    uint64_t lock_contended;   // acquisitions that had to wait
+    uint64_t lock_wait_ns;
+    uint64_t reentrant_skips;  // allocations not tracked because the tracker was running
+    size_t retired_blocks;     // skip list records and nodes waiting for readers to move on
+};
+
+// Adaptive sampling (Config::overhead_budget_permille) and the live totals it
+// keeps unbiased: every record stands for `interval` allocations of its size,
+// using the interval in force when it was recorded.
+struct SamplingStats
+{
+    size_t interval;
+    size_t budget_permille;   // 0 = adaptive sampling off
+    size_t overhead_permille; // time in tracking code per process CPU time, last period
+    uint64_t adjustments;
+    size_t estimated_live_count;
+    size_t estimated_live_bytes;
+};
+
+// Underlying allocator calls timed when Config::allocator_latency is on
+enum class AllocatorOp
+{
+    Malloc, // malloc/calloc/aligned allocations, including those behind `new`
+    Free,
+    Realloc,
+};
+const size_t kAllocatorOps = 3;
+
+// Log-linear nanosecond buckets in the style of HdrHistogram: values below 4
+// get their own bucket, then every power of two is split into 4 sub-buckets,
+// so a bucket's bounds are within 25% of each other. The last bucket holds
+// everything from ~30 s up.
+const size_t kLatencySubBuckets = 4;
+const size_t kLatencyBuckets = 136;
+
+struct LatencyHistogram
+{
+    uint64_t counts[kLatencyBuckets];
+    uint64_t calls;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t outliers; // calls at or above the outlier threshold
+};
+
+// Lower bound of `bucket` in nanoseconds
+uint64_t LatencyBucketStart(size_t bucket);
+// Upper bound of the bucket holding the given percentile (0-100), capped at
+// max_ns. 0 for an empty histogram.
+uint64_t LatencyPercentile(const LatencyHistogram &histogram, unsigned percentile);
+
+// One allocator call that took at least the outlier threshold
+struct LatencyOutlier
+{
+    uint64_t timestamp_ns; // CLOCK_REALTIME when the call started
+    uint64_t duration_ns;
+    size_t size;
+    uint32_t thread; // see CurrentThreadId()
+    AllocatorOp op;
+};
+const size_t kLatencyOutliers = 64;
+
+// Allocator latency is also kept per thread, by CurrentThreadId(); threads
+// past the first kLatencyThreads - 1 share the last slot.
+const size_t kLatencyThreads = 16;
+
+// Small ID the tracker gives the calling thread on first use, counting from 1
+uint32_t CurrentThreadId();
+
+// Size classes used by the analyses: class i holds sizes up to 16 * 4^i bytes,
+// the last one everything larger.
+const size_t kSizeClasses = 8;
+
+// Layout waste over a snapshot of the live recorded allocations. A block
+// straddles needlessly when it touches more cache lines (pages) than its size
+// requires. Padding is the rounding of each size up to its alignment; extra
+// alignment is what over-aligned requests cost beyond the default alignment.
+struct AlignmentReport
+{
+    size_t records;
+    size_t line_straddles[kSizeClasses];
+    size_t page_straddles[kSizeClasses];
+    size_t padding_bytes[kSizeClasses];
+    size_t over_aligned;
+    size_t extra_alignment_bytes;
+};
+
+struct Generation
+{
+    size_t live_count;
+    size_t live_bytes;
+    size_t bytes_by_class[kSizeClasses];
+};
+
+// Live recorded allocations by age, see CTrackerMetrics::GetAgeDistribution()
+struct AgeDistribution
+{
+    Generation young;
+    Generation middle;
+    Generation old;
+};
+
+// Logical request/tenant an allocation is attributed to, see SetContext().
+// 0 means none.
+typedef uint64_t ContextId;
+
+// Allocations recorded under one context, kept up to date on every new/delete.
+// A context is forgotten when its last live block is freed, so `allocations`
+// counts from the last time it had nothing live.
+struct ContextStats
+{
+    ContextId id;
+    size_t live_count;
+    size_t live_bytes;
+    uint64_t allocations;
+};
+
+// Called with the tracker locked; must not call back into the tracker.
+typedef void (*ContextVisitor)(const ContextStats &stats, void *context);
+
+// A live allocation, copied out of the registry
+struct Allocation
+{
+    void *ptr;
+    size_t size;
+    const CallSite *site;
+    ContextId context;
+};
+
+// Called with the tracker locked; must not call back into the tracker.
+// Allocations made inside the callback are not tracked.
+typedef void (*AllocationVisitor)(const Allocation &allocation, void *context);
+
+namespace detail
+{
+class PointerIndex;
+class RecordTree;
+class RecordSkipList;
+struct SkipNode;
+class EpochGuard;
+class RecordPageMap;
+class OccupancyMap;
+class CallSiteTable;
+class Quarantine;
+class RegionMap;
+class ContextTable;
+class AgeTable;
+class ChurnTable;
+
+// std::mutex that counts acquisitions and measures how long lockers wait. The
+// counters are only written and read with the mutex held, and the clock is
+// only read when try_lock fails, so an uncontended lock costs two increments.
+class TimedMutex
+{
+public:
+    TimedMutex() : acquisitions_(0), contended_(0), wait_ns_(0) {}
+
+    void lock()
+    {
+        if (!mutex_.try_lock())
+        {
+            LockSlow();
+        }
+        acquisitions_++;
+    }
+    bool try_lock()
+    {
+        if (!mutex_.try_lock())
+        {
+            return false;
+        }
+        acquisitions_++;
+        return true;
+    }
+    void unlock()
+    {
+        mutex_.unlock();
+    }
+
+    // Call with the mutex held
+    LockStats Stats() const
+    {
+        LockStats stats = {acquisitions_, contended_, wait_ns_};
+        return stats;
+    }
+
+private:
+    void LockSlow();
+
+    std::mutex mutex_;
+    uint64_t acquisitions_;
+    uint64_t contended_;
+    uint64_t wait_ns_;
+};
+} // namespace detail
+
+} // namespace ctracker
 
 struct AllocationRecord
 {
     void *ptr;
     size_t size;
+    ctracker::CallSite *site;
+    ctracker::ContextId context;     // 0 when allocated outside any context
+    uint32_t epoch;                  // age epoch it was recorded in, see AgeTable
+    uint32_t thread;                 // small ID of the allocating thread
+    uint32_t alignment;              // requested alignment
+    size_t weight;                   // sampling interval it was picked at
+
+    AllocationRecord *next; // with RegistryKind::PageMap, within the record's 64-byte page slot
+    AllocationRecord *prev;
+    AllocationRecord *hnext; // pointer index chain
 
-    AllocationRecord *next;
+    // RegistryKind::SkipList node; next/prev are unused then
+    ctracker::detail::SkipNode *node;
+
+    // RegistryKind::Tree links
+    AllocationRecord *left;
+    AllocationRecord *right;
+    int height;
 };
 
 class CTrackerMetrics
 {
 protected:
-    CTrackerMetrics() : RecordsHead(nullptr), RecordsTail(nullptr) {}
+    CTrackerMetrics();
+
+    mutable ctracker::detail::TimedMutex mutex_;
+
+    // Tracking session the records belong to, see Enable(). Written under
+    // mutex_, read without it by the index-only queries.
+    std::atomic<unsigned> registry_session_;
+
+    ctracker::Config config_;
+
+    // ptr -> record, sharded with its own locks (see Config::shards)
+    ctracker::detail::PointerIndex *index_;
+    // Ordered index over the same records, nullptr for RegistryKind::List
+    ctracker::detail::RecordTree *tree_;
+    // Replaces the list and tree for RegistryKind::SkipList, nullptr otherwise
+    ctracker::detail::RecordSkipList *skiplist_;
+    // Replaces the list for RegistryKind::PageMap, nullptr otherwise
+    ctracker::detail::RecordPageMap *pagemap_;
+    ctracker::detail::CallSiteTable *sites_;
+    ctracker::detail::Quarantine *quarantine_;
+    ctracker::detail::RegionMap *regions_;
+    ctracker::detail::ContextTable *contexts_;
+    ctracker::detail::AgeTable *ages_;
+    ctracker::detail::ChurnTable *churn_;
+    ctracker::detail::OccupancyMap *occupancy_;
+
+    ctracker::InvalidFreeHandler invalid_free_handler_;
+    ctracker::InvalidFreeStats invalid_free_stats_;
+    ctracker::ReallocStats realloc_stats_;
+    ctracker::RegionStats region_stats_;
 
-    mutable std::mutex mutex_;
+    // Whether every `new` of this session was recorded: no sampling seen since
+    // the session started, and the session started with the process.
+    bool since_startup_;
+    std::atomic<bool> full_coverage_;
+
+    // Config::free_check, for the frees that don't take mutex_
+    std::atomic<ctracker::FreeCheck> free_check_;
+
+    // Live records weighted by their sampling interval
+    size_t estimated_live_count_;
+    size_t estimated_live_bytes_;
+
+    void SyncSession();
+    void EnterWriter(ctracker::detail::EpochGuard &epoch);
+    void AddRecord(AllocationRecord *record, void *const *frames, size_t depth);
+    void ForgetRecord(AllocationRecord *record, const void *caller);
+    void MoveRecord(AllocationRecord *old, AllocationRecord *record, void *new_ptr, size_t size, const void *caller,
+                    void *const *frames, size_t depth);
+    bool LinkRecord(AllocationRecord *record);
+    void UnlinkRecord(AllocationRecord *record);
+    bool LinkOrdered(AllocationRecord *record);
+    void UnlinkOrdered(AllocationRecord *record);
+    bool LookupIndexed(const void *ptr, size_t *size);
+    AllocationRecord *FloorLocked(uintptr_t addr) const;
+    AllocationRecord *FirstOverlappingLocked(uintptr_t lo) const;
+    AllocationRecord *FindContainingLocked(uintptr_t addr) const;
+    // Address-order iteration whatever the registry kind; with a skip list the
+    // caller must be inside an EpochGuard
+    AllocationRecord *FirstRecord() const;
+    AllocationRecord *NextRecord(const AllocationRecord *record) const;
+    // For records nothing links to any more; deferred while skip list readers may hold them
+    void ReleaseRecord(AllocationRecord *record);
+    bool ReadsWithoutLock() const;
+    size_t WalkLiveBytes() const;
+    float WalkFragmentation() const;
+    size_t WalkLargestGap() const;
+    bool HandleUnknownFree(void *ptr, const void *caller);
+    void NoteGrowthStep(ctracker::CallSite *site, const void *old_ptr, const void *new_ptr, size_t old_size);
 
 public:
+    // Both nullptr with RegistryKind::SkipList and RegistryKind::PageMap
     AllocationRecord *RecordsHead;
     AllocationRecord *RecordsTail;
     size_t RecordCount = 0;
 
-    ~CTrackerMetrics()
-    {
-        AllocationRecord *current = RecordsHead;
-        while (current)
-        {
-            AllocationRecord *next = current->next;
-            std::free(current);
-            current = next;
-        }
-    }
+    ~CTrackerMetrics();
 
     CTrackerMetrics(const CTrackerMetrics &) = delete; // not clonable
     void operator=(const CTrackerMetrics &) = delete;  // not assignable
 
     static CTrackerMetrics *GetTracker();
 
-    void CmallocTrack(void *ptr, size_t size)
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
+    // `caller` is the return address of the `new`/`delete` being tracked; when
+    // null the caller of these functions is used. `alignment` is the requested
+    // alignment, 0 for the default `new` alignment. `weight` is the sampling
+    // interval the block was picked at, the number of blocks it stands for.
+    void CmallocTrack(void *ptr, size_t size, const void *caller = nullptr, size_t alignment = 0, size_t weight = 1);
 
-        // We use malloc here to avoid calling our own `operator new`
-        AllocationRecord *newRecord = static_cast<AllocationRecord *>(std::malloc(sizeof(AllocationRecord)));
-        if (!newRecord)
-        {
-            return;
-        }
+    // Returns false if `ptr` must not be handed to free(): with FreeCheck on, a
+    // double free or interior pointer is reported and swallowed.
+    bool CfreeTrack(void *ptr, const void *caller = nullptr);
 
-        newRecord->ptr = ptr;
-        newRecord->size = size;
-        newRecord->next = nullptr;
+    // realloc(old_ptr) returned new_ptr. In place, the record is resized where
+    // it is; otherwise it is moved to the new address. Blocks that were never
+    // recorded (sampled out, allocated while disabled) stay unrecorded.
+    void CreallocTrack(void *old_ptr, void *new_ptr, size_t size, const void *caller = nullptr);
+    ctracker::ReallocStats GetReallocStats() const;
 
-        // Maintain sorted order by address for easier fragmentation analysis
-        uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+    // Direct mmap()/munmap()/mremap() calls, tracked in a separate region
+    // registry so large mappings don't show up as heap fragmentation.
+    // Installed automatically with C_TRACKER_MMAP_HOOKS. `keep_old` is for
+    // MREMAP_DONTUNMAP, which leaves the old range mapped.
+    void CmmapTrack(void *addr, size_t length, const void *caller = nullptr);
+    void CmunmapTrack(void *addr, size_t length);
+    void CmremapTrack(void *old_addr, size_t old_length, void *new_addr, size_t new_length, bool keep_old = false);
+    ctracker::RegionStats GetRegionStats() const;
 
-        if (!RecordsHead || reinterpret_cast<uintptr_t>(RecordsHead->ptr) > addr)
-        {
-            newRecord->next = RecordsHead;
-            RecordsHead = newRecord;
-            if (!RecordsTail)
-            {
-                RecordsTail = newRecord;
-            }
-        }
-        else
-        {
-            AllocationRecord *current = RecordsHead;
-            while (current->next && reinterpret_cast<uintptr_t>(current->next->ptr) < addr)
-            {
-                current = current->next;
-            }
-            newRecord->next = current->next;
-            current->next = newRecord;
-            if (!newRecord->next)
-            {
-                RecordsTail = newRecord;
-            }
-        }
-        RecordCount++;
-    }
+    // A block glibc served from a mapping of its own (at or above
+    // M_MMAP_THRESHOLD), mapped at [start, start + length). It goes in the
+    // region registry rather than the heap records, so it leaves no false gap
+    // in the fragmentation summaries. CfreeTrack finds it there again;
+    // CchunkFreeTrack drops it without looking at the freed block.
+    void CchunkTrack(void *ptr, uintptr_t start, size_t length, const void *caller = nullptr);
+    bool CchunkFreeTrack(void *ptr);
 
-    void CfreeTrack(void *ptr)
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        AllocationRecord *current = RecordsHead;
-        AllocationRecord *prev = nullptr;
-
-        while (current)
-        {
-            if (current->ptr == ptr)
-            {
-                if (prev)
-                {
-                    prev->next = current->next;
-                }
-                else
-                {
-                    RecordsHead = current->next;
-                }
-
-                if (current == RecordsTail)
-                {
-                    RecordsTail = prev;
-                }
-
-                std::free(current); // Free the record node
-                RecordCount--;
-                return;
-            }
-            prev = current;
-            current = current->next;
-        }
-    }
+    // Heap summaries. With RegistryKind::SkipList, the default, they walk the
+    // registry without the tracker lock, so they never delay allocating
+    // threads. The other registries hold the lock for an O(n) walk, or read
+    // the occupancy bitmaps under it when those are enabled.
 
     // Total size allocated to the heap
-    size_t TotalAllocated()
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        size_t active_bytes = 0;
-        AllocationRecord *current = RecordsHead;
-        while (current)
-        {
-            active_bytes += current->size;
-            current = current->next;
-        }
-        return active_bytes;
-    }
+    size_t TotalAllocated();
 
     // Absolute index betweenn 0-1.
     //    - Below 0.2 is generally ok
     //    - Around 0.5 is generally not ok
     //    - Above 0.8 is extremely not ok
-    float FragmentationIndex()
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (!RecordsHead || (RecordsHead == RecordsTail))
-        { // record count < 2
-            return 0.0f;
-        }
+    float FragmentationIndex();
 
-        uintptr_t start = reinterpret_cast<uintptr_t>(RecordsHead->ptr);
-        uintptr_t end = reinterpret_cast<uintptr_t>(RecordsTail->ptr) + RecordsTail->size;
+    size_t FindLargestFreeBlock();
 
-        size_t span = end - start;
-        if (span == 0)
-        {
-            return 0.0f;
-        }
+    // Serves the three summaries above from one-bit-per-16-byte-granule
+    // bitmaps kept next to the registry, with word-level scans instead of a
+    // walk over the records. Spans and gaps are then measured in whole
+    // granules. Enabling builds the bitmaps from the live records. Not used
+    // with a skip list registry, whose lock-free walk wins.
+    void SetOccupancyBitmap(bool enabled);
+    bool OccupancyBitmapEnabled() const;
+
+    // O(1) lookups through the pointer index, without the registry lock. Only
+    // the start of a live, recorded allocation is tracked: interior pointers,
+    // sampled-out allocations and anything while tracking is disabled are not.
+    bool IsTracked(const void *ptr);
+    // Requested size of a tracked allocation, 0 if not tracked
+    size_t SizeOf(const void *ptr);
+
+    // Address queries, O(log n + k) with the tree registry (O(n) with the list).
+    // The live allocation whose [ptr, ptr + size) contains `ptr`, if any.
+    bool FindContaining(const void *ptr, ctracker::Allocation *out);
 
-        size_t active_bytes = 0;
-        AllocationRecord *current = RecordsHead;
-        while (current)
+    // Visits, in address order, every live allocation overlapping [lo, hi)
+    void ForEachInRange(const void *lo, const void *hi, ctracker::AllocationVisitor visitor, void *context);
+
+    template <typename Fn>
+    void ForEachInRange(const void *lo, const void *hi, Fn fn)
+    {
+        ctracker::AllocationVisitor visitor = [](const ctracker::Allocation &allocation, void *context)
         {
-            active_bytes += current->size;
-            current = current->next;
-        }
-        float index = 1.0f - (static_cast<float>(active_bytes) / span);
-        return index;
+            (*static_cast<Fn *>(context))(allocation);
+        };
+        ForEachInRange(lo, hi, visitor, &fn);
     }
 
-    size_t FindLargestFreeBlock()
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        size_t largest_gap = 0;
+    // Live bytes inside [lo, hi); allocations straddling a bound count partially
+    size_t BytesInRange(const void *lo, const void *hi);
 
-        if (!RecordsHead)
-        {
-            return 0;
-        }
+    // Live recorded allocations bucketed by time since they were recorded:
+    // younger than `young_ms`, older than `old_ms`, or in between. Served from
+    // per-epoch counters (Config::age_epoch_ms), not a scan; ages beyond the
+    // last 256 epochs all count as old.
+    ctracker::AgeDistribution GetAgeDistribution(uint64_t young_ms, uint64_t old_ms);
 
-        AllocationRecord *current = RecordsHead;
-        while (current && current->next)
+    // The busiest alloc/free churn pairs this session, highest rate first.
+    // Tracked in a fixed-size table, so rare pairs can be evicted by busy ones.
+    size_t GetChurnCandidates(ctracker::ChurnCandidate *out, size_t max);
+
+    // Sites with container growth chains, most bytes copied first
+    size_t GetGrowthSites(ctracker::GrowthSite *out, size_t max);
+
+    // Scans the registry in address order for cache lines shared by live
+    // allocations of at most `max_size` bytes from different threads. Returns
+    // the site pairs involved, highest allocation rate first. O(n) under the lock.
+    size_t GetFalseSharingRisks(ctracker::FalseSharingRisk *out, size_t max,
+                                size_t max_size = ctracker::kCacheLineSize);
+
+    // Cache-line/page straddling and padding of the live allocations. O(n)
+    // under the lock.
+    ctracker::AlignmentReport GetAlignmentReport();
+
+    // Self-instrumentation: hook cycles, metadata, lock waits, reentrant skips
+    ctracker::OverheadStats GetOverheadStats();
+
+    // Retunes the sample interval every 100 ms so the time spent in tracking
+    // code (from the sampled hook cycles) stays near `permille` of the
+    // process's CPU time. The interval never drops below Config::sample_interval,
+    // which is restored when the budget is set back to 0.
+    void SetOverheadBudget(size_t permille);
+    ctracker::SamplingStats GetSamplingStats() const;
+
+    // Contention on the tracker lock, and on each shard lock of the pointer
+    // index (one per Config::shards). Returns the number of shards written.
+    ctracker::LockStats GetLockStats() const;
+    size_t GetShardLockStats(ctracker::LockStats *out, size_t max) const;
+
+    // Timing of the underlying allocator calls behind new/delete and the
+    // malloc hooks, off unless Config::allocator_latency is set. Calls taking
+    // `outlier_ns` or more are also kept in a ring of the latest
+    // kLatencyOutliers. Histograms are cumulative over the process.
+    void SetAllocatorLatency(bool enabled, uint64_t outlier_ns);
+    bool AllocatorLatencyEnabled() const;
+    // By size class (see kSizeClasses); false if `size_class` is out of range
+    bool GetAllocatorLatency(ctracker::AllocatorOp op, size_t size_class, ctracker::LatencyHistogram *out) const;
+    // By thread, see ctracker::kLatencyThreads; false if `thread` is 0
+    bool GetThreadAllocatorLatency(ctracker::AllocatorOp op, uint32_t thread,
+                                   ctracker::LatencyHistogram *out) const;
+    // Latest outliers, newest first
+    size_t GetLatencyOutliers(ctracker::LatencyOutlier *out, size_t max) const;
+
+    // Per-context accounting of recorded allocations (see ctracker::SetContext).
+    // False if nothing recorded under `id` is live.
+    bool GetContextStats(ctracker::ContextId id, ctracker::ContextStats *out) const;
+    // Visits every context with something live
+    void ForEachContext(ctracker::ContextVisitor visitor, void *context);
+
+    template <typename Fn>
+    void ForEachContext(Fn fn)
+    {
+        ctracker::ContextVisitor visitor = [](const ctracker::ContextStats &stats, void *context)
         {
-            uintptr_t current_end = reinterpret_cast<uintptr_t>(current->ptr) + current->size;
-            uintptr_t next_start = reinterpret_cast<uintptr_t>(current->next->ptr);
-
-            if (next_start > current_end)
-            {
-                size_t gap = next_start - current_end;
-                if (gap > largest_gap)
-                {
-                    largest_gap = gap;
-                }
-            }
-            current = current->next;
-        }
-        return largest_gap;
+            (*static_cast<Fn *>(context))(stats);
+        };
+        ForEachContext(visitor, &fn);
     }
+
+    // Invalid-free detection, initialised from Config::free_check. Unknown
+    // pointers are only reported as Untracked when every allocation in the
+    // session was recorded (sample interval 1, enabled since startup).
+    void SetFreeCheck(ctracker::FreeCheck mode);
+    // nullptr restores the default handler, which prints to stderr
+    void SetInvalidFreeHandler(ctracker::InvalidFreeHandler handler);
+    ctracker::InvalidFreeStats GetInvalidFreeStats() const;
+
+    // Effective configuration, with the current sampling/enabled state
+    ctracker::Config GetConfig() const;
+
+    // Writes counters and registry metrics as `name value` lines. Reports go to
+    // Config::output_path at exit and every Config::export_interval_ms.
+    bool WriteReport(int fd);
+
+    // Post-mortem dump: counters, hook and allocator latency histograms and the
+    // top call sites by live bytes, as `name value` lines ending in
+    // `crash_dump_end 1`. Async-signal-safe: only write() on static buffers, and
+    // the call sites are read from the lock-free site table. Fatal signals and
+    // dump signals each have their own buffer.
+    bool WriteCrashDump(int fd, int signo);
+
+    // Writes a crash dump to `fd` on SIGABRT, SIGSEGV and SIGBUS, then hands the
+    // signal to the previous disposition. `dump_signo` (e.g. SIGUSR1), if not 0,
+    // writes one without stopping the process. `fd` must stay open; -1 restores
+    // the previous handlers. Also installed at startup from
+    // CTRACKER_CRASH_DUMP_PATH and CTRACKER_DUMP_SIGNAL.
+    static bool InstallCrashDump(int fd, int dump_signo = 0);
+
+    // Runtime switch, initialised from CTRACKER_ENABLED=0/1 on the first tracked
+    // allocation. While disabled `new`/`delete` only pay one branch and no
+    // counters move. Frees are not seen while disabled, so enabling again
+    // starts a new session: records from before are dropped, and frees of
+    // pointers allocated while disabled are ignored.
+    static void Enable();
+    static void Disable();
+    static bool IsEnabled();
+
+    // Toggle tracking whenever `signo` is delivered (e.g. SIGUSR2). Also installed
+    // at startup from CTRACKER_TOGGLE_SIGNAL=<signo>. Returns false on failure.
+    static bool InstallToggleSignal(int signo);
+
+    // Record one in every `interval` allocations (per thread). 1 records everything.
+    static void SetSampleInterval(size_t interval);
+    static size_t SampleInterval();
+
+    // Exact counters, updated on every `new`/`delete` whether sampled or not
+    static uint64_t AllocationCount();
+    static uint64_t FreeCount();
+    static uint64_t AllocatedBytes();
 };
 
-CTrackerMetrics *CTrackerMetrics::GetTracker()
+namespace ctracker
 {
-    static CTrackerMetrics instance;
-    return &instance;
-}
+namespace detail
+{
+
+// Everything below is reached from every `operator new`/`operator delete`, so it
+// is kept inline and only touches constant-initialized globals. The registry
+// itself (CTrackerMetrics) lives out-of-line in ctracker.cpp.
+
+struct HotCounters
+{
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> frees;
+    std::atomic<uint64_t> allocated_bytes;
+    std::atomic<uint64_t> reentrant_skips;
+};
+
+extern std::atomic<bool> enabled;
+extern std::atomic<unsigned> session;
+extern HotCounters counters;
+extern std::atomic<size_t> sample_interval;
+
+// Reentrancy guard: set while the tracker itself is running, so its own
+// allocations (and anything it calls, like printf) are not tracked.
+extern thread_local bool lock_tracker;
+extern thread_local size_t sample_countdown;
+extern thread_local uint64_t current_context;
 
-static thread_local bool lock_tracker = false;
+extern std::atomic<uint64_t> hook_cycles[kCycleBuckets];
+extern std::atomic<uint64_t> hook_cycles_total; // of the sampled calls only
+extern thread_local uint32_t cycle_countdown;
 
-void *operator new(size_t size)
+inline uint64_t ReadCycles()
 {
-    void *ptr = std::malloc(size);
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+    uint64_t value;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    return 0;
+#endif
+}
 
-    if (!lock_tracker)
+// One call in kCycleSampleInterval per thread is timed
+inline bool SampleCycles()
+{
+    if (cycle_countdown)
     {
-        lock_tracker = true;
-        #if C_TRACKER_VERBOSE
-        printf("`new` called with size %zu -> %p\n", size, ptr);
-        #endif
-        CTrackerMetrics::GetTracker()->CmallocTrack(ptr, size);
-        lock_tracker = false;
+        cycle_countdown--;
+        return false;
     }
+    cycle_countdown = kCycleSampleInterval - 1;
+    return true;
+}
 
-    return ptr;
+void RecordHookCycles(uint64_t cycles);
+
+// Allocations the reentrancy guard kept out of the registry, so that freeing
+// them isn't reported as an untracked free (out-of-line, see SkippedBlocks)
+void NoteSkipped(const void *ptr);
+void ForgetSkipped(const void *ptr);
+
+// The weight of a sampled allocation, the interval it was sampled at; 0 to
+// skip it. The interval is read once, so a concurrent change can't give the
+// record a weight it wasn't sampled with.
+inline size_t SampleAllocation()
+{
+    size_t interval = sample_interval.load(std::memory_order_relaxed);
+    if (interval <= 1)
+    {
+        return 1;
+    }
+    if (sample_countdown > 1 && sample_countdown <= interval)
+    {
+        sample_countdown--;
+        return 0;
+    }
+    sample_countdown = interval;
+    return interval;
 }
 
-void *operator new[](size_t size)
+// Whether the blocks the hooks see come from glibc's malloc, so their chunk
+// headers can be read. Off until the tracker has checked: a sanitizer or a
+// preloaded allocator (jemalloc, tcmalloc) puts no header before a block.
+extern std::atomic<bool> glibc_chunks;
+
+// glibc marks a chunk it mapped on its own with IS_MMAPPED (2) in the size
+// word; the word before holds the chunk's offset into its mapping
+inline bool MappedChunk(const void *ptr, uintptr_t *start, size_t *length)
 {
-    void *ptr = std::malloc(size);
+#if defined(__GLIBC__)
+    if (!ptr || !glibc_chunks.load(std::memory_order_relaxed))
+    {
+        return false;
+    }
+    const size_t *header = static_cast<const size_t *>(ptr) - 2;
+    if (!(header[1] & 2))
+    {
+        return false;
+    }
+    *start = reinterpret_cast<uintptr_t>(header) - header[0];
+    *length = (header[1] & ~size_t(7)) + header[0];
+    return true;
+#else
+    (void)ptr;
+    (void)start;
+    (void)length;
+    return false;
+#endif
+}
 
-    if (!lock_tracker)
+inline void OnAllocation(void *ptr, size_t size, const void *caller, size_t alignment = 0)
+{
+    if (!enabled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    if (lock_tracker)
+    {
+        counters.reentrant_skips.fetch_add(1, std::memory_order_relaxed);
+        NoteSkipped(ptr);
+        return;
+    }
+
+    bool timed = SampleCycles();
+    uint64_t start = timed ? ReadCycles() : 0;
+
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    counters.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    // Mapped chunks are few and large: always tracked, as regions
+    uintptr_t map_start;
+    size_t map_length;
+    if (MappedChunk(ptr, &map_start, &map_length))
+    {
+        lock_tracker = true;
+        CTrackerMetrics::GetTracker()->CchunkTrack(ptr, map_start, map_length, caller);
+        lock_tracker = false;
+    }
+    else if (size_t weight = SampleAllocation())
     {
         lock_tracker = true;
-        #if C_TRACKER_VERBOSE
-        printf("`new[]` called with size %zu -> %p\n", size, ptr);
-        #endif
-        CTrackerMetrics::GetTracker()->CmallocTrack(ptr, size);
+        CTrackerMetrics::GetTracker()->CmallocTrack(ptr, size, caller, alignment, weight);
         lock_tracker = false;
     }
 
-    return ptr;
+    if (timed)
+    {
+        RecordHookCycles(ReadCycles() - start);
+    }
+}
+
+// Returns false if the pointer must not be passed on to free()
+inline bool OnFree(void *ptr, const void *caller)
+{
+    if (!enabled.load(std::memory_order_relaxed))
+    {
+        return true;
+    }
+    if (lock_tracker)
+    {
+        ForgetSkipped(ptr);
+        return true;
+    }
+
+    bool timed = SampleCycles();
+    uint64_t start = timed ? ReadCycles() : 0;
+
+    counters.frees.fetch_add(1, std::memory_order_relaxed);
+
+    lock_tracker = true;
+    bool release = CTrackerMetrics::GetTracker()->CfreeTrack(ptr, caller);
+    lock_tracker = false;
+
+    if (timed)
+    {
+        RecordHookCycles(ReadCycles() - start);
+    }
+    return release;
 }
 
-void operator delete(void *ptr) noexcept
+// realloc() that returned a block: `old_ptr` is gone, `new_ptr` may equal it
+inline void OnReallocation(void *old_ptr, void *new_ptr, size_t size, const void *caller)
 {
-    if (!ptr)
+    if (!enabled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    if (lock_tracker)
     {
+        ForgetSkipped(old_ptr);
+        NoteSkipped(new_ptr);
         return;
     }
 
-    if (!lock_tracker)
+    lock_tracker = true;
+    CTrackerMetrics::GetTracker()->CreallocTrack(old_ptr, new_ptr, size, caller);
+    lock_tracker = false;
+}
+
+// realloc() where the old or the new block is a mapped chunk: tracked as a
+// free and an allocation, since the two live in different registries.
+// `old_mapped` was read before the realloc; the old block may be unmapped now.
+inline void OnChunkReallocation(void *old_ptr, bool old_mapped, void *new_ptr, size_t size, const void *caller)
+{
+    if (!enabled.load(std::memory_order_relaxed))
     {
-        lock_tracker = true;
-        #if C_TRACKER_VERBOSE
-        printf("`delete` called for %p\n", ptr);
-        #endif
-        CTrackerMetrics::GetTracker()->CfreeTrack(ptr);
-        lock_tracker = false;
+        return;
+    }
+    if (lock_tracker)
+    {
+        ForgetSkipped(old_ptr);
+        NoteSkipped(new_ptr);
+        return;
     }
 
-    std::free(ptr);
+    counters.frees.fetch_add(1, std::memory_order_relaxed);
+    lock_tracker = true;
+    if (old_mapped)
+    {
+        CTrackerMetrics::GetTracker()->CchunkFreeTrack(old_ptr);
+    }
+    else
+    {
+        CTrackerMetrics::GetTracker()->CfreeTrack(old_ptr, caller);
+    }
+    lock_tracker = false;
+    OnAllocation(new_ptr, size, caller);
 }
 
-void operator delete[](void *ptr) noexcept
+inline void OnMap(void *addr, size_t length, const void *caller)
 {
-    if (!ptr)
+    if (!enabled.load(std::memory_order_relaxed) || lock_tracker)
     {
         return;
     }
 
-    if (!lock_tracker)
+    lock_tracker = true;
+    CTrackerMetrics::GetTracker()->CmmapTrack(addr, length, caller);
+    lock_tracker = false;
+}
+
+inline void OnUnmap(void *addr, size_t length)
+{
+    if (!enabled.load(std::memory_order_relaxed) || lock_tracker)
     {
-        lock_tracker = true;
-        #if C_TRACKER_VERBOSE
-        printf("`delete[]` called for %p\n", ptr);
-        #endif
-        CTrackerMetrics::GetTracker()->CfreeTrack(ptr);
-        lock_tracker = false;
+        return;
     }
 
-    std::free(ptr);
+    lock_tracker = true;
+    CTrackerMetrics::GetTracker()->CmunmapTrack(addr, length);
+    lock_tracker = false;
 }
 
-void operator delete(void *ptr, size_t size) noexcept
+inline void OnRemap(void *old_addr, size_t old_length, void *new_addr, size_t new_length, bool keep_old)
 {
-    if (!ptr)
+    if (!enabled.load(std::memory_order_relaxed) || lock_tracker)
     {
         return;
     }
 
-    if (!lock_tracker)
+    lock_tracker = true;
+    CTrackerMetrics::GetTracker()->CmremapTrack(old_addr, old_length, new_addr, new_length, keep_old);
+    lock_tracker = false;
+}
+
+} // namespace detail
+} // namespace ctracker
+
+namespace ctracker
+{
+
+namespace detail
+{
+
+// One per Tracked<T>, zero-initialized static storage. The address doubles as
+// the type's ID; the list links every type that has allocated at least once.
+struct TypeCounters
+{
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> frees;
+    std::atomic<size_t> allocated_bytes;
+    std::atomic<size_t> freed_bytes;
+
+    std::atomic<bool> registered;
+    const char *signature; // __PRETTY_FUNCTION__ naming the type
+    TypeCounters *next;
+};
+
+void RegisterType(TypeCounters *counters, const char *signature);
+void ReadTypeStats(const TypeCounters &counters, const char *signature, TypeStats *out);
+
+struct FrameCounters
+{
+    TypeCounters type; // type.next is unused, frames have their own list
+    std::atomic<size_t> max_frame_size;
+    std::atomic<uint64_t> total_lifetime_ns;
+    std::atomic<uint64_t> max_lifetime_ns;
+    FrameCounters *next;
+};
+
+// Frames are prefixed with their allocation time, keeping the default alignment
+const size_t kFrameHeader = 16;
+
+void *AllocateFrame(FrameCounters *counters, const char *signature, size_t size);
+void FreeFrame(FrameCounters *counters, void *frame, size_t size);
+void ReadFrameStats(const FrameCounters &counters, const char *signature, FrameStats *out);
+
+} // namespace detail
+
+// Visits every Tracked<T> type that has allocated since startup
+void ForEachTrackedType(TypeVisitor visitor, void *context);
+
+template <typename Fn>
+void ForEachTrackedType(Fn fn)
+{
+    TypeVisitor visitor = [](const TypeStats &stats, void *context) { (*static_cast<Fn *>(context))(stats); };
+    ForEachTrackedType(visitor, &fn);
+}
+
+// CRTP mixin giving T class-level new/delete that count live objects and bytes
+// per type, on top of the normal tracking of the underlying allocation:
+//
+//     class Order : public ctracker::Tracked<Order> { ... };
+//
+// Each new/delete costs two relaxed atomic adds, no stack capture or lock.
+// The counters ignore Enable()/Disable() so live counts always pair up.
+template <typename T>
+class Tracked
+{
+public:
+    static void *operator new(size_t size)
     {
-        lock_tracker = true;
-        #if C_TRACKER_VERBOSE
-        printf("`delete` called with size %zu for %p\n", size, ptr);
-        #endif
-        CTrackerMetrics::GetTracker()->CfreeTrack(ptr);
-        lock_tracker = false;
+        Count(size);
+        return ::operator new(size);
     }
 
-    std::free(ptr);
+    static void *operator new[](size_t size)
+    {
+        Count(size);
+        return ::operator new[](size);
+    }
+
+    static void operator delete(void *ptr, size_t size) noexcept
+    {
+        Uncount(size);
+        ::operator delete(ptr);
+    }
+
+    static void operator delete[](void *ptr, size_t size) noexcept
+    {
+        Uncount(size);
+        ::operator delete[](ptr);
+    }
+
+    static TypeStats Stats()
+    {
+        TypeStats stats;
+        detail::ReadTypeStats(counters_, Signature(), &stats);
+        return stats;
+    }
+
+private:
+    static const char *Signature()
+    {
+        return __PRETTY_FUNCTION__;
+    }
+
+    static void Count(size_t size)
+    {
+        if (!counters_.registered.load(std::memory_order_relaxed))
+        {
+            detail::RegisterType(&counters_, Signature());
+        }
+        counters_.allocations.fetch_add(1, std::memory_order_relaxed);
+        counters_.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    static void Uncount(size_t size)
+    {
+        counters_.frees.fetch_add(1, std::memory_order_relaxed);
+        counters_.freed_bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    static detail::TypeCounters counters_;
+};
+
+template <typename T>
+detail::TypeCounters Tracked<T>::counters_;
+
+// Request/tenant attribution. The context is per thread: allocations recorded
+// while it is set are stamped with it and counted in its ContextStats.
+inline ContextId CurrentContext()
+{
+    return detail::current_context;
+}
+
+inline void SetContext(ContextId id)
+{
+    detail::current_context = id;
 }
 
-void operator delete[](void *ptr, size_t size) noexcept
+// Sets the context for a scope, restoring the previous one on exit
+class ContextScope
 {
-    if (!ptr)
+public:
+    explicit ContextScope(ContextId id) : saved_(CurrentContext())
     {
-        return;
+        SetContext(id);
+    }
+    ~ContextScope()
+    {
+        SetContext(saved_);
     }
 
-    if (!lock_tracker)
+    ContextScope(const ContextScope &) = delete;
+    void operator=(const ContextScope &) = delete;
+
+private:
+    ContextId saved_;
+};
+
+// A callable that runs under the context it was created in, for handing work
+// to an executor: `pool.submit(ctracker::WithContext([=] { ... }));`
+template <typename Fn>
+class ContextTask
+{
+    Fn fn_;
+    ContextId context_;
+
+public:
+    ContextTask(Fn fn, ContextId context) : fn_(std::move(fn)), context_(context) {}
+
+    template <typename... Args>
+    auto operator()(Args &&...args) -> decltype(fn_(std::forward<Args>(args)...))
     {
-        lock_tracker = true;
-        #if C_TRACKER_VERBOSE
-        printf("`delete[]` called with size %zu for %p\n", size, ptr);
-        #endif
-        CTrackerMetrics::GetTracker()->CfreeTrack(ptr);
-        lock_tracker = false;
+        ContextScope scope(context_);
+        return fn_(std::forward<Args>(args)...);
     }
+};
 
-    std::free(ptr);
+template <typename Fn>
+ContextTask<Fn> WithContext(Fn fn)
+{
+    return ContextTask<Fn>(std::move(fn), CurrentContext());
+}
+
+// Visits every TrackedFrame<T> type that has allocated a frame since startup
+void ForEachCoroutineType(FrameVisitor visitor, void *context);
+
+template <typename Fn>
+void ForEachCoroutineType(Fn fn)
+{
+    FrameVisitor visitor = [](const FrameStats &stats, void *context) { (*static_cast<Fn *>(context))(stats); };
+    ForEachCoroutineType(visitor, &fn);
+}
+
+// Mixin for a coroutine promise type: the compiler allocates the coroutine
+// frame through the promise's operator new, so frames are counted per tag T
+// (usually the coroutine's return type), with their sizes and lifetimes:
+//
+//     struct Task::promise_type : ctracker::TrackedFrame<Task> { ... };
+//
+// Frames still go through the global `operator new` and are tracked as usual.
+template <typename T>
+class TrackedFrame
+{
+public:
+    static void *operator new(size_t size)
+    {
+        return detail::AllocateFrame(&counters_, Signature(), size);
+    }
+
+    static void operator delete(void *frame, size_t size) noexcept
+    {
+        detail::FreeFrame(&counters_, frame, size);
+    }
+
+    static FrameStats Stats()
+    {
+        FrameStats stats;
+        detail::ReadFrameStats(counters_, Signature(), &stats);
+        return stats;
+    }
+
+private:
+    static const char *Signature()
+    {
+        return __PRETTY_FUNCTION__;
+    }
+
+    static detail::FrameCounters counters_;
+};
+
+template <typename T>
+detail::FrameCounters TrackedFrame<T>::counters_;
+
+} // namespace ctracker
+
+// Lock-free, so these are also safe to call from a signal handler
+inline void CTrackerMetrics::Enable()
+{
+    if (ctracker::detail::enabled.load(std::memory_order_acquire))
+    {
+        return;
+    }
+    ctracker::detail::session.fetch_add(1, std::memory_order_release);
+    ctracker::detail::enabled.store(true, std::memory_order_release);
+}
+
+inline void CTrackerMetrics::Disable()
+{
+    ctracker::detail::enabled.store(false, std::memory_order_release);
+}
+
+inline bool CTrackerMetrics::IsEnabled()
+{
+    return ctracker::detail::enabled.load(std::memory_order_acquire);
+}
+
+inline void CTrackerMetrics::SetSampleInterval(size_t interval)
+{
+    ctracker::detail::sample_interval.store(interval ? interval : 1, std::memory_order_relaxed);
+}
+
+inline size_t CTrackerMetrics::SampleInterval()
+{
+    return ctracker::detail::sample_interval.load(std::memory_order_relaxed);
+}
+
+inline uint64_t CTrackerMetrics::AllocationCount()
+{
+    return ctracker::detail::counters.allocations.load(std::memory_order_relaxed);
+}
+
+inline uint64_t CTrackerMetrics::FreeCount()
+{
+    return ctracker::detail::counters.frees.load(std::memory_order_relaxed);
+}
+
+inline uint64_t CTrackerMetrics::AllocatedBytes()
+{
+    return ctracker::detail::counters.allocated_bytes.load(std::memory_order_relaxed);
 }
 
 #endif
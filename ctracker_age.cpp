@@ -0,0 +1,148 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+#include <cstring>
+
+namespace ctracker
+{
+namespace detail
+{
+
+namespace
+{
+
+void AddBucket(size_t count, size_t bytes, size_t size_class, Generation *out)
+{
+    out->live_count += count;
+    out->live_bytes += bytes;
+    out->bytes_by_class[size_class] += bytes;
+}
+
+} // namespace
+
+AgeTable::AgeTable(uint64_t epoch_ms) : epoch_ns_(epoch_ms * 1000000ull), start_ns_(MonotonicNs())
+{
+    for (Shard &shard : shards_)
+    {
+        shard.current = 0;
+    }
+    Clear();
+}
+
+uint32_t AgeTable::Now() const
+{
+    return static_cast<uint32_t>((MonotonicNs() - start_ns_) / epoch_ns_);
+}
+
+// Must hold the shard lock. Each epoch that starts reuses the slot of the one
+// kEpochs before it.
+void AgeTable::Advance(Shard &shard, uint32_t now)
+{
+    if (static_cast<int32_t>(now - shard.current) <= 0)
+    {
+        return; // another thread read the clock later and got here first
+    }
+    uint32_t steps = now - shard.current < kEpochs ? now - shard.current : kEpochs;
+    for (uint32_t i = 1; i <= steps; i++)
+    {
+        Bucket &slot = shard.epochs[(now - steps + i) % kEpochs];
+        for (size_t c = 0; c < kSizeClasses; c++)
+        {
+            shard.expired.count[c] += slot.count[c];
+            shard.expired.bytes[c] += slot.bytes[c];
+        }
+        slot = Bucket();
+    }
+    shard.current = now;
+}
+
+AgeTable::Shard &AgeTable::Lock(uint32_t thread)
+{
+    Shard &shard = shards_[thread % kShards];
+    shard.mutex.lock();
+    Advance(shard, Now());
+    return shard;
+}
+
+AgeTable::Bucket &AgeTable::BucketFor(Shard &shard, uint32_t epoch)
+{
+    return shard.current - epoch >= kEpochs ? shard.expired : shard.epochs[epoch % kEpochs];
+}
+
+void AgeTable::Add(uint32_t thread, uint32_t epoch, size_t size)
+{
+    Shard &shard = Lock(thread);
+    Bucket &bucket = BucketFor(shard, epoch);
+    size_t size_class = SizeClassOf(size);
+    bucket.count[size_class]++;
+    bucket.bytes[size_class] += size;
+    shard.mutex.unlock();
+}
+
+void AgeTable::Remove(uint32_t thread, uint32_t epoch, size_t size)
+{
+    Shard &shard = Lock(thread);
+    Bucket &bucket = BucketFor(shard, epoch);
+    size_t size_class = SizeClassOf(size);
+    bucket.count[size_class]--;
+    bucket.bytes[size_class] -= size;
+    shard.mutex.unlock();
+}
+
+void AgeTable::Resize(uint32_t thread, uint32_t epoch, size_t old_size, size_t new_size)
+{
+    Shard &shard = Lock(thread);
+    Bucket &bucket = BucketFor(shard, epoch);
+    size_t old_class = SizeClassOf(old_size);
+    size_t new_class = SizeClassOf(new_size);
+    bucket.count[old_class]--;
+    bucket.bytes[old_class] -= old_size;
+    bucket.count[new_class]++;
+    bucket.bytes[new_class] += new_size;
+    shard.mutex.unlock();
+}
+
+void AgeTable::Read(uint64_t young_ms, uint64_t old_ms, AgeDistribution *out)
+{
+    std::memset(out, 0, sizeof(*out));
+
+    uint64_t epoch_ms = epoch_ns_ / 1000000ull;
+    for (size_t i = 0; i < kShards; i++)
+    {
+        Shard &shard = Lock(static_cast<uint32_t>(i));
+        for (uint32_t age = 0; age < kEpochs && age <= shard.current; age++)
+        {
+            const Bucket &bucket = shard.epochs[(shard.current - age) % kEpochs];
+            uint64_t age_ms = age * epoch_ms;
+            Generation *generation = age_ms < young_ms ? &out->young : age_ms < old_ms ? &out->middle : &out->old;
+            for (size_t c = 0; c < kSizeClasses; c++)
+            {
+                AddBucket(bucket.count[c], bucket.bytes[c], c, generation);
+            }
+        }
+        for (size_t c = 0; c < kSizeClasses; c++)
+        {
+            AddBucket(shard.expired.count[c], shard.expired.bytes[c], c, &out->old);
+        }
+        shard.mutex.unlock();
+    }
+}
+
+void AgeTable::Clear()
+{
+    for (Shard &shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (Bucket &bucket : shard.epochs)
+        {
+            bucket = Bucket();
+        }
+        shard.expired = Bucket();
+    }
+}
+
+} // namespace detail
+} // namespace ctracker
+
+#endif
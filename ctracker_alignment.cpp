@@ -0,0 +1,57 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+namespace
+{
+
+// More units of `unit` bytes touched than `size` needs
+bool Straddles(uintptr_t start, size_t size, size_t unit)
+{
+    if (size == 0)
+    {
+        return false;
+    }
+    size_t touched = (start + size - 1) / unit - start / unit + 1;
+    size_t needed = (size + unit - 1) / unit;
+    return touched > needed;
+}
+
+} // namespace
+
+ctracker::AlignmentReport CTrackerMetrics::GetAlignmentReport()
+{
+    ctracker::AlignmentReport report = {};
+
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    SyncSession();
+    ctracker::detail::EpochGuard epoch(skiplist_ != nullptr);
+
+    size_t page_size = regions_->PageSize();
+    for (AllocationRecord *current = FirstRecord(); current; current = NextRecord(current))
+    {
+        uintptr_t start = reinterpret_cast<uintptr_t>(current->ptr);
+        size_t size_class = ctracker::detail::SizeClassOf(current->size);
+        size_t alignment = current->alignment;
+
+        report.records++;
+        if (Straddles(start, current->size, ctracker::kCacheLineSize))
+        {
+            report.line_straddles[size_class]++;
+        }
+        if (Straddles(start, current->size, page_size))
+        {
+            report.page_straddles[size_class]++;
+        }
+        report.padding_bytes[size_class] += (current->size + alignment - 1) / alignment * alignment - current->size;
+
+        if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        {
+            report.over_aligned++;
+            report.extra_alignment_bytes += alignment - __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+        }
+    }
+    return report;
+}
+
+#endif
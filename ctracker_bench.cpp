@@ -0,0 +1,167 @@
+// Tracked new/delete throughput per registry and thread count, and the cost
+// of address lookups and frees with many blocks live.
+//
+// Run without arguments it re-runs itself once per registry (the registry is
+// picked when the tracker is built, so each needs a fresh process) and prints
+// one table. Set CTRACKER_REGISTRY to run a single registry.
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include "ctracker.hpp"
+
+namespace
+{
+
+const int kThreadCounts[] = {1, 2, 4, 8};
+const char *const kRegistries[] = {"list", "tree", "skiplist", "pagemap"};
+const size_t kOpsPerThread = 200000;
+const size_t kRing = 256;
+const size_t kLiveBlocks = 200000;
+const size_t kLookups = 1000000;
+
+// Each thread keeps kRing blocks live and replaces one per operation, so the
+// registry holds threads * kRing records throughout
+void Churn(std::atomic<bool> *go)
+{
+    std::vector<char *> ring(kRing, nullptr);
+    while (!go->load(std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+    for (size_t i = 0; i < kOpsPerThread; i++)
+    {
+        size_t slot = i % kRing;
+        delete[] ring[slot];
+        ring[slot] = new char[16 + (i * 7) % 240];
+    }
+    for (char *block : ring)
+    {
+        delete[] block;
+    }
+}
+
+double Seconds(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+double RunOnce(int threads)
+{
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (int i = 0; i < threads; i++)
+    {
+        workers.emplace_back(Churn, &go);
+    }
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    return Seconds(start);
+}
+
+// FindContaining on interior pointers and deletes in shuffled order
+void RunLookups(const char *name)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    std::vector<char *> blocks(kLiveBlocks);
+    for (size_t i = 0; i < kLiveBlocks; i++)
+    {
+        blocks[i] = new char[16 + (i * 7) % 240];
+    }
+
+    uint64_t state = 88172645463325252ull;
+    auto next = [&state] {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+
+    size_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kLookups; i++)
+    {
+        ctracker::Allocation allocation;
+        found += t->FindContaining(blocks[next() % kLiveBlocks] + 7, &allocation);
+    }
+    double lookup_seconds = Seconds(start);
+
+    for (size_t i = kLiveBlocks; i-- > 1;)
+    {
+        std::swap(blocks[i], blocks[next() % (i + 1)]);
+    }
+    start = std::chrono::steady_clock::now();
+    for (char *block : blocks)
+    {
+        delete[] block;
+    }
+    double delete_seconds = Seconds(start);
+
+    std::printf("%-9s %zu live: %.1f ns per FindContaining (%zu found), %.1f ns per delete\n", name, kLiveBlocks,
+                lookup_seconds * 1e9 / kLookups, found, delete_seconds * 1e9 / kLiveBlocks);
+}
+
+void RunRegistry(const char *name)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    RunOnce(1); // warm up the site table and the allocator
+    uint64_t acquisitions = t->GetLockStats().acquisitions;
+    for (int threads : kThreadCounts)
+    {
+        double seconds = RunOnce(threads);
+        double ops = static_cast<double>(kOpsPerThread) * threads * 2; // a new and a delete
+        std::printf("%-9s %7d %12.1f %10.2f\n", name, threads, seconds * 1e9 / ops, ops / seconds / 1e6);
+    }
+    uint64_t locked = t->GetLockStats().acquisitions - acquisitions;
+    std::printf("%-9s tracker lock acquisitions: %llu\n", name, static_cast<unsigned long long>(locked));
+    // The list's sorted insert is O(n): 200k live blocks would take minutes
+    if (t->GetConfig().registry != ctracker::RegistryKind::List)
+    {
+        RunLookups(name);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    (void)argc;
+    const char *registry = std::getenv("CTRACKER_REGISTRY");
+    if (registry)
+    {
+        RunRegistry(registry);
+        return 0;
+    }
+
+    std::printf("%-9s %7s %12s %10s\n", "registry", "threads", "ns/op", "Mops/s");
+    std::fflush(stdout);
+    for (const char *name : kRegistries)
+    {
+        pid_t child = fork();
+        if (child == 0)
+        {
+            setenv("CTRACKER_REGISTRY", name, 1);
+            execv("/proc/self/exe", argv);
+            _exit(127);
+        }
+        int status = 0;
+        if (child < 0 || waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+        {
+            std::fprintf(stderr, "%s: run failed\n", name);
+            return 1;
+        }
+    }
+    std::printf("(%u hardware threads)\n", std::thread::hardware_concurrency());
+    return 0;
+}
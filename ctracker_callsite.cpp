@@ -0,0 +1,217 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <execinfo.h>
+
+namespace ctracker
+{
+namespace detail
+{
+
+namespace
+{
+
+const size_t kInitialSlots = 256;
+
+size_t HashFrames(void *const *frames, size_t depth)
+{
+    uint64_t hash = 0xcbf29ce484222325ull; // FNV-1a over the return addresses
+    for (size_t i = 0; i < depth; i++)
+    {
+        hash ^= reinterpret_cast<uintptr_t>(frames[i]);
+        hash *= 0x100000001b3ull;
+    }
+    return static_cast<size_t>(hash ^ (hash >> 29));
+}
+
+bool SameFrames(const CallSite *site, void *const *frames, size_t depth)
+{
+    return site->depth == depth && std::memcmp(site->frames, frames, depth * sizeof(void *)) == 0;
+}
+
+} // namespace
+
+size_t CallSiteTable::TableBytes(size_t slots)
+{
+    return offsetof(Table, slots) + slots * sizeof(std::atomic<CallSite *>);
+}
+
+CallSiteTable::CallSiteTable() : table_(nullptr), count_(0), table_bytes_(0) {}
+
+CallSiteTable::~CallSiteTable()
+{
+    Table *table = table_.load(std::memory_order_relaxed);
+    for (size_t i = 0; table && i <= table->mask; i++)
+    {
+        RawFree(table->slots[i].load(std::memory_order_relaxed));
+    }
+    while (table)
+    {
+        Table *older = table->older;
+        RawFree(table);
+        table = older;
+    }
+}
+
+CallSite *CallSiteTable::Lookup(const Table *table, void *const *frames, size_t depth)
+{
+    // Open addressing: sites are never removed, so no tombstones needed
+    size_t slot = HashFrames(frames, depth) & table->mask;
+    while (CallSite *site = table->slots[slot].load(std::memory_order_acquire))
+    {
+        if (SameFrames(site, frames, depth))
+        {
+            return site;
+        }
+        slot = (slot + 1) & table->mask;
+    }
+    return nullptr;
+}
+
+// Must hold mutex_
+bool CallSiteTable::Grow()
+{
+    Table *current = table_.load(std::memory_order_relaxed);
+    size_t slots = current ? (current->mask + 1) * 2 : kInitialSlots;
+    Table *table = static_cast<Table *>(RawCalloc(1, TableBytes(slots)));
+    if (!table)
+    {
+        return false;
+    }
+    table->older = current;
+    table->mask = slots - 1;
+
+    for (size_t i = 0; current && i <= current->mask; i++)
+    {
+        CallSite *site = current->slots[i].load(std::memory_order_relaxed);
+        if (!site)
+        {
+            continue;
+        }
+        size_t slot = HashFrames(site->frames, site->depth) & table->mask;
+        while (table->slots[slot].load(std::memory_order_relaxed))
+        {
+            slot = (slot + 1) & table->mask;
+        }
+        table->slots[slot].store(site, std::memory_order_relaxed);
+    }
+
+    table_bytes_ += TableBytes(slots);
+    table_.store(table, std::memory_order_release);
+    return true;
+}
+
+CallSite *CallSiteTable::Intern(void *const *frames, size_t depth)
+{
+    Table *table = table_.load(std::memory_order_acquire);
+    CallSite *site = table ? Lookup(table, frames, depth) : nullptr;
+    if (site)
+    {
+        return site;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    table = table_.load(std::memory_order_relaxed);
+    if (!table || (count_ + 1) * 4 > (table->mask + 1) * 3)
+    {
+        if (!Grow() && (!table || count_ + 1 > table->mask))
+        {
+            return nullptr;
+        }
+        table = table_.load(std::memory_order_relaxed);
+    }
+    if ((site = Lookup(table, frames, depth)))
+    {
+        return site; // interned by another thread since the lock-free lookup
+    }
+
+    site = static_cast<CallSite *>(RawCalloc(1, sizeof(CallSite)));
+    if (!site)
+    {
+        return nullptr;
+    }
+    site->id = static_cast<uint32_t>(count_);
+    site->depth = static_cast<uint32_t>(depth);
+    std::memcpy(site->frames, frames, depth * sizeof(void *));
+
+    size_t slot = HashFrames(frames, depth) & table->mask;
+    while (table->slots[slot].load(std::memory_order_relaxed))
+    {
+        slot = (slot + 1) & table->mask;
+    }
+    table->slots[slot].store(site, std::memory_order_release);
+    count_++;
+    return site;
+}
+
+void CallSiteTable::ResetLiveStats()
+{
+    ForEach([](CallSite *site, void *)
+    {
+        __atomic_store_n(&site->live_count, size_t(0), __ATOMIC_RELAXED);
+        __atomic_store_n(&site->live_bytes, size_t(0), __ATOMIC_RELAXED);
+        __atomic_store_n(&site->estimated_live_bytes, size_t(0), __ATOMIC_RELAXED);
+    }, nullptr);
+}
+
+void CallSiteTable::ForEach(void (*visitor)(CallSite *site, void *context), void *context) const
+{
+    const Table *table = table_.load(std::memory_order_acquire);
+    for (size_t i = 0; table && i <= table->mask; i++)
+    {
+        if (CallSite *site = table->slots[i].load(std::memory_order_acquire))
+        {
+            visitor(site, context);
+        }
+    }
+}
+
+size_t CallSiteTable::MetadataBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sizeof(*this) + count_ * sizeof(CallSite) + table_bytes_;
+}
+
+size_t CaptureStack(void **frames, size_t depth, const void *caller)
+{
+    if (depth == 0)
+    {
+        return 0;
+    }
+    if (depth == 1)
+    {
+        frames[0] = const_cast<void *>(caller);
+        return 1;
+    }
+
+    // Unwind, then drop the tracker's own frames: everything above `caller`.
+    // Only as deep as needed; the cost grows with every frame.
+    void *buffer[kMaxStackDepth + 8];
+    int captured = backtrace(buffer, static_cast<int>(depth + 8));
+
+    int start = 0;
+    while (start < captured && buffer[start] != caller)
+    {
+        start++;
+    }
+    if (start == captured)
+    {
+        start = captured > 2 ? 2 : 0;
+    }
+
+    size_t count = 0;
+    for (int i = start; i < captured && count < depth; i++)
+    {
+        frames[count++] = buffer[i];
+    }
+    return count;
+}
+
+} // namespace detail
+} // namespace ctracker
+
+#endif
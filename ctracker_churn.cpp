@@ -0,0 +1,108 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+#include <algorithm>
+
+namespace ctracker
+{
+namespace detail
+{
+
+namespace
+{
+
+size_t HashPair(const CallSite *site, size_t size)
+{
+    uint64_t hash = (reinterpret_cast<uintptr_t>(site) ^ (static_cast<uint64_t>(size) << 32)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(hash >> 32);
+}
+
+} // namespace
+
+void ChurnTable::Record(CallSite *site, size_t size, uint32_t epoch)
+{
+    Set &set = sets_[HashPair(site, size) % kSets];
+    std::lock_guard<std::mutex> lock(set.mutex);
+    Entry *victim = &set.ways[0];
+    for (size_t way = 0; way < kWays; way++)
+    {
+        Entry &entry = set.ways[way];
+        if (entry.site == site && entry.size == size)
+        {
+            entry.count++;
+            return;
+        }
+        if (entry.count < victim->count)
+        {
+            victim = &entry;
+        }
+    }
+
+    // The inherited count may all belong to the evicted pair: keep it as the
+    // error bound, so only count - error is credited to the new one
+    victim->site = site;
+    victim->size = size;
+    victim->error = victim->count;
+    victim->count++;
+    victim->first_epoch = epoch;
+}
+
+size_t ChurnTable::Top(ChurnCandidate *out, size_t max, uint32_t now, uint64_t epoch_ms)
+{
+    size_t found = 0;
+    for (Set &set : sets_)
+    {
+        Entry ways[kWays];
+        {
+            std::lock_guard<std::mutex> lock(set.mutex);
+            std::copy(set.ways, set.ways + kWays, ways);
+        }
+        for (const Entry &entry : ways)
+        {
+            if (!entry.site)
+            {
+                continue;
+            }
+
+            uint64_t guaranteed = entry.count - entry.error;
+            double seconds = static_cast<double>(now - entry.first_epoch + 1) * static_cast<double>(epoch_ms) / 1000.0;
+            ChurnCandidate candidate = {entry.site, entry.size, guaranteed, 0, 0};
+            candidate.frees_per_second = static_cast<double>(guaranteed) / seconds;
+            candidate.bytes_per_second = candidate.frees_per_second * static_cast<double>(entry.size);
+
+            // Insertion into the sorted prefix, dropping whatever falls off the end
+            size_t i = found < max ? found++ : max;
+            while (i > 0 && out[i - 1].frees_per_second < candidate.frees_per_second)
+            {
+                if (i < max)
+                {
+                    out[i] = out[i - 1];
+                }
+                i--;
+            }
+            if (i < max)
+            {
+                out[i] = candidate;
+            }
+        }
+    }
+    return found;
+}
+
+void ChurnTable::Clear()
+{
+    for (Set &set : sets_)
+    {
+        std::lock_guard<std::mutex> lock(set.mutex);
+        for (Entry &entry : set.ways)
+        {
+            entry = Entry();
+        }
+    }
+}
+
+} // namespace detail
+} // namespace ctracker
+
+#endif
@@ -0,0 +1,384 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Everything in this file runs inside the first `operator new`, before the
+// tracker exists: no heap, no iostreams, only fixed buffers and syscalls.
+
+namespace ctracker
+{
+
+namespace
+{
+
+const size_t kMaxConfigFile = 4096;
+
+bool ParseUnsigned(const char *value, size_t length, size_t *out)
+{
+    if (length == 0)
+    {
+        return false;
+    }
+
+    size_t result = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (value[i] < '0' || value[i] > '9')
+        {
+            return false;
+        }
+        size_t digit = static_cast<size_t>(value[i] - '0');
+        if (result > (SIZE_MAX - digit) / 10)
+        {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+    *out = result;
+    return true;
+}
+
+bool ParseSignal(const char *value, size_t length, int *out)
+{
+    size_t signo = 0;
+    if (!ParseUnsigned(value, length, &signo) || signo < 1 || signo >= NSIG)
+    {
+        return false;
+    }
+    *out = static_cast<int>(signo);
+    return true;
+}
+
+bool ParseBool(const char *value, size_t length, bool *out)
+{
+    if ((length == 1 && value[0] == '1') || (length == 4 && std::strncmp(value, "true", 4) == 0) ||
+        (length == 2 && std::strncmp(value, "on", 2) == 0))
+    {
+        *out = true;
+        return true;
+    }
+    if ((length == 1 && value[0] == '0') || (length == 5 && std::strncmp(value, "false", 5) == 0) ||
+        (length == 3 && std::strncmp(value, "off", 3) == 0))
+    {
+        *out = false;
+        return true;
+    }
+    return false;
+}
+
+bool ParseRegistry(const char *value, size_t length, RegistryKind *out)
+{
+    if (length == 4 && std::strncmp(value, "list", 4) == 0)
+    {
+        *out = RegistryKind::List;
+        return true;
+    }
+    if (length == 4 && std::strncmp(value, "tree", 4) == 0)
+    {
+        *out = RegistryKind::Tree;
+        return true;
+    }
+    if (length == 8 && std::strncmp(value, "skiplist", 8) == 0)
+    {
+        *out = RegistryKind::SkipList;
+        return true;
+    }
+    if (length == 7 && std::strncmp(value, "pagemap", 7) == 0)
+    {
+        *out = RegistryKind::PageMap;
+        return true;
+    }
+    return false;
+}
+
+bool ParseFreeCheck(const char *value, size_t length, FreeCheck *out)
+{
+    bool on;
+    if (ParseBool(value, length, &on))
+    {
+        *out = on ? FreeCheck::Report : FreeCheck::Off;
+        return true;
+    }
+    if (length == 6 && std::strncmp(value, "report", 6) == 0)
+    {
+        *out = FreeCheck::Report;
+        return true;
+    }
+    if (length == 5 && std::strncmp(value, "abort", 5) == 0)
+    {
+        *out = FreeCheck::Abort;
+        return true;
+    }
+    return false;
+}
+
+bool KeyIs(const char *key, size_t length, const char *name)
+{
+    return std::strlen(name) == length && std::strncmp(key, name, length) == 0;
+}
+
+bool SetValue(Config *config, const char *key, size_t key_length, const char *value, size_t value_length)
+{
+    if (KeyIs(key, key_length, "enabled"))
+    {
+        return ParseBool(value, value_length, &config->enabled);
+    }
+    if (KeyIs(key, key_length, "sample_interval"))
+    {
+        return ParseUnsigned(value, value_length, &config->sample_interval);
+    }
+    if (KeyIs(key, key_length, "registry"))
+    {
+        return ParseRegistry(value, value_length, &config->registry);
+    }
+    if (KeyIs(key, key_length, "shards"))
+    {
+        return ParseUnsigned(value, value_length, &config->shards);
+    }
+    if (KeyIs(key, key_length, "stack_depth"))
+    {
+        return ParseUnsigned(value, value_length, &config->stack_depth);
+    }
+    if (KeyIs(key, key_length, "export_interval_ms"))
+    {
+        return ParseUnsigned(value, value_length, &config->export_interval_ms);
+    }
+    if (KeyIs(key, key_length, "output_path"))
+    {
+        if (value_length >= kMaxPathLength)
+        {
+            return false;
+        }
+        std::memcpy(config->output_path, value, value_length);
+        config->output_path[value_length] = '\0';
+        return true;
+    }
+    if (KeyIs(key, key_length, "free_check"))
+    {
+        return ParseFreeCheck(value, value_length, &config->free_check);
+    }
+    if (KeyIs(key, key_length, "age_epoch_ms"))
+    {
+        return ParseUnsigned(value, value_length, &config->age_epoch_ms);
+    }
+    if (KeyIs(key, key_length, "allocator_latency"))
+    {
+        return ParseBool(value, value_length, &config->allocator_latency);
+    }
+    if (KeyIs(key, key_length, "latency_outlier_ns"))
+    {
+        return ParseUnsigned(value, value_length, &config->latency_outlier_ns);
+    }
+    if (KeyIs(key, key_length, "overhead_budget_permille"))
+    {
+        return ParseUnsigned(value, value_length, &config->overhead_budget_permille);
+    }
+    if (KeyIs(key, key_length, "occupancy_bitmap"))
+    {
+        return ParseBool(value, value_length, &config->occupancy_bitmap);
+    }
+    if (KeyIs(key, key_length, "toggle_signal"))
+    {
+        return ParseSignal(value, value_length, &config->toggle_signal);
+    }
+    if (KeyIs(key, key_length, "crash_dump_path"))
+    {
+        if (value_length >= kMaxPathLength)
+        {
+            return false;
+        }
+        std::memcpy(config->crash_dump_path, value, value_length);
+        config->crash_dump_path[value_length] = '\0';
+        return true;
+    }
+    if (KeyIs(key, key_length, "dump_signal"))
+    {
+        return ParseSignal(value, value_length, &config->dump_signal);
+    }
+    return false;
+}
+
+struct EnvKey
+{
+    const char *key;
+    const char *env;
+};
+
+const EnvKey kEnvKeys[] = {
+    {"enabled", "CTRACKER_ENABLED"},
+    {"sample_interval", "CTRACKER_SAMPLE_INTERVAL"},
+    {"registry", "CTRACKER_REGISTRY"},
+    {"shards", "CTRACKER_SHARDS"},
+    {"stack_depth", "CTRACKER_STACK_DEPTH"},
+    {"export_interval_ms", "CTRACKER_EXPORT_INTERVAL_MS"},
+    {"output_path", "CTRACKER_OUTPUT_PATH"},
+    {"toggle_signal", "CTRACKER_TOGGLE_SIGNAL"},
+    {"free_check", "CTRACKER_FREE_CHECK"},
+    {"age_epoch_ms", "CTRACKER_AGE_EPOCH_MS"},
+    {"allocator_latency", "CTRACKER_ALLOCATOR_LATENCY"},
+    {"latency_outlier_ns", "CTRACKER_LATENCY_OUTLIER_NS"},
+    {"overhead_budget_permille", "CTRACKER_OVERHEAD_BUDGET_PERMILLE"},
+    {"occupancy_bitmap", "CTRACKER_OCCUPANCY_BITMAP"},
+    {"crash_dump_path", "CTRACKER_CRASH_DUMP_PATH"},
+    {"dump_signal", "CTRACKER_DUMP_SIGNAL"},
+};
+
+void Trim(const char **begin, const char **end)
+{
+    while (*begin < *end && (**begin == ' ' || **begin == '\t' || **begin == '\r'))
+    {
+        (*begin)++;
+    }
+    while (*end > *begin && ((*end)[-1] == ' ' || (*end)[-1] == '\t' || (*end)[-1] == '\r'))
+    {
+        (*end)--;
+    }
+}
+
+// `ctracker: <what>: <problem>` on stderr, in one write
+void Warn(const char *what, const char *problem)
+{
+    char line[kMaxPathLength + 128];
+    size_t used = 0;
+    for (const char *part : {"ctracker: ", what, ": ", problem, "\n"})
+    {
+        size_t length = std::strlen(part);
+        if (length > sizeof(line) - used)
+        {
+            length = sizeof(line) - used;
+        }
+        std::memcpy(line + used, part, length);
+        used += length;
+    }
+    ssize_t ignored = write(STDERR_FILENO, line, used);
+    (void)ignored;
+}
+
+// Clamp to values the tracker can actually run with
+void Normalize(Config *config)
+{
+    if (config->sample_interval == 0)
+    {
+        config->sample_interval = 1;
+    }
+
+    size_t shards = 1;
+    while (shards < config->shards && shards < detail::PointerIndex::kMaxShards)
+    {
+        shards <<= 1;
+    }
+    config->shards = shards;
+
+    if (config->stack_depth > kMaxStackDepth)
+    {
+        config->stack_depth = kMaxStackDepth;
+    }
+
+    if (config->age_epoch_ms == 0)
+    {
+        config->age_epoch_ms = 1;
+    }
+}
+
+} // namespace
+
+bool ParseConfig(const char *text, size_t length, Config *config)
+{
+    bool ok = true;
+    const char *end = text + length;
+
+    while (text < end)
+    {
+        const char *line_end = static_cast<const char *>(std::memchr(text, '\n', end - text));
+        if (!line_end)
+        {
+            line_end = end;
+        }
+
+        const char *comment = static_cast<const char *>(std::memchr(text, '#', line_end - text));
+        const char *content_end = comment ? comment : line_end;
+        const char *eq = static_cast<const char *>(std::memchr(text, '=', content_end - text));
+
+        const char *key = text;
+        const char *key_end = eq ? eq : content_end;
+        Trim(&key, &key_end);
+
+        if (key != key_end)
+        {
+            if (!eq)
+            {
+                ok = false;
+            }
+            else
+            {
+                const char *value = eq + 1;
+                const char *value_end = content_end;
+                Trim(&value, &value_end);
+                ok &= SetValue(config, key, key_end - key, value, value_end - value);
+            }
+        }
+
+        text = line_end + 1;
+    }
+    return ok;
+}
+
+Config LoadConfig()
+{
+    Config config;
+
+    const char *path = std::getenv("CTRACKER_CONFIG");
+    if (path && path[0])
+    {
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0)
+        {
+            char buffer[kMaxConfigFile];
+            size_t length = 0;
+            ssize_t n;
+            while (length < sizeof(buffer) && (n = read(fd, buffer + length, sizeof(buffer) - length)) > 0)
+            {
+                length += static_cast<size_t>(n);
+            }
+            // A truncated file could end in half a key or value; take none of it
+            char extra;
+            bool oversized = length == sizeof(buffer) && read(fd, &extra, 1) > 0;
+            close(fd);
+            if (oversized)
+            {
+                Warn(path, "larger than 4096 bytes, ignored");
+            }
+            else if (!ParseConfig(buffer, length, &config))
+            {
+                Warn(path, "invalid lines ignored");
+            }
+        }
+        else
+        {
+            Warn(path, "cannot be opened, ignored");
+        }
+    }
+
+    for (const EnvKey &entry : kEnvKeys)
+    {
+        const char *value = std::getenv(entry.env);
+        if (value && !SetValue(&config, entry.key, std::strlen(entry.key), value, std::strlen(value)))
+        {
+            Warn(entry.env, "invalid value ignored");
+        }
+    }
+
+    Normalize(&config);
+    return config;
+}
+
+} // namespace ctracker
+
+#endif
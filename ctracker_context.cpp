@@ -0,0 +1,233 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+namespace ctracker
+{
+namespace detail
+{
+
+namespace
+{
+
+const size_t kInitialSlots = 16;
+
+inline size_t HashContext(ContextId id)
+{
+    uint64_t hash = id * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+} // namespace
+
+ContextTable::ContextTable()
+{
+    for (Shard &shard : shards_)
+    {
+        shard.slots = nullptr;
+        shard.mask = 0;
+        shard.count = 0;
+    }
+}
+
+ContextTable::~ContextTable()
+{
+    for (Shard &shard : shards_)
+    {
+        RawFree(shard.slots);
+    }
+}
+
+ContextTable::Shard &ContextTable::ShardFor(ContextId id, size_t *hash)
+{
+    *hash = HashContext(id);
+    // The low bits pick the slot, so the shard comes from the top ones
+    return shards_[(*hash >> 28) % kShards];
+}
+
+// Must hold the shard lock
+ContextStats *ContextTable::Lookup(Shard &shard, ContextId id, size_t hash)
+{
+    if (!shard.slots)
+    {
+        return nullptr;
+    }
+    size_t slot = hash & shard.mask;
+    while (shard.slots[slot].id)
+    {
+        if (shard.slots[slot].id == id)
+        {
+            return &shard.slots[slot];
+        }
+        slot = (slot + 1) & shard.mask;
+    }
+    return nullptr;
+}
+
+// Must hold the shard lock
+bool ContextTable::Grow(Shard &shard)
+{
+    size_t slots = shard.slots ? (shard.mask + 1) * 2 : kInitialSlots;
+    ContextStats *table = static_cast<ContextStats *>(RawCalloc(slots, sizeof(ContextStats)));
+    if (!table)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; shard.slots && i <= shard.mask; i++)
+    {
+        if (!shard.slots[i].id)
+        {
+            continue;
+        }
+        size_t slot = HashContext(shard.slots[i].id) & (slots - 1);
+        while (table[slot].id)
+        {
+            slot = (slot + 1) & (slots - 1);
+        }
+        table[slot] = shard.slots[i];
+    }
+
+    RawFree(shard.slots);
+    shard.slots = table;
+    shard.mask = slots - 1;
+    return true;
+}
+
+// Must hold the shard lock. Backward-shift delete: later entries of the probe
+// run move up into the hole, so lookups never need tombstones
+void ContextTable::Erase(Shard &shard, size_t slot)
+{
+    size_t hole = slot;
+    for (size_t next = (hole + 1) & shard.mask; shard.slots[next].id; next = (next + 1) & shard.mask)
+    {
+        size_t home = HashContext(shard.slots[next].id) & shard.mask;
+        if (((next - home) & shard.mask) >= ((next - hole) & shard.mask))
+        {
+            shard.slots[hole] = shard.slots[next];
+            hole = next;
+        }
+    }
+    shard.slots[hole] = ContextStats();
+    shard.count--;
+}
+
+bool ContextTable::Add(ContextId id, size_t size)
+{
+    size_t hash;
+    Shard &shard = ShardFor(id, &hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    ContextStats *stats = Lookup(shard, id, hash);
+    if (!stats)
+    {
+        if ((!shard.slots || (shard.count + 1) * 4 > (shard.mask + 1) * 3) && !Grow(shard) &&
+            (!shard.slots || shard.count + 1 > shard.mask))
+        {
+            return false;
+        }
+        size_t slot = hash & shard.mask;
+        while (shard.slots[slot].id)
+        {
+            slot = (slot + 1) & shard.mask;
+        }
+        stats = &shard.slots[slot];
+        stats->id = id;
+        shard.count++;
+    }
+    stats->allocations++;
+    stats->live_count++;
+    stats->live_bytes += size;
+    return true;
+}
+
+void ContextTable::Remove(ContextId id, size_t size)
+{
+    size_t hash;
+    Shard &shard = ShardFor(id, &hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ContextStats *stats = Lookup(shard, id, hash);
+    if (!stats)
+    {
+        return;
+    }
+    stats->live_bytes -= size;
+    // Contexts are often per request: keeping the empty ones would grow the
+    // table for as long as the process runs
+    if (--stats->live_count == 0)
+    {
+        Erase(shard, static_cast<size_t>(stats - shard.slots));
+    }
+}
+
+void ContextTable::Resize(ContextId id, size_t old_size, size_t new_size)
+{
+    size_t hash;
+    Shard &shard = ShardFor(id, &hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (ContextStats *stats = Lookup(shard, id, hash))
+    {
+        stats->live_bytes = stats->live_bytes - old_size + new_size;
+    }
+}
+
+bool ContextTable::Find(ContextId id, ContextStats *out)
+{
+    size_t hash;
+    Shard &shard = ShardFor(id, &hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ContextStats *stats = Lookup(shard, id, hash);
+    if (!stats)
+    {
+        return false;
+    }
+    *out = *stats;
+    return true;
+}
+
+void ContextTable::ForEach(ContextVisitor visitor, void *context)
+{
+    for (Shard &shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (size_t i = 0; shard.slots && i <= shard.mask; i++)
+        {
+            if (shard.slots[i].id)
+            {
+                visitor(shard.slots[i], context);
+            }
+        }
+    }
+}
+
+void ContextTable::Clear()
+{
+    for (Shard &shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (size_t i = 0; shard.slots && i <= shard.mask; i++)
+        {
+            shard.slots[i] = ContextStats();
+        }
+        shard.count = 0;
+    }
+}
+
+size_t ContextTable::MetadataBytes()
+{
+    size_t bytes = sizeof(*this);
+    for (Shard &shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.slots)
+        {
+            bytes += (shard.mask + 1) * sizeof(ContextStats);
+        }
+    }
+    return bytes;
+}
+
+} // namespace detail
+} // namespace ctracker
+
+#endif
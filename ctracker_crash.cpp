@@ -0,0 +1,521 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Runs inside signal handlers, possibly on a thread that crashed in the middle
+// of the tracker: only write(), getpid(), sigaction() and raise(), no stdio,
+// no heap and no blocking locks. Everything is formatted into a static buffer.
+
+namespace
+{
+
+const int kCrashSignals[] = {SIGABRT, SIGSEGV, SIGBUS};
+const size_t kCrashSignalCount = sizeof(kCrashSignals) / sizeof(kCrashSignals[0]);
+const size_t kTopSites = 16;
+const size_t kAltStackSize = 64 * 1024;
+
+const char *const kOpNames[ctracker::kAllocatorOps] = {"malloc", "free", "realloc"};
+
+std::atomic<CTrackerMetrics *> dump_tracker(nullptr);
+std::atomic<int> dump_fd(-1);
+int dump_signo = 0;
+bool installed = false;
+struct sigaction previous_crash[kCrashSignalCount];
+struct sigaction previous_dump;
+
+// Kernel thread id of the thread writing a dump signal's dump, or a fatal
+// signal's, 0 if none. A dump signal during either skips its own. A fatal
+// signal writes with its own writer, so it can interrupt a dump on its own
+// thread; one on another thread gets kDumpWaitSteps * kDumpWaitNs to finish
+// first, so the two don't interleave in the file.
+std::atomic<long> dump_owner(0);
+std::atomic<long> crash_owner(0);
+const int kDumpWaitSteps = 100;
+const long kDumpWaitNs = 1000000;
+
+// Fatal signals may come from a stack overflow, which needs a stack of its
+// own. Every thread gets one from its first tracked allocation on, while the
+// handlers are installed; threads that never allocate through the tracker
+// have none and die without a dump on overflow.
+std::atomic<bool> wants_alt_stacks(false);
+thread_local bool alt_stack_checked = false;
+thread_local void *own_alt_stack = nullptr;
+pthread_once_t alt_stack_key_once = PTHREAD_ONCE_INIT;
+pthread_key_t alt_stack_key;
+bool alt_stack_key_ok = false;
+
+class DumpWriter
+{
+public:
+    void Begin(int fd)
+    {
+        fd_ = fd;
+        used_ = 0;
+        ok_ = true;
+    }
+
+    bool End()
+    {
+        Flush();
+        return ok_;
+    }
+
+    void Put(const char *text)
+    {
+        for (; *text; text++)
+        {
+            if (used_ == sizeof(buffer_))
+            {
+                Flush();
+            }
+            buffer_[used_++] = *text;
+        }
+    }
+
+    void PutUnsigned(uint64_t value)
+    {
+        char digits[21];
+        size_t i = sizeof(digits) - 1;
+        digits[i] = '\0';
+        do
+        {
+            digits[--i] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value);
+        Put(digits + i);
+    }
+
+    void PutHex(uintptr_t value)
+    {
+        char digits[2 * sizeof(uintptr_t) + 3];
+        size_t i = sizeof(digits) - 1;
+        digits[i] = '\0';
+        do
+        {
+            digits[--i] = "0123456789abcdef"[value & 15];
+            value >>= 4;
+        } while (value);
+        digits[--i] = 'x';
+        digits[--i] = '0';
+        Put(digits + i);
+    }
+
+    // `name value`
+    void Line(const char *name, uint64_t value)
+    {
+        Put(name);
+        Put(" ");
+        PutUnsigned(value);
+        Put("\n");
+    }
+
+private:
+    void Flush()
+    {
+        size_t done = 0;
+        while (ok_ && done < used_)
+        {
+            ssize_t n = write(fd_, buffer_ + done, used_ - done);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                ok_ = false;
+                break;
+            }
+            done += static_cast<size_t>(n);
+        }
+        used_ = 0;
+    }
+
+    int fd_;
+    size_t used_;
+    bool ok_;
+    char buffer_[4096];
+};
+
+DumpWriter dump_writer;
+DumpWriter crash_writer;
+
+struct TopSites
+{
+    const ctracker::CallSite *sites[kTopSites];
+    size_t count;
+};
+
+// Keeps the largest sites by live bytes, sorted
+void CollectTopSite(ctracker::CallSite *site, void *context)
+{
+    TopSites *top = static_cast<TopSites *>(context);
+    size_t live_bytes = ctracker::detail::LoadRelaxed(site->live_bytes);
+    if (!live_bytes)
+    {
+        return;
+    }
+    size_t i = top->count < kTopSites ? top->count++ : kTopSites;
+    while (i > 0 && ctracker::detail::LoadRelaxed(top->sites[i - 1]->live_bytes) < live_bytes)
+    {
+        if (i < kTopSites)
+        {
+            top->sites[i] = top->sites[i - 1];
+        }
+        i--;
+    }
+    if (i < kTopSites)
+    {
+        top->sites[i] = site;
+    }
+}
+
+bool IsCrashSignal(int signo)
+{
+    for (int crash : kCrashSignals)
+    {
+        if (crash == signo)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+long ThreadId()
+{
+    return syscall(SYS_gettid);
+}
+
+// nanosleep is async-signal-safe
+void WaitForOwner(const std::atomic<long> &owner)
+{
+    struct timespec step = {0, kDumpWaitNs};
+    for (int i = 0; i < kDumpWaitSteps && owner.load(std::memory_order_acquire); i++)
+    {
+        nanosleep(&step, nullptr);
+    }
+}
+
+void WriteDump(int signo)
+{
+    CTrackerMetrics *tracker = dump_tracker.load(std::memory_order_acquire);
+    int fd = dump_fd.load(std::memory_order_acquire);
+    if (!tracker || fd < 0 || crash_owner.load(std::memory_order_acquire))
+    {
+        return;
+    }
+    long expected = 0;
+    if (!dump_owner.compare_exchange_strong(expected, ThreadId(), std::memory_order_acquire))
+    {
+        return;
+    }
+    tracker->WriteCrashDump(fd, signo);
+    dump_owner.store(0, std::memory_order_release);
+}
+
+void WriteCrash(int signo)
+{
+    CTrackerMetrics *tracker = dump_tracker.load(std::memory_order_acquire);
+    int fd = dump_fd.load(std::memory_order_acquire);
+    if (!tracker || fd < 0)
+    {
+        return;
+    }
+    long self = ThreadId();
+    long expected = 0;
+    if (!crash_owner.compare_exchange_strong(expected, self, std::memory_order_acquire))
+    {
+        // A fault inside this thread's own crash dump ends it here. Another
+        // thread's is given time to finish before this one hands the signal on.
+        if (expected != self)
+        {
+            WaitForOwner(crash_owner);
+        }
+        return;
+    }
+    long dumper = dump_owner.load(std::memory_order_acquire);
+    if (dumper && dumper != self)
+    {
+        WaitForOwner(dump_owner);
+    }
+    tracker->WriteCrashDump(fd, signo);
+    crash_owner.store(0, std::memory_order_release);
+}
+
+void CrashHandler(int signo, siginfo_t *info, void *)
+{
+    int saved_errno = errno;
+    WriteCrash(signo);
+
+    // Hand over to whatever was installed before. A fault returns to the
+    // faulting instruction and is raised again there; a signal that was sent
+    // (kill, abort) has to be raised again explicitly.
+    for (size_t i = 0; i < kCrashSignalCount; i++)
+    {
+        if (kCrashSignals[i] == signo)
+        {
+            sigaction(signo, &previous_crash[i], nullptr);
+        }
+    }
+    if (info->si_code <= 0)
+    {
+        raise(signo);
+    }
+    errno = saved_errno;
+}
+
+void DumpHandler(int signo)
+{
+    int saved_errno = errno;
+    WriteDump(signo);
+    errno = saved_errno;
+}
+
+// Thread exit: the stack is ours only if nobody replaced it since
+void ReleaseAltStack(void *)
+{
+    stack_t current;
+    if (own_alt_stack && sigaltstack(nullptr, &current) == 0 && current.ss_sp == own_alt_stack)
+    {
+        stack_t disable = {};
+        disable.ss_flags = SS_DISABLE;
+        sigaltstack(&disable, nullptr);
+        ctracker::detail::RawUnmap(own_alt_stack, kAltStackSize);
+    }
+    own_alt_stack = nullptr;
+}
+
+void CreateAltStackKey()
+{
+    alt_stack_key_ok = pthread_key_create(&alt_stack_key, ReleaseAltStack) == 0;
+}
+
+void UseAltStack()
+{
+    alt_stack_checked = true;
+    stack_t current;
+    if (sigaltstack(nullptr, &current) == 0 && !(current.ss_flags & SS_DISABLE))
+    {
+        return; // the thread already has one
+    }
+
+    // pthread_setspecific may allocate
+    bool saved = ctracker::detail::lock_tracker;
+    ctracker::detail::lock_tracker = true;
+    pthread_once(&alt_stack_key_once, CreateAltStackKey);
+    void *memory = alt_stack_key_ok ? ctracker::detail::RawMap(kAltStackSize) : nullptr;
+    if (memory && pthread_setspecific(alt_stack_key, memory) == 0)
+    {
+        stack_t stack = {};
+        stack.ss_sp = memory;
+        stack.ss_size = kAltStackSize;
+        if (sigaltstack(&stack, nullptr) == 0)
+        {
+            own_alt_stack = memory;
+        }
+        else
+        {
+            pthread_setspecific(alt_stack_key, nullptr);
+            ctracker::detail::RawUnmap(memory, kAltStackSize);
+        }
+    }
+    else if (memory)
+    {
+        ctracker::detail::RawUnmap(memory, kAltStackSize);
+    }
+    ctracker::detail::lock_tracker = saved;
+}
+
+void Uninstall()
+{
+    if (!installed)
+    {
+        return;
+    }
+    for (size_t i = 0; i < kCrashSignalCount; i++)
+    {
+        sigaction(kCrashSignals[i], &previous_crash[i], nullptr);
+    }
+    if (dump_signo)
+    {
+        sigaction(dump_signo, &previous_dump, nullptr);
+    }
+    dump_signo = 0;
+    installed = false;
+    wants_alt_stacks.store(false, std::memory_order_relaxed);
+    dump_fd.store(-1, std::memory_order_release);
+}
+
+} // namespace
+
+namespace ctracker
+{
+namespace detail
+{
+
+bool InstallCrashDump(CTrackerMetrics *tracker, int fd, int signo)
+{
+    Uninstall();
+    if (fd < 0)
+    {
+        return true;
+    }
+    if (signo < 0 || IsCrashSignal(signo))
+    {
+        return false;
+    }
+
+    dump_tracker.store(tracker, std::memory_order_release);
+    dump_fd.store(fd, std::memory_order_release);
+    wants_alt_stacks.store(true, std::memory_order_relaxed);
+    UseAltStack();
+
+    struct sigaction action = {};
+    action.sa_sigaction = CrashHandler;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    for (size_t i = 0; i < kCrashSignalCount; i++)
+    {
+        if (sigaction(kCrashSignals[i], &action, &previous_crash[i]) != 0)
+        {
+            while (i-- > 0)
+            {
+                sigaction(kCrashSignals[i], &previous_crash[i], nullptr);
+            }
+            dump_fd.store(-1, std::memory_order_release);
+            return false;
+        }
+    }
+    installed = true;
+
+    if (signo)
+    {
+        struct sigaction dump = {};
+        dump.sa_handler = DumpHandler;
+        dump.sa_flags = SA_RESTART | SA_ONSTACK;
+        sigemptyset(&dump.sa_mask);
+        if (sigaction(signo, &dump, &previous_dump) != 0)
+        {
+            Uninstall();
+            return false;
+        }
+        dump_signo = signo;
+    }
+    return true;
+}
+
+void PrepareCrashStack()
+{
+    if (!alt_stack_checked && wants_alt_stacks.load(std::memory_order_relaxed))
+    {
+        UseAltStack();
+    }
+}
+
+} // namespace detail
+} // namespace ctracker
+
+bool CTrackerMetrics::InstallCrashDump(int fd, int dump_signo)
+{
+    return ctracker::detail::InstallCrashDump(GetTracker(), fd, dump_signo);
+}
+
+bool CTrackerMetrics::WriteCrashDump(int fd, int signo)
+{
+    DumpWriter &writer = IsCrashSignal(signo) ? crash_writer : dump_writer;
+    writer.Begin(fd);
+    writer.Line("crash_signal", static_cast<uint64_t>(signo));
+    writer.Line("crash_pid", static_cast<uint64_t>(getpid()));
+    writer.Line("enabled", IsEnabled() ? 1 : 0);
+    writer.Line("sample_interval", SampleInterval());
+    writer.Line("allocations", AllocationCount());
+    writer.Line("frees", FreeCount());
+    writer.Line("allocated_bytes", AllocatedBytes());
+    writer.Line("records", ctracker::detail::LoadRelaxed(RecordCount));
+    writer.Line("estimated_live_count", ctracker::detail::LoadRelaxed(estimated_live_count_));
+    writer.Line("estimated_live_bytes", ctracker::detail::LoadRelaxed(estimated_live_bytes_));
+    writer.Line("overhead_reentrant_skips",
+                ctracker::detail::counters.reentrant_skips.load(std::memory_order_relaxed));
+
+    for (size_t i = 0; i < ctracker::kCycleBuckets; i++)
+    {
+        uint64_t count = ctracker::detail::hook_cycles[i].load(std::memory_order_relaxed);
+        if (count)
+        {
+            writer.Put("overhead_hook_cycles.");
+            writer.PutUnsigned(i);
+            writer.Put(" ");
+            writer.PutUnsigned(count);
+            writer.Put("\n");
+        }
+    }
+
+    for (size_t op = 0; op < ctracker::kAllocatorOps; op++)
+    {
+        ctracker::LatencyHistogram total = {};
+        for (size_t size_class = 0; size_class < ctracker::kSizeClasses; size_class++)
+        {
+            ctracker::LatencyHistogram histogram;
+            GetAllocatorLatency(static_cast<ctracker::AllocatorOp>(op), size_class, &histogram);
+            for (size_t i = 0; i < ctracker::kLatencyBuckets; i++)
+            {
+                total.counts[i] += histogram.counts[i];
+            }
+            total.calls += histogram.calls;
+            total.max_ns = total.max_ns > histogram.max_ns ? total.max_ns : histogram.max_ns;
+        }
+        if (!total.calls)
+        {
+            continue;
+        }
+        const char *metrics[] = {".calls ", ".p50_ns ", ".p99_ns ", ".max_ns "};
+        uint64_t values[] = {total.calls, ctracker::LatencyPercentile(total, 50),
+                             ctracker::LatencyPercentile(total, 99), total.max_ns};
+        for (size_t i = 0; i < 4; i++)
+        {
+            writer.Put("allocator_latency.");
+            writer.Put(kOpNames[op]);
+            writer.Put(metrics[i]);
+            writer.PutUnsigned(values[i]);
+            writer.Put("\n");
+        }
+    }
+
+    // The site table is walked without the lock, so this is safe from any
+    // signal, even one that interrupted the tracker mid-update
+    TopSites top = {};
+    sites_->ForEach(CollectTopSite, &top);
+    for (size_t i = 0; i < top.count; i++)
+    {
+        const ctracker::CallSite *site = top.sites[i];
+        writer.Put("site.");
+        writer.PutUnsigned(site->id);
+        writer.Put(".live_bytes ");
+        writer.PutUnsigned(ctracker::detail::LoadRelaxed(site->live_bytes));
+        writer.Put("\nsite.");
+        writer.PutUnsigned(site->id);
+        writer.Put(".live_count ");
+        writer.PutUnsigned(ctracker::detail::LoadRelaxed(site->live_count));
+        writer.Put("\nsite.");
+        writer.PutUnsigned(site->id);
+        writer.Put(".frames");
+        for (uint32_t frame = 0; frame < site->depth && frame < ctracker::kMaxStackDepth; frame++)
+        {
+            writer.Put(" ");
+            writer.PutHex(reinterpret_cast<uintptr_t>(site->frames[frame]));
+        }
+        writer.Put("\n");
+    }
+
+    writer.Line("crash_dump_end", 1);
+    return writer.End();
+}
+
+#endif
@@ -0,0 +1,302 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+#include <pthread.h>
+#include <sched.h>
+
+// Classic three-epoch reclamation. A thread inside a guard publishes the global
+// epoch it entered in; the epoch only advances once every guarded thread has
+// seen the current one, so anything retired in epoch e is unreachable to all
+// readers by the time the global epoch reaches e + 2.
+
+namespace ctracker
+{
+namespace detail
+{
+
+namespace
+{
+
+const size_t kEpochSlots = 256;
+const size_t kBagSize = 61;
+const size_t kRetiresPerCollect = 64;
+
+// Blocks retired in `epoch`; a thread's bags are kept newest first
+struct RetireBag
+{
+    RetireBag *next;
+    uint64_t epoch;
+    size_t count;
+    void *items[kBagSize];
+};
+
+struct alignas(64) EpochSlot
+{
+    std::atomic<uint64_t> epoch; // epoch the owner is guarded in, 0 when outside
+    std::atomic<bool> claimed;
+};
+
+EpochSlot slots[kEpochSlots];
+std::atomic<uint64_t> global_epoch(1);
+// Guards of threads that found every slot taken; they block advancing entirely
+std::atomic<size_t> unslotted_guards(0);
+std::atomic<size_t> retired_blocks(0);
+
+// Bags of exited threads
+std::mutex orphan_mutex;
+RetireBag *orphans = nullptr;
+
+// Trivially destructible on purpose: a thread_local with a destructor is
+// registered through __cxa_thread_atexit on first use, which allocates, and the
+// first use is often under the tracker lock. Exit cleanup goes through a
+// pthread key instead, set once the thread owns a slot or retired blocks.
+struct ThreadEpoch
+{
+    EpochSlot *slot;
+    bool slot_tried;
+    bool registered;
+    unsigned depth;
+    size_t retires;
+    RetireBag *limbo;
+};
+
+thread_local ThreadEpoch thread_epoch = {};
+
+pthread_once_t exit_key_once = PTHREAD_ONCE_INIT;
+pthread_key_t exit_key;
+bool exit_key_ok = false;
+
+EpochSlot *ClaimSlot()
+{
+    for (EpochSlot &slot : slots)
+    {
+        bool expected = false;
+        if (!slot.claimed.load(std::memory_order_relaxed) &&
+            slot.claimed.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+void TryAdvance()
+{
+    if (unslotted_guards.load(std::memory_order_seq_cst))
+    {
+        return;
+    }
+    uint64_t epoch = global_epoch.load(std::memory_order_seq_cst);
+    for (EpochSlot &slot : slots)
+    {
+        uint64_t seen = slot.epoch.load(std::memory_order_seq_cst);
+        if (seen && seen != epoch)
+        {
+            return;
+        }
+    }
+    global_epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+}
+
+// Frees every bag old enough and returns what is left
+RetireBag *Collect(RetireBag *bags)
+{
+    uint64_t epoch = global_epoch.load(std::memory_order_acquire);
+    RetireBag **link = &bags;
+    while (*link)
+    {
+        RetireBag *bag = *link;
+        if (bag->epoch + 2 > epoch)
+        {
+            link = &bag->next;
+            continue;
+        }
+        *link = bag->next;
+        for (size_t i = 0; i < bag->count; i++)
+        {
+            RawFree(bag->items[i]);
+        }
+        retired_blocks.fetch_sub(bag->count, std::memory_order_relaxed);
+        RawFree(bag);
+    }
+    return bags;
+}
+
+// Hands the exiting thread's bags to the orphans and frees its slot
+void ReleaseThreadEpoch(void *)
+{
+    ThreadEpoch &self = thread_epoch;
+    self.registered = false;
+    if (self.limbo)
+    {
+        RetireBag *tail = self.limbo;
+        while (tail->next)
+        {
+            tail = tail->next;
+        }
+        std::lock_guard<std::mutex> lock(orphan_mutex);
+        tail->next = orphans;
+        orphans = self.limbo;
+        self.limbo = nullptr;
+    }
+    if (self.slot)
+    {
+        self.slot->epoch.store(0, std::memory_order_release);
+        self.slot->claimed.store(false, std::memory_order_release);
+        self.slot = nullptr;
+        self.slot_tried = false;
+    }
+}
+
+void CreateExitKey()
+{
+    exit_key_ok = pthread_key_create(&exit_key, ReleaseThreadEpoch) == 0;
+}
+
+// pthread_setspecific may allocate its second-level table; keep that out of
+// the tracker, whose lock the caller may hold
+void RegisterThreadEpoch(ThreadEpoch &self)
+{
+    if (self.registered)
+    {
+        return;
+    }
+    bool saved = lock_tracker;
+    lock_tracker = true;
+    pthread_once(&exit_key_once, CreateExitKey);
+    self.registered = exit_key_ok && pthread_setspecific(exit_key, &self) == 0;
+    lock_tracker = saved;
+}
+
+} // namespace
+
+EpochGuard::EpochGuard(bool active) : active_(false)
+{
+    if (active)
+    {
+        Enter();
+    }
+}
+
+EpochGuard::~EpochGuard()
+{
+    if (active_)
+    {
+        Leave();
+    }
+}
+
+void EpochGuard::Enter()
+{
+    active_ = true;
+    ThreadEpoch &self = thread_epoch;
+    if (self.depth++)
+    {
+        return;
+    }
+    if (!self.slot && !self.slot_tried)
+    {
+        self.slot = ClaimSlot();
+        self.slot_tried = true;
+        if (self.slot)
+        {
+            RegisterThreadEpoch(self);
+        }
+    }
+    if (!self.slot)
+    {
+        unslotted_guards.fetch_add(1, std::memory_order_seq_cst);
+        return;
+    }
+
+    // Publish, then make sure the epoch didn't move before others could see it
+    uint64_t epoch = global_epoch.load(std::memory_order_seq_cst);
+    for (;;)
+    {
+        self.slot->epoch.store(epoch, std::memory_order_seq_cst);
+        uint64_t now = global_epoch.load(std::memory_order_seq_cst);
+        if (now == epoch)
+        {
+            break;
+        }
+        epoch = now;
+    }
+}
+
+void EpochGuard::Leave()
+{
+    active_ = false;
+    ThreadEpoch &self = thread_epoch;
+    if (--self.depth)
+    {
+        return;
+    }
+    if (self.slot)
+    {
+        self.slot->epoch.store(0, std::memory_order_release);
+    }
+    else
+    {
+        unslotted_guards.fetch_sub(1, std::memory_order_seq_cst);
+    }
+}
+
+// A guard entered before this call publishes an epoch no later than the
+// current one, and holds the global epoch back until it leaves, so two
+// advances mean every such guard is gone
+void Synchronize()
+{
+    uint64_t target = global_epoch.load(std::memory_order_seq_cst) + 2;
+    for (;;)
+    {
+        TryAdvance();
+        if (global_epoch.load(std::memory_order_seq_cst) >= target)
+        {
+            return;
+        }
+        sched_yield();
+    }
+}
+
+void Retire(void *ptr)
+{
+    ThreadEpoch &self = thread_epoch;
+    uint64_t epoch = global_epoch.load(std::memory_order_seq_cst);
+    if (!self.limbo || self.limbo->epoch != epoch || self.limbo->count == kBagSize)
+    {
+        RetireBag *bag = static_cast<RetireBag *>(RawMalloc(sizeof(RetireBag)));
+        if (!bag)
+        {
+            return; // leaked rather than freed under a reader
+        }
+        bag->next = self.limbo;
+        bag->epoch = epoch;
+        bag->count = 0;
+        self.limbo = bag;
+        RegisterThreadEpoch(self);
+    }
+    self.limbo->items[self.limbo->count++] = ptr;
+    retired_blocks.fetch_add(1, std::memory_order_relaxed);
+
+    if (++self.retires % kRetiresPerCollect == 0)
+    {
+        TryAdvance();
+        self.limbo = Collect(self.limbo);
+        if (orphan_mutex.try_lock())
+        {
+            orphans = Collect(orphans);
+            orphan_mutex.unlock();
+        }
+    }
+}
+
+size_t RetiredBlocks()
+{
+    return retired_blocks.load(std::memory_order_relaxed);
+}
+
+} // namespace detail
+} // namespace ctracker
+
+#endif
@@ -0,0 +1,450 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <thread>
+#include <unistd.h>
+
+namespace
+{
+
+const char *RegistryName(ctracker::RegistryKind kind)
+{
+    switch (kind)
+    {
+    case ctracker::RegistryKind::List:
+        return "list";
+    case ctracker::RegistryKind::Tree:
+        return "tree";
+    case ctracker::RegistryKind::SkipList:
+        return "skiplist";
+    case ctracker::RegistryKind::PageMap:
+        return "pagemap";
+    }
+    return "unknown";
+}
+
+// Write to `<path>.tmp` and rename, so readers never see a half-written report
+void ExportReport()
+{
+    CTrackerMetrics *tracker = CTrackerMetrics::GetTracker();
+    ctracker::Config config = tracker->GetConfig();
+
+    char tmp_path[ctracker::kMaxPathLength + 8];
+    std::snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", config.output_path);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return;
+    }
+    bool ok = tracker->WriteReport(fd);
+    close(fd);
+    if (ok)
+    {
+        std::rename(tmp_path, config.output_path);
+    }
+}
+
+void ExportLoop(size_t interval_ms)
+{
+    for (;;)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+        ExportReport();
+    }
+}
+
+// Upper bound of the log2 bucket holding the given percentile, 0 if no samples
+uint64_t CyclePercentile(const ctracker::OverheadStats &stats, unsigned percentile)
+{
+    uint64_t target = (stats.hook_samples * percentile + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < ctracker::kCycleBuckets; i++)
+    {
+        seen += stats.hook_cycles[i];
+        if (seen && seen >= target)
+        {
+            return 2ull << i;
+        }
+    }
+    return 0;
+}
+
+bool WriteBuffer(int fd, const char *buffer, size_t size, int length)
+{
+    if (length < 0)
+    {
+        return false;
+    }
+
+    size_t total = static_cast<size_t>(length) < size ? static_cast<size_t>(length) : size - 1;
+    size_t written = 0;
+    while (written < total)
+    {
+        ssize_t n = write(fd, buffer + written, total - written);
+        if (n <= 0)
+        {
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+struct ReportWriter
+{
+    int fd;
+    bool ok;
+};
+
+// Spaces in type names would break the `name value` format
+void MetricName(const char *type_name, char *out)
+{
+    std::memcpy(out, type_name, ctracker::kMaxTypeName);
+    for (char *c = out; *c; c++)
+    {
+        if (*c == ' ')
+        {
+            *c = '_';
+        }
+    }
+}
+
+void WriteTypeStats(const ctracker::TypeStats &stats, void *context)
+{
+    ReportWriter *report = static_cast<ReportWriter *>(context);
+    char name[ctracker::kMaxTypeName];
+    MetricName(stats.name, name);
+
+    char buffer[4 * ctracker::kMaxTypeName + 128];
+    int length = std::snprintf(buffer, sizeof(buffer),
+                               "type.%s.live_count %zu\n"
+                               "type.%s.live_bytes %zu\n"
+                               "type.%s.allocations %llu\n"
+                               "type.%s.frees %llu\n",
+                               name, stats.live_count,
+                               name, stats.live_bytes,
+                               name, static_cast<unsigned long long>(stats.allocations),
+                               name, static_cast<unsigned long long>(stats.frees));
+    report->ok &= WriteBuffer(report->fd, buffer, sizeof(buffer), length);
+}
+
+void WriteFrameStats(const ctracker::FrameStats &stats, void *context)
+{
+    ReportWriter *report = static_cast<ReportWriter *>(context);
+    char name[ctracker::kMaxTypeName];
+    MetricName(stats.name, name);
+
+    char buffer[6 * ctracker::kMaxTypeName + 192];
+    int length = std::snprintf(buffer, sizeof(buffer),
+                               "coroutine.%s.live_count %zu\n"
+                               "coroutine.%s.live_bytes %zu\n"
+                               "coroutine.%s.frames %llu\n"
+                               "coroutine.%s.max_frame_size %zu\n"
+                               "coroutine.%s.mean_lifetime_ns %llu\n"
+                               "coroutine.%s.max_lifetime_ns %llu\n",
+                               name, stats.live_count,
+                               name, stats.live_bytes,
+                               name, static_cast<unsigned long long>(stats.frames),
+                               name, stats.max_frame_size,
+                               name, static_cast<unsigned long long>(stats.frames_freed ? stats.total_lifetime_ns / stats.frames_freed : 0),
+                               name, static_cast<unsigned long long>(stats.max_lifetime_ns));
+    report->ok &= WriteBuffer(report->fd, buffer, sizeof(buffer), length);
+}
+
+const size_t kReportedChurnPairs = 8;
+
+// `churn.<site id>.<size>.<metric> value`
+void WriteChurnCandidate(const ctracker::ChurnCandidate &candidate, ReportWriter *report)
+{
+    unsigned site = candidate.site->id;
+    char buffer[256];
+    int length = std::snprintf(buffer, sizeof(buffer),
+                               "churn.%u.%zu.frees_per_second %f\n"
+                               "churn.%u.%zu.bytes_per_second %f\n",
+                               site, candidate.size, candidate.frees_per_second,
+                               site, candidate.size, candidate.bytes_per_second);
+    report->ok &= WriteBuffer(report->fd, buffer, sizeof(buffer), length);
+}
+
+const size_t kReportedGrowthSites = 8;
+
+// `growth.<site id>.<metric> value`
+void WriteGrowthSite(const ctracker::GrowthSite &growth, ReportWriter *report)
+{
+    unsigned site = growth.site->id;
+    char buffer[256];
+    int length = std::snprintf(buffer, sizeof(buffer),
+                               "growth.%u.chains %llu\n"
+                               "growth.%u.steps %llu\n"
+                               "growth.%u.bytes_copied %llu\n",
+                               site, static_cast<unsigned long long>(growth.chains),
+                               site, static_cast<unsigned long long>(growth.steps),
+                               site, static_cast<unsigned long long>(growth.bytes_copied));
+    report->ok &= WriteBuffer(report->fd, buffer, sizeof(buffer), length);
+}
+
+const size_t kReportedSharingPairs = 8;
+
+// `false_sharing.<site id>.<site id>.<metric> value`
+void WriteSharingRisk(const ctracker::FalseSharingRisk &risk, ReportWriter *report)
+{
+    unsigned a = risk.sites[0]->id;
+    unsigned b = risk.sites[1]->id;
+    char buffer[192];
+    int length = std::snprintf(buffer, sizeof(buffer),
+                               "false_sharing.%u.%u.collisions %zu\n"
+                               "false_sharing.%u.%u.allocations_per_second %f\n",
+                               a, b, risk.collisions, a, b, risk.allocations_per_second);
+    report->ok &= WriteBuffer(report->fd, buffer, sizeof(buffer), length);
+}
+
+// The table only keeps contexts holding memory
+void WriteContextStats(const ctracker::ContextStats &stats, void *context)
+{
+    ReportWriter *report = static_cast<ReportWriter *>(context);
+    char buffer[256];
+    int length = std::snprintf(buffer, sizeof(buffer),
+                               "context.%llu.live_count %zu\n"
+                               "context.%llu.live_bytes %zu\n",
+                               static_cast<unsigned long long>(stats.id), stats.live_count,
+                               static_cast<unsigned long long>(stats.id), stats.live_bytes);
+    report->ok &= WriteBuffer(report->fd, buffer, sizeof(buffer), length);
+}
+
+// `lock.index.<metric> value` summed over shards, then
+// `lock.shard.<index>.<metric> value` for the shards that saw contention
+void WriteShardLocks(const CTrackerMetrics &tracker, ReportWriter *report)
+{
+    ctracker::LockStats shards[ctracker::detail::PointerIndex::kMaxShards];
+    size_t count = tracker.GetShardLockStats(shards, ctracker::detail::PointerIndex::kMaxShards);
+
+    ctracker::LockStats total = {};
+    for (size_t i = 0; i < count; i++)
+    {
+        total.acquisitions += shards[i].acquisitions;
+        total.contended += shards[i].contended;
+        total.wait_ns += shards[i].wait_ns;
+    }
+
+    char buffer[256];
+    int length = std::snprintf(buffer, sizeof(buffer),
+                               "lock.index.acquisitions %llu\n"
+                               "lock.index.contended %llu\n"
+                               "lock.index.wait_ns %llu\n",
+                               static_cast<unsigned long long>(total.acquisitions),
+                               static_cast<unsigned long long>(total.contended),
+                               static_cast<unsigned long long>(total.wait_ns));
+    report->ok &= WriteBuffer(report->fd, buffer, sizeof(buffer), length);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!shards[i].contended)
+        {
+            continue;
+        }
+        length = std::snprintf(buffer, sizeof(buffer),
+                               "lock.shard.%zu.contended %llu\n"
+                               "lock.shard.%zu.wait_ns %llu\n",
+                               i, static_cast<unsigned long long>(shards[i].contended),
+                               i, static_cast<unsigned long long>(shards[i].wait_ns));
+        report->ok &= WriteBuffer(report->fd, buffer, sizeof(buffer), length);
+    }
+}
+
+const char *const kAllocatorOpNames[ctracker::kAllocatorOps] = {"malloc", "free", "realloc"};
+
+// `allocator_latency.<op>.<metric> value`, over all size classes
+void WriteAllocatorLatency(const CTrackerMetrics &tracker, ctracker::AllocatorOp op, ReportWriter *report)
+{
+    ctracker::LatencyHistogram total = {};
+    for (size_t size_class = 0; size_class < ctracker::kSizeClasses; size_class++)
+    {
+        ctracker::LatencyHistogram histogram;
+        tracker.GetAllocatorLatency(op, size_class, &histogram);
+        for (size_t i = 0; i < ctracker::kLatencyBuckets; i++)
+        {
+            total.counts[i] += histogram.counts[i];
+        }
+        total.calls += histogram.calls;
+        total.outliers += histogram.outliers;
+        total.max_ns = total.max_ns > histogram.max_ns ? total.max_ns : histogram.max_ns;
+    }
+    if (!total.calls)
+    {
+        return;
+    }
+
+    const char *name = kAllocatorOpNames[static_cast<size_t>(op)];
+    char buffer[512];
+    int length = std::snprintf(buffer, sizeof(buffer),
+                               "allocator_latency.%s.calls %llu\n"
+                               "allocator_latency.%s.p50_ns %llu\n"
+                               "allocator_latency.%s.p99_ns %llu\n"
+                               "allocator_latency.%s.max_ns %llu\n"
+                               "allocator_latency.%s.outliers %llu\n",
+                               name, static_cast<unsigned long long>(total.calls),
+                               name, static_cast<unsigned long long>(ctracker::LatencyPercentile(total, 50)),
+                               name, static_cast<unsigned long long>(ctracker::LatencyPercentile(total, 99)),
+                               name, static_cast<unsigned long long>(total.max_ns),
+                               name, static_cast<unsigned long long>(total.outliers));
+    report->ok &= WriteBuffer(report->fd, buffer, sizeof(buffer), length);
+}
+
+} // namespace
+
+void ctracker::detail::StartExporter(const Config &config)
+{
+    if (!config.output_path[0])
+    {
+        return;
+    }
+
+    std::atexit(ExportReport);
+    if (config.export_interval_ms)
+    {
+        std::thread(ExportLoop, config.export_interval_ms).detach();
+    }
+}
+
+bool CTrackerMetrics::WriteReport(int fd)
+{
+    ctracker::Config config = GetConfig();
+    size_t records;
+    ctracker::ReallocStats reallocs = GetReallocStats();
+    ctracker::RegionStats regions = GetRegionStats();
+    // Young: under 10 epochs old, old: 60 epochs and up
+    ctracker::AgeDistribution ages = GetAgeDistribution(10 * config.age_epoch_ms, 60 * config.age_epoch_ms);
+    ctracker::AlignmentReport layout = GetAlignmentReport();
+    ctracker::OverheadStats overhead = GetOverheadStats();
+    ctracker::SamplingStats sampling = GetSamplingStats();
+    size_t line_straddles = 0;
+    size_t page_straddles = 0;
+    size_t padding_bytes = 0;
+    for (size_t i = 0; i < ctracker::kSizeClasses; i++)
+    {
+        line_straddles += layout.line_straddles[i];
+        page_straddles += layout.page_straddles[i];
+        padding_bytes += layout.padding_bytes[i];
+    }
+    {
+        std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+        SyncSession();
+        records = ctracker::detail::LoadRelaxed(RecordCount);
+    }
+
+    char buffer[2048];
+    int length = std::snprintf(buffer, sizeof(buffer),
+                               "enabled %d\n"
+                               "registry %s\n"
+                               "sample_interval %zu\n"
+                               "sampling_overhead_permille %zu\n"
+                               "estimated_live_count %zu\n"
+                               "estimated_live_bytes %zu\n"
+                               "allocations %llu\n"
+                               "frees %llu\n"
+                               "allocated_bytes %llu\n"
+                               "records %zu\n"
+                               "live_bytes %zu\n"
+                               "fragmentation_index %f\n"
+                               "largest_free_block %zu\n"
+                               "reallocs_in_place %llu\n"
+                               "reallocs_moved %llu\n"
+                               "realloc_bytes_copied %llu\n"
+                               "mapped_regions %zu\n"
+                               "mapped_bytes %zu\n"
+                               "partial_unmaps %llu\n"
+                               "chunk_maps %llu\n"
+                               "age_young_bytes %zu\n"
+                               "age_middle_bytes %zu\n"
+                               "age_old_bytes %zu\n"
+                               "line_straddles %zu\n"
+                               "page_straddles %zu\n"
+                               "padding_bytes %zu\n"
+                               "extra_alignment_bytes %zu\n"
+                               "overhead_metadata_bytes %zu\n"
+                               "overhead_hook_cycles_p50 %llu\n"
+                               "overhead_hook_cycles_p99 %llu\n"
+                               "overhead_lock_contended %llu\n"
+                               "overhead_lock_wait_ns %llu\n"
+                               "overhead_reentrant_skips %llu\n"
+                               "overhead_retired_blocks %zu\n",
+                               config.enabled ? 1 : 0,
+                               RegistryName(config.registry),
+                               config.sample_interval,
+                               sampling.overhead_permille,
+                               sampling.estimated_live_count,
+                               sampling.estimated_live_bytes,
+                               static_cast<unsigned long long>(AllocationCount()),
+                               static_cast<unsigned long long>(FreeCount()),
+                               static_cast<unsigned long long>(AllocatedBytes()),
+                               records,
+                               TotalAllocated(),
+                               FragmentationIndex(),
+                               FindLargestFreeBlock(),
+                               static_cast<unsigned long long>(reallocs.in_place),
+                               static_cast<unsigned long long>(reallocs.moved),
+                               static_cast<unsigned long long>(reallocs.bytes_copied),
+                               regions.regions,
+                               regions.mapped_bytes,
+                               static_cast<unsigned long long>(regions.partial_unmaps),
+                               static_cast<unsigned long long>(regions.chunk_maps),
+                               ages.young.live_bytes,
+                               ages.middle.live_bytes,
+                               ages.old.live_bytes,
+                               line_straddles,
+                               page_straddles,
+                               padding_bytes,
+                               layout.extra_alignment_bytes,
+                               overhead.metadata_bytes,
+                               static_cast<unsigned long long>(CyclePercentile(overhead, 50)),
+                               static_cast<unsigned long long>(CyclePercentile(overhead, 99)),
+                               static_cast<unsigned long long>(overhead.lock_contended),
+                               static_cast<unsigned long long>(overhead.lock_wait_ns),
+                               static_cast<unsigned long long>(overhead.reentrant_skips),
+                               overhead.retired_blocks);
+    if (!WriteBuffer(fd, buffer, sizeof(buffer), length))
+    {
+        return false;
+    }
+
+    ReportWriter report = {fd, true};
+    ctracker::ChurnCandidate churn[kReportedChurnPairs];
+    size_t churn_count = GetChurnCandidates(churn, kReportedChurnPairs);
+    for (size_t i = 0; i < churn_count; i++)
+    {
+        WriteChurnCandidate(churn[i], &report);
+    }
+
+    ctracker::GrowthSite growth[kReportedGrowthSites];
+    size_t growth_count = GetGrowthSites(growth, kReportedGrowthSites);
+    for (size_t i = 0; i < growth_count; i++)
+    {
+        WriteGrowthSite(growth[i], &report);
+    }
+
+    ctracker::FalseSharingRisk sharing[kReportedSharingPairs];
+    size_t sharing_count = GetFalseSharingRisks(sharing, kReportedSharingPairs);
+    for (size_t i = 0; i < sharing_count; i++)
+    {
+        WriteSharingRisk(sharing[i], &report);
+    }
+
+    WriteShardLocks(*this, &report);
+    WriteAllocatorLatency(*this, ctracker::AllocatorOp::Malloc, &report);
+    WriteAllocatorLatency(*this, ctracker::AllocatorOp::Free, &report);
+    WriteAllocatorLatency(*this, ctracker::AllocatorOp::Realloc, &report);
+
+    ctracker::ForEachTrackedType(WriteTypeStats, &report);
+    ctracker::ForEachCoroutineType(WriteFrameStats, &report);
+    ForEachContext(WriteContextStats, &report);
+    return report.ok;
+}
+
+#endif
@@ -0,0 +1,225 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+#include <cstdlib>
+
+namespace ctracker
+{
+namespace detail
+{
+
+namespace
+{
+
+const size_t kInitialBuckets = 64;
+
+inline size_t HashPointer(const void *ptr)
+{
+    // Fibonacci hashing; allocations are 16-byte aligned so the low bits carry nothing
+    return static_cast<size_t>((reinterpret_cast<uintptr_t>(ptr) >> 4) * 0x9E3779B97F4A7C15ull);
+}
+
+} // namespace
+
+PointerIndex::PointerIndex(size_t shards) : shard_mask_(shards - 1)
+{
+    for (size_t i = 0; i < kMaxShards; i++)
+    {
+        shards_[i].buckets = nullptr;
+        shards_[i].mask = 0;
+        shards_[i].count = 0;
+    }
+}
+
+PointerIndex::~PointerIndex()
+{
+    for (size_t i = 0; i <= shard_mask_; i++)
+    {
+        RawFree(shards_[i].buckets);
+    }
+}
+
+PointerIndex::Shard &PointerIndex::ShardFor(const void *ptr, size_t *hash)
+{
+    *hash = HashPointer(ptr);
+    return shards_[(*hash >> 56) & shard_mask_];
+}
+
+void PointerIndex::Grow(Shard &shard)
+{
+    size_t buckets = shard.buckets ? (shard.mask + 1) * 2 : kInitialBuckets;
+    AllocationRecord **table = static_cast<AllocationRecord **>(RawCalloc(buckets, sizeof(AllocationRecord *)));
+    if (!table)
+    {
+        return; // keep the old table, chains just get longer
+    }
+
+    for (size_t i = 0; shard.buckets && i <= shard.mask; i++)
+    {
+        AllocationRecord *current = shard.buckets[i];
+        while (current)
+        {
+            AllocationRecord *next = current->hnext;
+            size_t slot = (HashPointer(current->ptr) >> 8) & (buckets - 1);
+            current->hnext = table[slot];
+            table[slot] = current;
+            current = next;
+        }
+    }
+
+    RawFree(shard.buckets);
+    shard.buckets = table;
+    shard.mask = buckets - 1;
+}
+
+bool PointerIndex::Insert(AllocationRecord *record, AllocationRecord **displaced)
+{
+    size_t hash;
+    Shard &shard = ShardFor(record->ptr, &hash);
+    std::lock_guard<TimedMutex> lock(shard.mutex);
+    *displaced = nullptr;
+
+    if (!shard.buckets || shard.count > shard.mask)
+    {
+        Grow(shard);
+        if (!shard.buckets)
+        {
+            return false;
+        }
+    }
+
+    AllocationRecord **link = &shard.buckets[(hash >> 8) & shard.mask];
+    for (AllocationRecord **it = link; *it; it = &(*it)->hnext)
+    {
+        if ((*it)->ptr == record->ptr)
+        {
+            *displaced = *it;
+            *it = (*it)->hnext;
+            shard.count--;
+            break;
+        }
+    }
+
+    record->hnext = *link;
+    *link = record;
+    shard.count++;
+    return true;
+}
+
+AllocationRecord *PointerIndex::Remove(const void *ptr)
+{
+    size_t hash;
+    Shard &shard = ShardFor(ptr, &hash);
+    std::lock_guard<TimedMutex> lock(shard.mutex);
+    if (!shard.buckets)
+    {
+        return nullptr;
+    }
+
+    AllocationRecord **link = &shard.buckets[(hash >> 8) & shard.mask];
+    while (*link)
+    {
+        AllocationRecord *current = *link;
+        if (current->ptr == ptr)
+        {
+            *link = current->hnext;
+            shard.count--;
+            return current;
+        }
+        link = &current->hnext;
+    }
+    return nullptr;
+}
+
+AllocationRecord *PointerIndex::Resize(const void *ptr, size_t size, size_t *old_size)
+{
+    size_t hash;
+    Shard &shard = ShardFor(ptr, &hash);
+    std::lock_guard<TimedMutex> lock(shard.mutex);
+    if (!shard.buckets)
+    {
+        return nullptr;
+    }
+
+    for (AllocationRecord *current = shard.buckets[(hash >> 8) & shard.mask]; current; current = current->hnext)
+    {
+        if (current->ptr == ptr)
+        {
+            *old_size = current->size;
+            current->size = size;
+            return current;
+        }
+    }
+    return nullptr;
+}
+
+bool PointerIndex::Lookup(const void *ptr, size_t *size)
+{
+    size_t hash;
+    Shard &shard = ShardFor(ptr, &hash);
+    std::lock_guard<TimedMutex> lock(shard.mutex);
+    if (!shard.buckets)
+    {
+        return false;
+    }
+
+    for (AllocationRecord *current = shard.buckets[(hash >> 8) & shard.mask]; current; current = current->hnext)
+    {
+        if (current->ptr == ptr)
+        {
+            if (size)
+            {
+                *size = current->size;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void PointerIndex::Clear()
+{
+    for (size_t i = 0; i <= shard_mask_; i++)
+    {
+        std::lock_guard<TimedMutex> lock(shards_[i].mutex);
+        if (shards_[i].buckets)
+        {
+            for (size_t b = 0; b <= shards_[i].mask; b++)
+            {
+                shards_[i].buckets[b] = nullptr;
+            }
+        }
+        shards_[i].count = 0;
+    }
+}
+
+size_t PointerIndex::MetadataBytes()
+{
+    size_t bytes = sizeof(*this);
+    for (size_t i = 0; i <= shard_mask_; i++)
+    {
+        std::lock_guard<TimedMutex> lock(shards_[i].mutex);
+        if (shards_[i].buckets)
+        {
+            bytes += (shards_[i].mask + 1) * sizeof(AllocationRecord *);
+        }
+    }
+    return bytes;
+}
+
+size_t PointerIndex::Shards() const
+{
+    return shard_mask_ + 1;
+}
+
+LockStats PointerIndex::ShardLockStats(size_t shard)
+{
+    std::lock_guard<TimedMutex> lock(shards_[shard].mutex);
+    return shards_[shard].mutex.Stats();
+}
+
+} // namespace detail
+} // namespace ctracker
+
+#endif
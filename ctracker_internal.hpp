@@ -0,0 +1,746 @@
+#ifndef C_TRACKER_INTERNAL_HPP
+#define C_TRACKER_INTERNAL_HPP
+
+// Shared between the library's translation units; not installed.
+
+#include "ctracker.hpp"
+
+#if C_TRACKER
+
+#include <malloc.h>
+#include <mutex>
+#include <time.h>
+
+namespace ctracker
+{
+namespace detail
+{
+
+// The underlying allocator, bypassing `operator new` and the malloc hooks.
+// All of the tracker's own metadata comes from here.
+void *RawMalloc(size_t size);
+void *RawCalloc(size_t count, size_t size);
+void *RawRealloc(void *ptr, size_t size);
+void *RawAlignedAlloc(size_t alignment, size_t size);
+void RawFree(void *ptr);
+// Sets glibc_chunks if the blocks above come from glibc's own malloc
+void DetectGlibcChunks();
+// CTrackerMetrics::InstallCrashDump for a given tracker, so the constructor
+// can install it without going through GetTracker()
+bool InstallCrashDump(CTrackerMetrics *tracker, int fd, int signo);
+
+// Gives the calling thread its own alternate signal stack while the crash
+// handlers are installed; cheap after the first call on a thread
+void PrepareCrashStack();
+
+// Zeroed anonymous pages, for tables too big for the heap; nullptr on failure
+void *RawMap(size_t size);
+void RawUnmap(void *ptr, size_t size);
+
+// Nanoseconds on `clock`: CLOCK_MONOTONIC for durations, CLOCK_REALTIME for
+// timestamps, CLOCK_PROCESS_CPUTIME_ID for CPU time
+inline uint64_t ClockNs(clockid_t clock)
+{
+    timespec now;
+    clock_gettime(clock, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+}
+
+inline uint64_t MonotonicNs()
+{
+    return ClockNs(CLOCK_MONOTONIC);
+}
+
+// Allocator latency (CTrackerMetrics::SetAllocatorLatency). The Timed* wrappers
+// are what new/delete and the malloc hooks call; with timing off they cost one
+// relaxed load on top of Raw*.
+extern std::atomic<bool> latency_enabled;
+void RecordLatency(AllocatorOp op, size_t size, uint64_t start_ns);
+
+inline void *TimedRawMalloc(size_t size)
+{
+    if (!latency_enabled.load(std::memory_order_relaxed))
+    {
+        return RawMalloc(size);
+    }
+    uint64_t start = MonotonicNs();
+    void *ptr = RawMalloc(size);
+    RecordLatency(AllocatorOp::Malloc, size, start);
+    return ptr;
+}
+
+inline void *TimedRawCalloc(size_t count, size_t size)
+{
+    if (!latency_enabled.load(std::memory_order_relaxed))
+    {
+        return RawCalloc(count, size);
+    }
+    uint64_t start = MonotonicNs();
+    void *ptr = RawCalloc(count, size);
+    RecordLatency(AllocatorOp::Malloc, count * size, start);
+    return ptr;
+}
+
+inline void *TimedRawRealloc(void *ptr, size_t size)
+{
+    if (!latency_enabled.load(std::memory_order_relaxed))
+    {
+        return RawRealloc(ptr, size);
+    }
+    uint64_t start = MonotonicNs();
+    void *new_ptr = RawRealloc(ptr, size);
+    RecordLatency(AllocatorOp::Realloc, size, start);
+    return new_ptr;
+}
+
+inline void *TimedRawAlignedAlloc(size_t alignment, size_t size)
+{
+    if (!latency_enabled.load(std::memory_order_relaxed))
+    {
+        return RawAlignedAlloc(alignment, size);
+    }
+    uint64_t start = MonotonicNs();
+    void *ptr = RawAlignedAlloc(alignment, size);
+    RecordLatency(AllocatorOp::Malloc, size, start);
+    return ptr;
+}
+
+// The size class of a free comes from the block's usable size
+inline void TimedRawFree(void *ptr)
+{
+    if (!latency_enabled.load(std::memory_order_relaxed))
+    {
+        RawFree(ptr);
+        return;
+    }
+    size_t size = malloc_usable_size(ptr);
+    uint64_t start = MonotonicNs();
+    RawFree(ptr);
+    RecordLatency(AllocatorOp::Free, size, start);
+}
+
+// Adaptive sampling, see CTrackerMetrics::SetOverheadBudget. Called from the
+// sampled hook timings while a budget is set; cheap unless a period is due.
+extern std::atomic<size_t> overhead_budget_permille;
+void AdaptSampling();
+
+// Starts the periodic/at-exit report writer if Config::output_path is set
+void StartExporter(const Config &config);
+
+// Hash index from pointer to record. Each shard has its own lock, so lookups
+// only contend with writers that hash to the same shard. Records are owned by
+// the caller, which must remove a record from the index before freeing it.
+class PointerIndex
+{
+public:
+    static const size_t kMaxShards = 256;
+
+    explicit PointerIndex(size_t shards); // power of two, <= kMaxShards
+    ~PointerIndex();
+
+    // False if out of memory. A record already indexed under the same pointer
+    // (its free was never seen) is unhooked and returned through `displaced`.
+    bool Insert(AllocationRecord *record, AllocationRecord **displaced);
+    AllocationRecord *Remove(const void *ptr);
+
+    // Sets the record's size under the shard lock; nullptr if not indexed
+    AllocationRecord *Resize(const void *ptr, size_t size, size_t *old_size);
+
+    // Copies the size out under the shard lock
+    bool Lookup(const void *ptr, size_t *size);
+
+    // Drops every entry (records are not freed)
+    void Clear();
+
+    size_t MetadataBytes();
+
+    size_t Shards() const;
+    LockStats ShardLockStats(size_t shard);
+
+private:
+    struct alignas(64) Shard
+    {
+        TimedMutex mutex;
+        AllocationRecord **buckets;
+        size_t mask;
+        size_t count;
+    };
+
+    Shard &ShardFor(const void *ptr, size_t *hash);
+    static void Grow(Shard &shard);
+
+    Shard shards_[kMaxShards];
+    size_t shard_mask_;
+};
+
+// AVL tree over records keyed by address, intrusive through the records'
+// left/right/height fields. Not thread-safe: used under the tracker lock.
+class RecordTree
+{
+public:
+    RecordTree() : root_(nullptr) {}
+
+    // Returns the record ordered just before `record`, nullptr if it is first
+    AllocationRecord *Insert(AllocationRecord *record);
+    void Remove(AllocationRecord *record);
+
+    // Last record with ptr <= addr
+    AllocationRecord *Floor(uintptr_t addr) const;
+
+    void Clear()
+    {
+        root_ = nullptr;
+    }
+
+private:
+    AllocationRecord *root_;
+};
+
+// Epoch-based reclamation for memory lock-free readers may still hold
+// (RegistryKind::SkipList). Readers stay inside an EpochGuard while they use
+// such pointers; Retire() frees a block with RawFree once every thread that
+// could have seen it has left its guard. Guards nest and never block.
+// `active` = false makes an empty guard, for walks that may or may not be
+// over a skip list; Enter() and Leave() open and close it within its scope.
+class EpochGuard
+{
+public:
+    explicit EpochGuard(bool active = true);
+    ~EpochGuard();
+
+    EpochGuard(const EpochGuard &) = delete;
+    EpochGuard &operator=(const EpochGuard &) = delete;
+
+    void Enter();
+    void Leave();
+
+private:
+    bool active_;
+};
+
+// `ptr` must already be unreachable for readers entering a guard from now on
+void Retire(void *ptr);
+size_t RetiredBlocks();
+
+// Waits until every guard entered before the call has been left. Must not be
+// called from inside a guard.
+void Synchronize();
+
+// Counters updated outside the tracker lock (skip list writers) in structs the
+// public header keeps plain
+template <typename T, typename U>
+inline T AddRelaxed(T &counter, U delta)
+{
+    return __atomic_fetch_add(&counter, static_cast<T>(delta), __ATOMIC_RELAXED);
+}
+
+template <typename T, typename U>
+inline void SubRelaxed(T &counter, U delta)
+{
+    __atomic_fetch_sub(&counter, static_cast<T>(delta), __ATOMIC_RELAXED);
+}
+
+template <typename T>
+inline T LoadRelaxed(const T &counter)
+{
+    return __atomic_load_n(&counter, __ATOMIC_RELAXED);
+}
+
+// Lock-free skip list over records keyed by address, for RegistryKind::SkipList.
+// Inserts and removals run without the tracker lock; every call must be made
+// inside an EpochGuard, and removed nodes are retired rather than freed.
+class RecordSkipList
+{
+public:
+    static const uint32_t kMaxHeight = 16;
+
+    RecordSkipList();
+    ~RecordSkipList();
+
+    // Nodes are allocated up front so Insert can't fail
+    static SkipNode *NewNode(const void *ptr);
+    static void DropNode(SkipNode *node); // a node that was never inserted
+
+    // Sets record->node; the record must not be in the list
+    void Insert(SkipNode *node, AllocationRecord *record);
+    // True if this call unlinked it; false if another remover got there first
+    bool Remove(AllocationRecord *record);
+
+    // Last live record with ptr <= addr
+    AllocationRecord *Floor(uintptr_t addr);
+    AllocationRecord *First() const;
+    AllocationRecord *Next(const AllocationRecord *record) const;
+
+    // Removes every node, handing each record this call unlinked to `release`
+    void Purge(void (*release)(AllocationRecord *record));
+
+    size_t MetadataBytes() const;
+
+private:
+    bool TryFind(uintptr_t key, const AllocationRecord *record, SkipNode **preds, SkipNode **succs);
+    void Find(uintptr_t key, const AllocationRecord *record, SkipNode **preds, SkipNode **succs);
+    bool RemoveNode(SkipNode *node);
+    void Finish(SkipNode *node, uint32_t done);
+    static SkipNode *Live(SkipNode *node);
+
+    SkipNode *head_;
+    std::atomic<size_t> node_bytes_;
+};
+
+// Radix page map over the 48-bit user address space, for RegistryKind::PageMap.
+// Three levels of 4096 entries split the page number of the low 48 bits; a
+// leaf slot points to a small table for the page, created with its first
+// record and freed with its last. That table splits the page into 64-byte
+// slots, each holding the records starting in it as a sorted chain through
+// record->prev/next (one record per slot for blocks of 64 bytes or more), and
+// a bitmap of its populated slots. Every level keeps such a bitmap of its
+// children so ordered walks skip empty space with ctz/clz. Interior and leaf
+// tables are mapped on first use and kept. Addresses at or above 2^48 (5-level
+// paging, tagged pointers) don't fit the tree and go in a sorted overflow list
+// after it. Not thread-safe: used under the tracker lock.
+class RecordPageMap
+{
+public:
+    static const size_t kPageShift = 12;
+    static const size_t kLevelBits = 12;
+    static const size_t kFanout = size_t(1) << kLevelBits;
+    static const size_t kBitmapWords = kFanout / 64;
+    static const size_t kSlotShift = 6;
+    static const size_t kPageSlots = size_t(1) << (kPageShift - kSlotShift);
+    static const uintptr_t kAddressLimit = uintptr_t(1) << (kPageShift + 3 * kLevelBits);
+
+    RecordPageMap();
+    ~RecordPageMap();
+
+    // False if a table could not be mapped
+    bool Insert(AllocationRecord *record);
+    void Remove(AllocationRecord *record);
+
+    // Last record with ptr <= addr
+    AllocationRecord *Floor(uintptr_t addr) const;
+    AllocationRecord *First() const;
+    AllocationRecord *Next(const AllocationRecord *record) const;
+
+    // Hands every record to `release` and empties the map
+    void Clear(void (*release)(AllocationRecord *record));
+
+    size_t MetadataBytes() const
+    {
+        return sizeof(*this) + mapped_bytes_;
+    }
+
+private:
+    struct Page
+    {
+        uint64_t populated; // slots with at least one record
+        AllocationRecord *slots[kPageSlots];
+    };
+    struct Leaf
+    {
+        Page *pages[kFanout];
+        uint64_t populated[kBitmapWords];
+        size_t used;
+    };
+    struct Interior
+    {
+        Leaf *leaves[kFanout];
+        uint64_t populated[kBitmapWords];
+        size_t used;
+    };
+
+    Page *PageAt(uintptr_t page) const;
+    // First record of the first populated page at or after `page` (the
+    // overflow list after the last), and last record of the last one at or
+    // before it
+    AllocationRecord *FirstFrom(uintptr_t page) const;
+    AllocationRecord *LastUpTo(uintptr_t page) const;
+    void InsertHigh(AllocationRecord *record);
+    AllocationRecord *FloorHigh(uintptr_t addr) const;
+
+    Interior *interiors_[kFanout];
+    uint64_t populated_[kBitmapWords];
+    AllocationRecord *high_; // records at or above kAddressLimit, sorted
+    size_t mapped_bytes_;
+};
+
+// One bit per 16-byte granule of live allocations, in bitmaps over 1 MiB
+// aligned regions created when the first block lands in them and dropped when
+// the last one leaves (Config::occupancy_bitmap). Serves the heap summary
+// queries with word-level scans instead of a walk over the records. Exact
+// byte counts are kept per region; spans and gaps are at granule resolution.
+// Not thread-safe: used under the tracker lock.
+class OccupancyMap
+{
+public:
+    static const size_t kGranuleShift = 4;
+    static const size_t kRegionShift = 20;
+    static const size_t kRegionGranules = size_t(1) << (kRegionShift - kGranuleShift);
+    static const size_t kRegionWords = kRegionGranules / 64;
+
+    OccupancyMap();
+    ~OccupancyMap();
+
+    // Disabling drops every region; enabling starts empty, the caller adds the live blocks
+    void SetEnabled(bool enabled);
+    // Enabled and no region allocation has failed since the last Clear()
+    bool Usable() const
+    {
+        return enabled_ && !failed_;
+    }
+    bool Enabled() const
+    {
+        return enabled_;
+    }
+
+    void Add(const void *ptr, size_t size);
+    void Remove(const void *ptr, size_t size);
+    void Clear();
+
+    size_t LiveBytes() const;
+    // [first occupied granule, end of the last one); false if empty
+    bool Span(uintptr_t *start, uintptr_t *end) const;
+    // Widest run of free granules with occupied ones on both sides, in bytes
+    size_t LargestGap() const;
+
+    size_t MetadataBytes() const;
+
+private:
+    // Blocks need not be granule-aligned, so a granule a block only partly
+    // covers may be shared with a neighbour. Only those end granules are
+    // counted, in a small open-addressed table per region: a count of the
+    // blocks partly covering the granule, whose bit is cleared when the last
+    // goes. Zero-byte blocks count too, so the count is 32 bits wide.
+    struct Sharer
+    {
+        uint32_t granule;
+        uint32_t count; // 0 marks an empty slot
+    };
+
+    struct Region
+    {
+        uintptr_t base;
+        size_t live_bytes;
+        size_t blocks;
+        Sharer *sharers; // nullptr until the first unaligned block
+        size_t sharer_mask;
+        size_t sharer_count;
+        uint64_t bits[kRegionWords];
+    };
+
+    // Index of the first region with base >= `base`
+    size_t LowerBound(uintptr_t base) const;
+    Region *FindOrCreate(uintptr_t base);
+    void Update(const void *ptr, size_t size, bool add);
+    static bool UpdatePartial(Region *region, size_t granule, bool add);
+    static bool GrowSharers(Region *region);
+    static void FreeRegion(Region *region);
+    void DropRegion(size_t i);
+
+    Region **regions_; // sorted by base
+    size_t count_;
+    size_t capacity_;
+    bool enabled_;
+    bool failed_;
+};
+
+// Deduplicates call stacks into CallSite entries. Lookups of a known stack are
+// lock-free; new sites and growth take the table's own lock. Outgrown tables
+// are kept until the end, since a lookup may still be probing one.
+class CallSiteTable
+{
+public:
+    CallSiteTable();
+    ~CallSiteTable();
+
+    // nullptr if out of memory
+    CallSite *Intern(void *const *frames, size_t depth);
+
+    // Live counters restart with each tracking session
+    void ResetLiveStats();
+
+    // Lock-free, so also usable from a signal handler
+    void ForEach(void (*visitor)(CallSite *site, void *context), void *context) const;
+
+    size_t MetadataBytes() const;
+
+private:
+    struct Table
+    {
+        Table *older;
+        size_t mask;
+        std::atomic<CallSite *> slots[1]; // mask + 1 entries
+    };
+
+    static size_t TableBytes(size_t slots);
+    static CallSite *Lookup(const Table *table, void *const *frames, size_t depth);
+    bool Grow();
+
+    std::atomic<Table *> table_;
+    mutable std::mutex mutex_; // inserts and growth
+    size_t count_;
+    size_t table_bytes_;
+};
+
+// ContextStats per context ID in open-addressing tables, sharded by ID with a
+// lock per shard. Records carry the ID, not a pointer, so entries can move.
+class ContextTable
+{
+public:
+    static const size_t kShards = 16;
+
+    ContextTable();
+    ~ContextTable();
+
+    // A recorded allocation of `size` under `id`; false if out of memory
+    bool Add(ContextId id, size_t size);
+    // Drops the entry once nothing is live under `id`
+    void Remove(ContextId id, size_t size);
+    void Resize(ContextId id, size_t old_size, size_t new_size);
+
+    bool Find(ContextId id, ContextStats *out);
+
+    // The visitor runs under each shard's lock in turn
+    void ForEach(ContextVisitor visitor, void *context);
+
+    // Drops every entry; contexts restart with each tracking session
+    void Clear();
+
+    size_t MetadataBytes();
+
+private:
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        ContextStats *slots; // id 0 marks a free slot
+        size_t mask;
+        size_t count;
+    };
+
+    Shard &ShardFor(ContextId id, size_t *hash);
+    static ContextStats *Lookup(Shard &shard, ContextId id, size_t hash);
+    static bool Grow(Shard &shard);
+    static void Erase(Shard &shard, size_t slot);
+
+    Shard shards_[kShards];
+};
+
+// Live bytes per (age epoch, size class), so the age distribution never has to
+// scan records. A ring keeps the last kEpochs epochs; older ones are folded
+// into a single bucket. Sharded by the allocating thread's ID, which a record
+// keeps, with a lock per shard; each shard folds its ring when it is next used.
+class AgeTable
+{
+public:
+    static const size_t kEpochs = 256;
+    static const size_t kShards = 8;
+
+    explicit AgeTable(uint64_t epoch_ms);
+
+    // Current epoch
+    uint32_t Now() const;
+
+    void Add(uint32_t thread, uint32_t epoch, size_t size);
+    void Remove(uint32_t thread, uint32_t epoch, size_t size);
+    void Resize(uint32_t thread, uint32_t epoch, size_t old_size, size_t new_size);
+
+    void Read(uint64_t young_ms, uint64_t old_ms, AgeDistribution *out);
+
+    void Clear();
+
+private:
+    struct Bucket
+    {
+        size_t count[kSizeClasses];
+        size_t bytes[kSizeClasses];
+    };
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        Bucket epochs[kEpochs];
+        Bucket expired; // everything older than the ring
+        uint32_t current;
+    };
+
+    // Locks the thread's shard, with its ring moved on to the current epoch
+    Shard &Lock(uint32_t thread);
+    static void Advance(Shard &shard, uint32_t now);
+    static Bucket &BucketFor(Shard &shard, uint32_t epoch);
+
+    Shard shards_[kShards];
+    uint64_t epoch_ns_;
+    uint64_t start_ns_;
+};
+
+// Bounded heavy-hitter table of short-lived (site, size) pairs: each pair hashes
+// to a small set, and a new pair evicts the set's least frequent one while
+// inheriting its count (space-saving), so busy pairs can't be pushed out by
+// noise. The inherited part is kept as `error` and left out of the reported
+// counts and rates. Each set has its own lock.
+class ChurnTable
+{
+public:
+    static const size_t kSets = 64;
+    static const size_t kWays = 4;
+
+    ChurnTable() : sets_() {}
+
+    void Record(CallSite *site, size_t size, uint32_t epoch);
+
+    // Highest guaranteed rate first, over the epochs since a pair took its entry
+    size_t Top(ChurnCandidate *out, size_t max, uint32_t now, uint64_t epoch_ms);
+
+    void Clear();
+
+private:
+    struct Entry
+    {
+        CallSite *site;
+        size_t size;
+        uint64_t count;
+        uint64_t error; // count inherited on eviction
+        uint32_t first_epoch;
+    };
+    struct alignas(64) Set
+    {
+        std::mutex mutex;
+        Entry ways[kWays];
+    };
+
+    Set sets_[kSets];
+};
+
+// Ring of recently freed blocks, used to tell double frees from unknown
+// pointers. Only written while FreeCheck is on.
+struct QuarantineEntry
+{
+    void *ptr;
+    size_t size;
+    CallSite *alloc_site;
+    const void *free_caller;
+};
+
+class Quarantine
+{
+public:
+    static const size_t kSize = 256;
+
+    Quarantine() : next_(0), entries_() {}
+
+    void Push(const QuarantineEntry &entry)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_[next_ & (kSize - 1)] = entry;
+        next_++;
+    }
+
+    // Copies out the most recent entry for `ptr`
+    bool Find(const void *ptr, QuarantineEntry *out);
+
+    void Clear();
+
+private:
+    std::mutex mutex_;
+    size_t next_;
+    QuarantineEntry entries_[kSize];
+};
+
+// Blocks allocated while the reentrancy guard was set, which the registry never
+// saw; their frees are not reported as untracked. Lock-free, since blocks are
+// noted from inside the tracker with its locks held. Each address hashes to a
+// bucket of kWays slots; once a bucket is full any unknown pointer may be a
+// skipped block, and Overflowed() stays set until Clear().
+class SkippedBlocks
+{
+public:
+    static const size_t kBuckets = 512;
+    static const size_t kWays = 8;
+
+    void Note(const void *ptr);
+    // True if `ptr` was noted
+    bool Forget(const void *ptr);
+    bool Overflowed() const { return overflowed_.load(std::memory_order_relaxed); }
+    void Clear();
+
+private:
+    std::atomic<uintptr_t> *Bucket(const void *ptr);
+
+    std::atomic<uintptr_t> slots_[kBuckets * kWays];
+    std::atomic<bool> overflowed_;
+};
+
+// Static, so it can be noted into before the tracker exists
+extern SkippedBlocks skipped_blocks;
+
+struct Region
+{
+    uintptr_t start;
+    size_t length;
+    ctracker::CallSite *site;
+    uintptr_t chunk; // the malloc() block glibc mapped this for, 0 for mmap()
+};
+
+// Mapped regions as a sorted array of disjoint page ranges. Mappings are few
+// and long-lived, so lookups are binary searches and updates shift the array.
+class RegionMap
+{
+public:
+    RegionMap();
+    ~RegionMap();
+
+    // Maps [start, start + length), replacing whatever overlapped it (MAP_FIXED).
+    // False if out of memory.
+    bool Insert(uintptr_t start, size_t length, ctracker::CallSite *site, uintptr_t chunk = 0);
+
+    // Unmaps [start, start + length), trimming or splitting regions it covers
+    // only in part. Returns the bytes removed; `partial` counts such regions.
+    size_t Remove(uintptr_t start, size_t length, size_t *partial);
+
+    // Region containing `addr`, or nullptr
+    const Region *Find(uintptr_t addr) const;
+
+    size_t Count() const { return count_; }
+    size_t Bytes() const { return bytes_; }
+    size_t PageSize() const { return page_size_; }
+    size_t MetadataBytes() const { return sizeof(*this) + capacity_ * sizeof(Region); }
+
+    void Clear();
+
+private:
+    size_t LowerBound(uintptr_t addr) const; // first region ending after addr
+    bool Reserve(size_t count);
+
+    Region *regions_;
+    size_t count_;
+    size_t capacity_;
+    size_t bytes_;
+    size_t page_size_;
+};
+
+// See kSizeClasses
+inline size_t SizeClassOf(size_t size)
+{
+    size_t size_class = 0;
+    size_t limit = 16;
+    while (size > limit && size_class < kSizeClasses - 1)
+    {
+        limit <<= 2;
+        size_class++;
+    }
+    return size_class;
+}
+
+// Whether `new_size` looks like the next geometric growth step after `old_size`
+inline bool IsGrowthStep(size_t old_size, size_t new_size)
+{
+    return old_size && new_size * 10 >= old_size * 14 && new_size * 10 <= old_size * 21;
+}
+
+// Fills `frames` with up to `depth` return addresses, starting at `caller`.
+// depth <= 1 just records `caller`.
+size_t CaptureStack(void **frames, size_t depth, const void *caller);
+
+} // namespace detail
+} // namespace ctracker
+
+#endif
+#endif
@@ -0,0 +1,185 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+// Everything here runs inside new/delete (and malloc/free with the hooks), so
+// recording is lock-free apart from the rare outlier and never allocates.
+
+namespace ctracker
+{
+
+namespace
+{
+
+const size_t kSubBucketBits = 2; // log2(kLatencySubBuckets)
+
+struct AtomicHistogram
+{
+    std::atomic<uint64_t> counts[kLatencyBuckets];
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> total_ns;
+    std::atomic<uint64_t> max_ns;
+    std::atomic<uint64_t> outliers;
+};
+
+// Zero-initialized static storage, so usable before any constructor has run
+AtomicHistogram by_class[kAllocatorOps][kSizeClasses];
+AtomicHistogram by_thread[kAllocatorOps][kLatencyThreads];
+
+std::atomic<uint64_t> outlier_threshold_ns(1000000);
+
+std::mutex outlier_mutex;
+LatencyOutlier outlier_ring[kLatencyOutliers];
+uint64_t outliers_seen = 0;
+
+size_t BucketOf(uint64_t ns)
+{
+    if (ns < kLatencySubBuckets)
+    {
+        return static_cast<size_t>(ns);
+    }
+    size_t exponent = 63 - static_cast<size_t>(__builtin_clzll(ns));
+    size_t sub = static_cast<size_t>(ns >> (exponent - kSubBucketBits)) & (kLatencySubBuckets - 1);
+    size_t bucket = kLatencySubBuckets + (exponent - kSubBucketBits) * kLatencySubBuckets + sub;
+    return bucket < kLatencyBuckets ? bucket : kLatencyBuckets - 1;
+}
+
+void Add(AtomicHistogram *histogram, size_t bucket, uint64_t ns, bool outlier)
+{
+    histogram->counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    histogram->calls.fetch_add(1, std::memory_order_relaxed);
+    histogram->total_ns.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t max = histogram->max_ns.load(std::memory_order_relaxed);
+    while (ns > max && !histogram->max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+    {
+    }
+    if (outlier)
+    {
+        histogram->outliers.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Not a consistent snapshot: calls may be counted in some fields and not yet
+// in others
+void Read(const AtomicHistogram &histogram, LatencyHistogram *out)
+{
+    for (size_t i = 0; i < kLatencyBuckets; i++)
+    {
+        out->counts[i] = histogram.counts[i].load(std::memory_order_relaxed);
+    }
+    out->calls = histogram.calls.load(std::memory_order_relaxed);
+    out->total_ns = histogram.total_ns.load(std::memory_order_relaxed);
+    out->max_ns = histogram.max_ns.load(std::memory_order_relaxed);
+    out->outliers = histogram.outliers.load(std::memory_order_relaxed);
+}
+
+} // namespace
+
+namespace detail
+{
+
+std::atomic<bool> latency_enabled(false);
+
+void RecordLatency(AllocatorOp op, size_t size, uint64_t start_ns)
+{
+    uint64_t ns = MonotonicNs() - start_ns;
+    size_t index = static_cast<size_t>(op);
+    uint32_t thread = CurrentThreadId();
+    size_t slot = (thread < kLatencyThreads ? thread : kLatencyThreads) - 1;
+    bool outlier = ns >= outlier_threshold_ns.load(std::memory_order_relaxed);
+
+    size_t bucket = BucketOf(ns);
+    Add(&by_class[index][SizeClassOf(size)], bucket, ns, outlier);
+    Add(&by_thread[index][slot], bucket, ns, outlier);
+
+    if (outlier)
+    {
+        LatencyOutlier entry = {ClockNs(CLOCK_REALTIME) - ns, ns, size, thread, op};
+        std::lock_guard<std::mutex> lock(outlier_mutex);
+        outlier_ring[outliers_seen % kLatencyOutliers] = entry;
+        outliers_seen++;
+    }
+}
+
+} // namespace detail
+
+uint64_t LatencyBucketStart(size_t bucket)
+{
+    if (bucket < kLatencySubBuckets)
+    {
+        return bucket;
+    }
+    size_t exponent = (bucket - kLatencySubBuckets) / kLatencySubBuckets;
+    uint64_t sub = (bucket - kLatencySubBuckets) % kLatencySubBuckets;
+    return (kLatencySubBuckets + sub) << exponent;
+}
+
+uint64_t LatencyPercentile(const LatencyHistogram &histogram, unsigned percentile)
+{
+    uint64_t target = (histogram.calls * percentile + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kLatencyBuckets; i++)
+    {
+        seen += histogram.counts[i];
+        if (seen && seen >= target)
+        {
+            uint64_t limit = i + 1 < kLatencyBuckets ? LatencyBucketStart(i + 1) : histogram.max_ns;
+            return limit < histogram.max_ns ? limit : histogram.max_ns;
+        }
+    }
+    return 0;
+}
+
+} // namespace ctracker
+
+void CTrackerMetrics::SetAllocatorLatency(bool enabled, uint64_t outlier_ns)
+{
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    config_.allocator_latency = enabled;
+    config_.latency_outlier_ns = static_cast<size_t>(outlier_ns);
+    ctracker::outlier_threshold_ns.store(outlier_ns, std::memory_order_relaxed);
+    ctracker::detail::latency_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool CTrackerMetrics::AllocatorLatencyEnabled() const
+{
+    return ctracker::detail::latency_enabled.load(std::memory_order_relaxed);
+}
+
+bool CTrackerMetrics::GetAllocatorLatency(ctracker::AllocatorOp op, size_t size_class,
+                                          ctracker::LatencyHistogram *out) const
+{
+    if (size_class >= ctracker::kSizeClasses)
+    {
+        return false;
+    }
+    ctracker::Read(ctracker::by_class[static_cast<size_t>(op)][size_class], out);
+    return true;
+}
+
+bool CTrackerMetrics::GetThreadAllocatorLatency(ctracker::AllocatorOp op, uint32_t thread,
+                                                ctracker::LatencyHistogram *out) const
+{
+    if (thread == 0)
+    {
+        return false;
+    }
+    size_t slot = (thread < ctracker::kLatencyThreads ? thread : ctracker::kLatencyThreads) - 1;
+    ctracker::Read(ctracker::by_thread[static_cast<size_t>(op)][slot], out);
+    return true;
+}
+
+size_t CTrackerMetrics::GetLatencyOutliers(ctracker::LatencyOutlier *out, size_t max) const
+{
+    std::lock_guard<std::mutex> lock(ctracker::outlier_mutex);
+    uint64_t seen = ctracker::outliers_seen;
+    size_t count = 0;
+    while (count < max && count < seen && count < ctracker::kLatencyOutliers)
+    {
+        out[count] = ctracker::outlier_ring[(seen - 1 - count) % ctracker::kLatencyOutliers];
+        count++;
+    }
+    return count;
+}
+
+#endif
@@ -0,0 +1,261 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+#include <cerrno>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// The tracker's own allocations go through the Raw* functions so they never
+// re-enter the hooks below. With C_TRACKER_MALLOC_HOOKS the C allocator entry
+// points are replaced too, so Raw* must bypass them to reach glibc directly.
+
+#if C_TRACKER_MALLOC_HOOKS
+extern "C"
+{
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+}
+#endif
+
+namespace ctracker
+{
+namespace detail
+{
+
+#if C_TRACKER_MALLOC_HOOKS
+
+void *RawMalloc(size_t size)
+{
+    return __libc_malloc(size);
+}
+
+void *RawCalloc(size_t count, size_t size)
+{
+    return __libc_calloc(count, size);
+}
+
+void *RawRealloc(void *ptr, size_t size)
+{
+    return __libc_realloc(ptr, size);
+}
+
+void *RawAlignedAlloc(size_t alignment, size_t size)
+{
+    return __libc_memalign(alignment, size);
+}
+
+void RawFree(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+#else
+
+void *RawMalloc(size_t size)
+{
+    return std::malloc(size);
+}
+
+void *RawCalloc(size_t count, size_t size)
+{
+    return std::calloc(count, size);
+}
+
+void *RawRealloc(void *ptr, size_t size)
+{
+    return std::realloc(ptr, size);
+}
+
+void *RawAlignedAlloc(size_t alignment, size_t size)
+{
+    void *ptr = nullptr;
+    return posix_memalign(&ptr, alignment, size) == 0 ? ptr : nullptr;
+}
+
+void RawFree(void *ptr)
+{
+    std::free(ptr);
+}
+
+#endif
+
+std::atomic<bool> glibc_chunks(false);
+
+void DetectGlibcChunks()
+{
+#if C_TRACKER_MALLOC_HOOKS
+    glibc_chunks.store(true, std::memory_order_relaxed); // the hooks allocate through __libc_*
+#elif defined(__GLIBC__)
+    // glibc's malloc is an alias of __libc_malloc; anything interposed isn't.
+    // dlsym may allocate.
+    bool saved = lock_tracker;
+    lock_tracker = true;
+    void *malloc_symbol = dlsym(RTLD_DEFAULT, "malloc");
+    glibc_chunks.store(malloc_symbol && malloc_symbol == dlsym(RTLD_DEFAULT, "__libc_malloc"),
+                       std::memory_order_relaxed);
+    lock_tracker = saved;
+#endif
+}
+
+// Straight to the kernel, so the mmap hooks don't put our own tables in the region registry
+void *RawMap(size_t size)
+{
+    void *ptr = reinterpret_cast<void *>(
+        syscall(SYS_mmap, nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    return ptr == MAP_FAILED ? nullptr : ptr;
+}
+
+void RawUnmap(void *ptr, size_t size)
+{
+    syscall(SYS_munmap, ptr, size);
+}
+
+} // namespace detail
+} // namespace ctracker
+
+#if C_TRACKER_MALLOC_HOOKS
+
+extern "C"
+{
+
+void *malloc(size_t size)
+{
+    void *ptr = ctracker::detail::TimedRawMalloc(size);
+    if (ptr)
+    {
+        ctracker::detail::OnAllocation(ptr, size, __builtin_return_address(0));
+    }
+    return ptr;
+}
+
+void *calloc(size_t count, size_t size)
+{
+    void *ptr = ctracker::detail::TimedRawCalloc(count, size);
+    if (ptr)
+    {
+        ctracker::detail::OnAllocation(ptr, count * size, __builtin_return_address(0));
+    }
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (!ptr)
+    {
+        return malloc(size);
+    }
+    if (size == 0)
+    {
+        if (ctracker::detail::OnFree(ptr, __builtin_return_address(0)))
+        {
+            ctracker::detail::TimedRawFree(ptr);
+        }
+        return nullptr;
+    }
+
+    // Read before the call: a mapped chunk may be unmapped by it
+    uintptr_t map_start;
+    size_t map_length;
+    bool old_mapped = ctracker::detail::MappedChunk(ptr, &map_start, &map_length);
+    void *new_ptr = ctracker::detail::TimedRawRealloc(ptr, size);
+    if (!new_ptr)
+    {
+        return nullptr; // the old block is still live and its record stays valid
+    }
+    if (old_mapped || ctracker::detail::MappedChunk(new_ptr, &map_start, &map_length))
+    {
+        ctracker::detail::OnChunkReallocation(ptr, old_mapped, new_ptr, size, __builtin_return_address(0));
+    }
+    else
+    {
+        ctracker::detail::OnReallocation(ptr, new_ptr, size, __builtin_return_address(0));
+    }
+    return new_ptr;
+}
+
+// The aligned entry points return blocks that end up in free() like any
+// other, so they are tracked too
+
+int posix_memalign(void **out, size_t alignment, size_t size)
+{
+    if (alignment == 0 || alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0)
+    {
+        return EINVAL;
+    }
+    void *ptr = ctracker::detail::TimedRawAlignedAlloc(alignment, size);
+    if (!ptr)
+    {
+        return ENOMEM;
+    }
+    ctracker::detail::OnAllocation(ptr, size, __builtin_return_address(0), alignment);
+    *out = ptr;
+    return 0;
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    void *ptr = ctracker::detail::TimedRawAlignedAlloc(alignment, size);
+    if (ptr)
+    {
+        ctracker::detail::OnAllocation(ptr, size, __builtin_return_address(0), alignment);
+    }
+    return ptr;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    void *ptr = ctracker::detail::TimedRawAlignedAlloc(alignment, size);
+    if (ptr)
+    {
+        ctracker::detail::OnAllocation(ptr, size, __builtin_return_address(0), alignment);
+    }
+    return ptr;
+}
+
+void *valloc(size_t size)
+{
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    void *ptr = ctracker::detail::TimedRawAlignedAlloc(page, size);
+    if (ptr)
+    {
+        ctracker::detail::OnAllocation(ptr, size, __builtin_return_address(0), page);
+    }
+    return ptr;
+}
+
+void *pvalloc(size_t size)
+{
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size = size ? (size + page - 1) & ~(page - 1) : page;
+    void *ptr = ctracker::detail::TimedRawAlignedAlloc(page, size);
+    if (ptr)
+    {
+        ctracker::detail::OnAllocation(ptr, size, __builtin_return_address(0), page);
+    }
+    return ptr;
+}
+
+void free(void *ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+    if (ctracker::detail::OnFree(ptr, __builtin_return_address(0)))
+    {
+        ctracker::detail::TimedRawFree(ptr);
+    }
+}
+
+} // extern "C"
+
+#endif
+
+#endif
@@ -0,0 +1,406 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+#include <cstring>
+
+namespace ctracker
+{
+namespace detail
+{
+
+namespace
+{
+
+const uintptr_t kRegionSize = uintptr_t(1) << OccupancyMap::kRegionShift;
+const uintptr_t kGranuleSize = uintptr_t(1) << OccupancyMap::kGranuleShift;
+
+// Sets or clears bits [from, to) of a region bitmap, a word at a time
+void FillBits(uint64_t *bits, size_t from, size_t to, bool set)
+{
+    while (from < to)
+    {
+        size_t word = from / 64;
+        size_t offset = from % 64;
+        size_t count = to - from < 64 - offset ? to - from : 64 - offset;
+        uint64_t mask = (count == 64 ? ~uint64_t(0) : ((uint64_t(1) << count) - 1)) << offset;
+        if (set)
+        {
+            bits[word] |= mask;
+        }
+        else
+        {
+            bits[word] &= ~mask;
+        }
+        from += count;
+    }
+}
+
+// First bit at or after `from` equal to `set`, kRegionGranules if none
+size_t NextBit(const uint64_t *bits, size_t from, bool set)
+{
+    if (from >= OccupancyMap::kRegionGranules)
+    {
+        return OccupancyMap::kRegionGranules;
+    }
+    size_t word = from / 64;
+    uint64_t current = (set ? bits[word] : ~bits[word]) & (~uint64_t(0) << (from % 64));
+    for (;;)
+    {
+        if (current)
+        {
+            return word * 64 + static_cast<size_t>(__builtin_ctzll(current));
+        }
+        if (++word == OccupancyMap::kRegionWords)
+        {
+            return OccupancyMap::kRegionGranules;
+        }
+        current = set ? bits[word] : ~bits[word];
+    }
+}
+
+size_t SharerSlot(uint32_t granule, size_t mask)
+{
+    return static_cast<size_t>((granule * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+// Last set bit, kRegionGranules if none
+size_t LastSet(const uint64_t *bits)
+{
+    for (size_t word = OccupancyMap::kRegionWords; word-- > 0;)
+    {
+        if (bits[word])
+        {
+            return word * 64 + 63 - static_cast<size_t>(__builtin_clzll(bits[word]));
+        }
+    }
+    return OccupancyMap::kRegionGranules;
+}
+
+} // namespace
+
+OccupancyMap::OccupancyMap() : regions_(nullptr), count_(0), capacity_(0), enabled_(false), failed_(false)
+{
+}
+
+OccupancyMap::~OccupancyMap()
+{
+    Clear();
+    RawFree(regions_);
+}
+
+void OccupancyMap::SetEnabled(bool enabled)
+{
+    Clear();
+    enabled_ = enabled;
+}
+
+void OccupancyMap::Clear()
+{
+    for (size_t i = 0; i < count_; i++)
+    {
+        FreeRegion(regions_[i]);
+    }
+    count_ = 0;
+    failed_ = false;
+}
+
+size_t OccupancyMap::LowerBound(uintptr_t base) const
+{
+    size_t lo = 0;
+    size_t hi = count_;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (regions_[mid]->base < base)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+OccupancyMap::Region *OccupancyMap::FindOrCreate(uintptr_t base)
+{
+    size_t i = LowerBound(base);
+    if (i < count_ && regions_[i]->base == base)
+    {
+        return regions_[i];
+    }
+
+    if (count_ == capacity_)
+    {
+        size_t capacity = capacity_ ? capacity_ * 2 : 16;
+        Region **regions = static_cast<Region **>(RawRealloc(regions_, capacity * sizeof(Region *)));
+        if (!regions)
+        {
+            return nullptr;
+        }
+        regions_ = regions;
+        capacity_ = capacity;
+    }
+    Region *region = static_cast<Region *>(RawCalloc(1, sizeof(Region)));
+    if (!region)
+    {
+        return nullptr;
+    }
+    region->base = base;
+    std::memmove(regions_ + i + 1, regions_ + i, (count_ - i) * sizeof(Region *));
+    regions_[i] = region;
+    count_++;
+    return region;
+}
+
+void OccupancyMap::FreeRegion(Region *region)
+{
+    RawFree(region->sharers);
+    RawFree(region);
+}
+
+void OccupancyMap::DropRegion(size_t i)
+{
+    FreeRegion(regions_[i]);
+    std::memmove(regions_ + i, regions_ + i + 1, (count_ - i - 1) * sizeof(Region *));
+    count_--;
+}
+
+// A zero-byte block still occupies its first granule
+void OccupancyMap::Update(const void *ptr, size_t size, bool add)
+{
+    if (!enabled_ || failed_)
+    {
+        return;
+    }
+
+    uintptr_t start = reinterpret_cast<uintptr_t>(ptr);
+    uintptr_t end = start + (size ? size : 1);
+    for (uintptr_t base = start & ~(kRegionSize - 1); base < end; base += kRegionSize)
+    {
+        uintptr_t lo = start > base ? start : base;
+        uintptr_t hi = end < base + kRegionSize ? end : base + kRegionSize;
+        size_t first = (lo - base) >> kGranuleShift;
+        size_t last = (hi - base + kGranuleSize - 1) >> kGranuleShift;
+        // Granules the block covers entirely are its own; the ones at either
+        // end may be shared
+        size_t full_first = (lo - base + kGranuleSize - 1) >> kGranuleShift;
+        size_t full_last = (hi - base) >> kGranuleShift;
+        size_t head_end = full_first < last ? full_first : last;
+        size_t tail_start = full_last > head_end ? full_last : head_end;
+
+        if (add)
+        {
+            Region *region = FindOrCreate(base);
+            if (!region)
+            {
+                failed_ = true; // queries fall back to the records until the next Clear()
+                return;
+            }
+            bool counted = true;
+            for (size_t granule = first; granule < head_end; granule++)
+            {
+                counted = counted && UpdatePartial(region, granule, true);
+            }
+            if (full_first < full_last)
+            {
+                FillBits(region->bits, full_first, full_last, true);
+            }
+            for (size_t granule = tail_start; granule < last; granule++)
+            {
+                counted = counted && UpdatePartial(region, granule, true);
+            }
+            if (!counted)
+            {
+                failed_ = true;
+                return;
+            }
+            region->live_bytes += size ? hi - lo : 0;
+            region->blocks++;
+            continue;
+        }
+
+        size_t i = LowerBound(base);
+        if (i == count_ || regions_[i]->base != base)
+        {
+            continue;
+        }
+        Region *region = regions_[i];
+        for (size_t granule = first; granule < head_end; granule++)
+        {
+            UpdatePartial(region, granule, false);
+        }
+        if (full_first < full_last)
+        {
+            FillBits(region->bits, full_first, full_last, false);
+        }
+        for (size_t granule = tail_start; granule < last; granule++)
+        {
+            UpdatePartial(region, granule, false);
+        }
+        region->live_bytes -= size ? hi - lo : 0;
+        if (--region->blocks == 0)
+        {
+            DropRegion(i);
+        }
+    }
+}
+
+// False if the sharer table couldn't grow
+bool OccupancyMap::UpdatePartial(Region *region, size_t granule, bool add)
+{
+    if (add && (region->sharer_count + 1) * 4 > (region->sharers ? region->sharer_mask + 1 : 0) * 3 &&
+        !GrowSharers(region))
+    {
+        return false;
+    }
+    if (!region->sharers)
+    {
+        return true; // removing from a region with no shared granules
+    }
+
+    uint32_t key = static_cast<uint32_t>(granule);
+    size_t slot = SharerSlot(key, region->sharer_mask);
+    while (region->sharers[slot].count && region->sharers[slot].granule != key)
+    {
+        slot = (slot + 1) & region->sharer_mask;
+    }
+    Sharer *sharer = &region->sharers[slot];
+    if (add)
+    {
+        if (!sharer->count)
+        {
+            sharer->granule = key;
+            region->sharer_count++;
+        }
+        sharer->count++;
+        FillBits(region->bits, granule, granule + 1, true);
+        return true;
+    }
+    if (!sharer->count || --sharer->count)
+    {
+        return true;
+    }
+
+    FillBits(region->bits, granule, granule + 1, false);
+    region->sharer_count--;
+    // Backward-shift delete: pull later entries of the probe run into the hole
+    size_t hole = slot;
+    for (size_t next = (hole + 1) & region->sharer_mask; region->sharers[next].count;
+         next = (next + 1) & region->sharer_mask)
+    {
+        size_t home = SharerSlot(region->sharers[next].granule, region->sharer_mask);
+        if (((next - home) & region->sharer_mask) >= ((next - hole) & region->sharer_mask))
+        {
+            region->sharers[hole] = region->sharers[next];
+            hole = next;
+        }
+    }
+    region->sharers[hole].count = 0;
+    return true;
+}
+
+bool OccupancyMap::GrowSharers(Region *region)
+{
+    size_t capacity = region->sharers ? (region->sharer_mask + 1) * 2 : 16;
+    Sharer *sharers = static_cast<Sharer *>(RawCalloc(capacity, sizeof(Sharer)));
+    if (!sharers)
+    {
+        return false;
+    }
+    if (region->sharers)
+    {
+        for (size_t i = 0; i <= region->sharer_mask; i++)
+        {
+            if (region->sharers[i].count)
+            {
+                size_t slot = SharerSlot(region->sharers[i].granule, capacity - 1);
+                while (sharers[slot].count)
+                {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                sharers[slot] = region->sharers[i];
+            }
+        }
+        RawFree(region->sharers);
+    }
+    region->sharers = sharers;
+    region->sharer_mask = capacity - 1;
+    return true;
+}
+
+void OccupancyMap::Add(const void *ptr, size_t size)
+{
+    Update(ptr, size, true);
+}
+
+void OccupancyMap::Remove(const void *ptr, size_t size)
+{
+    Update(ptr, size, false);
+}
+
+size_t OccupancyMap::LiveBytes() const
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < count_; i++)
+    {
+        bytes += regions_[i]->live_bytes;
+    }
+    return bytes;
+}
+
+bool OccupancyMap::Span(uintptr_t *start, uintptr_t *end) const
+{
+    // Regions are dropped once empty, so the first and last always have bits set
+    if (!count_)
+    {
+        return false;
+    }
+    const Region *first = regions_[0];
+    const Region *last = regions_[count_ - 1];
+    *start = first->base + (NextBit(first->bits, 0, true) << kGranuleShift);
+    *end = last->base + ((LastSet(last->bits) + 1) << kGranuleShift);
+    return true;
+}
+
+size_t OccupancyMap::LargestGap() const
+{
+    size_t largest = 0;
+    uintptr_t previous_end = 0; // address just past the last occupied run
+    for (size_t i = 0; i < count_; i++)
+    {
+        const Region *region = regions_[i];
+        size_t granule = 0;
+        while ((granule = NextBit(region->bits, granule, true)) < kRegionGranules)
+        {
+            uintptr_t run_start = region->base + (granule << kGranuleShift);
+            if (previous_end && run_start - previous_end > largest)
+            {
+                largest = run_start - previous_end;
+            }
+            granule = NextBit(region->bits, granule, false);
+            previous_end = region->base + (granule << kGranuleShift);
+        }
+    }
+    return largest;
+}
+
+size_t OccupancyMap::MetadataBytes() const
+{
+    size_t bytes = sizeof(*this) + capacity_ * sizeof(Region *) + count_ * sizeof(Region);
+    for (size_t i = 0; i < count_; i++)
+    {
+        if (regions_[i]->sharers)
+        {
+            bytes += (regions_[i]->sharer_mask + 1) * sizeof(Sharer);
+        }
+    }
+    return bytes;
+}
+
+} // namespace detail
+} // namespace ctracker
+
+#endif
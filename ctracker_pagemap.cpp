@@ -0,0 +1,447 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+#include <cstring>
+
+namespace ctracker
+{
+namespace detail
+{
+
+namespace
+{
+
+const size_t kPageBits = 3 * RecordPageMap::kLevelBits;
+const uintptr_t kPageMask = (uintptr_t(1) << kPageBits) - 1;
+const size_t kLevelMask = RecordPageMap::kFanout - 1;
+
+// Only for addresses below kAddressLimit
+uintptr_t PageOf(uintptr_t addr)
+{
+    return addr >> RecordPageMap::kPageShift;
+}
+
+size_t SlotOf(uintptr_t addr)
+{
+    return (addr >> RecordPageMap::kSlotShift) & (RecordPageMap::kPageSlots - 1);
+}
+
+uintptr_t AddressOf(const AllocationRecord *record)
+{
+    return reinterpret_cast<uintptr_t>(record->ptr);
+}
+
+AllocationRecord *ChainEnd(AllocationRecord *record)
+{
+    while (record->next)
+    {
+        record = record->next;
+    }
+    return record;
+}
+
+// Links `record` into the sorted chain at `head`, or in front of it
+void LinkSorted(AllocationRecord *&head, AllocationRecord *record)
+{
+    if (!head || AddressOf(head) > AddressOf(record))
+    {
+        if (head)
+        {
+            head->prev = record;
+        }
+        record->prev = nullptr;
+        record->next = head;
+        head = record;
+        return;
+    }
+    AllocationRecord *prev = head;
+    while (prev->next && AddressOf(prev->next) < AddressOf(record))
+    {
+        prev = prev->next;
+    }
+    record->prev = prev;
+    record->next = prev->next;
+    if (record->next)
+    {
+        record->next->prev = record;
+    }
+    prev->next = record;
+}
+
+size_t RootIndex(uintptr_t page)
+{
+    return page >> (2 * RecordPageMap::kLevelBits);
+}
+
+size_t InteriorIndex(uintptr_t page)
+{
+    return (page >> RecordPageMap::kLevelBits) & kLevelMask;
+}
+
+size_t LeafIndex(uintptr_t page)
+{
+    return page & kLevelMask;
+}
+
+void SetBit(uint64_t *bits, size_t i)
+{
+    bits[i / 64] |= uint64_t(1) << (i % 64);
+}
+
+void ClearBit(uint64_t *bits, size_t i)
+{
+    bits[i / 64] &= ~(uint64_t(1) << (i % 64));
+}
+
+// First set bit at or after `from`, kFanout if none
+size_t NextSet(const uint64_t *bits, size_t from)
+{
+    if (from >= RecordPageMap::kFanout)
+    {
+        return RecordPageMap::kFanout;
+    }
+    size_t word = from / 64;
+    uint64_t current = bits[word] & (~uint64_t(0) << (from % 64));
+    for (;;)
+    {
+        if (current)
+        {
+            return word * 64 + static_cast<size_t>(__builtin_ctzll(current));
+        }
+        if (++word == RecordPageMap::kBitmapWords)
+        {
+            return RecordPageMap::kFanout;
+        }
+        current = bits[word];
+    }
+}
+
+// Last set bit at or before `upto`, kFanout if none
+size_t PrevSet(const uint64_t *bits, size_t upto)
+{
+    size_t word = upto / 64;
+    uint64_t current = bits[word] & (~uint64_t(0) >> (63 - upto % 64));
+    for (;;)
+    {
+        if (current)
+        {
+            return word * 64 + 63 - static_cast<size_t>(__builtin_clzll(current));
+        }
+        if (word-- == 0)
+        {
+            return RecordPageMap::kFanout;
+        }
+        current = bits[word];
+    }
+}
+
+template <typename T>
+T *MapTable(size_t *mapped_bytes)
+{
+    T *table = static_cast<T *>(RawMap(sizeof(T)));
+    if (table)
+    {
+        *mapped_bytes += sizeof(T);
+    }
+    return table;
+}
+
+} // namespace
+
+RecordPageMap::RecordPageMap() : interiors_(), populated_(), high_(nullptr), mapped_bytes_(0)
+{
+}
+
+RecordPageMap::~RecordPageMap()
+{
+    for (Interior *interior : interiors_)
+    {
+        if (!interior)
+        {
+            continue;
+        }
+        for (Leaf *leaf : interior->leaves)
+        {
+            if (!leaf)
+            {
+                continue;
+            }
+            for (Page *page : leaf->pages)
+            {
+                RawFree(page);
+            }
+            RawUnmap(leaf, sizeof(Leaf));
+        }
+        RawUnmap(interior, sizeof(Interior));
+    }
+}
+
+RecordPageMap::Page *RecordPageMap::PageAt(uintptr_t page) const
+{
+    const Interior *interior = interiors_[RootIndex(page)];
+    const Leaf *leaf = interior ? interior->leaves[InteriorIndex(page)] : nullptr;
+    return leaf ? leaf->pages[LeafIndex(page)] : nullptr;
+}
+
+bool RecordPageMap::Insert(AllocationRecord *record)
+{
+    uintptr_t addr = AddressOf(record);
+    if (addr >= kAddressLimit)
+    {
+        InsertHigh(record);
+        return true;
+    }
+
+    uintptr_t page = PageOf(addr);
+    Interior *&interior = interiors_[RootIndex(page)];
+    if (!interior && !(interior = MapTable<Interior>(&mapped_bytes_)))
+    {
+        return false;
+    }
+    Leaf *&leaf = interior->leaves[InteriorIndex(page)];
+    if (!leaf && !(leaf = MapTable<Leaf>(&mapped_bytes_)))
+    {
+        return false;
+    }
+    Page *&table = leaf->pages[LeafIndex(page)];
+    if (!table)
+    {
+        if (!(table = static_cast<Page *>(RawCalloc(1, sizeof(Page)))))
+        {
+            return false;
+        }
+        mapped_bytes_ += sizeof(Page);
+        SetBit(leaf->populated, LeafIndex(page));
+        if (leaf->used++ == 0)
+        {
+            SetBit(interior->populated, InteriorIndex(page));
+            if (interior->used++ == 0)
+            {
+                SetBit(populated_, RootIndex(page));
+            }
+        }
+    }
+
+    size_t slot = SlotOf(addr);
+    table->populated |= uint64_t(1) << slot;
+    LinkSorted(table->slots[slot], record);
+    return true;
+}
+
+void RecordPageMap::InsertHigh(AllocationRecord *record)
+{
+    LinkSorted(high_, record);
+}
+
+void RecordPageMap::Remove(AllocationRecord *record)
+{
+    if (record->next)
+    {
+        record->next->prev = record->prev;
+    }
+    if (record->prev)
+    {
+        record->prev->next = record->next;
+        return;
+    }
+
+    uintptr_t addr = AddressOf(record);
+    if (addr >= kAddressLimit)
+    {
+        high_ = record->next;
+        return;
+    }
+
+    uintptr_t page = PageOf(addr);
+    Interior *interior = interiors_[RootIndex(page)];
+    Leaf *leaf = interior->leaves[InteriorIndex(page)];
+    Page *&table = leaf->pages[LeafIndex(page)];
+    size_t slot = SlotOf(addr);
+    table->slots[slot] = record->next;
+    if (record->next)
+    {
+        return;
+    }
+    table->populated &= ~(uint64_t(1) << slot);
+    if (table->populated)
+    {
+        return;
+    }
+
+    RawFree(table);
+    table = nullptr;
+    mapped_bytes_ -= sizeof(Page);
+    ClearBit(leaf->populated, LeafIndex(page));
+    if (--leaf->used == 0)
+    {
+        ClearBit(interior->populated, InteriorIndex(page));
+        if (--interior->used == 0)
+        {
+            ClearBit(populated_, RootIndex(page));
+        }
+    }
+}
+
+AllocationRecord *RecordPageMap::FirstFrom(uintptr_t page) const
+{
+    if (page > kPageMask)
+    {
+        return high_;
+    }
+
+    size_t root = RootIndex(page);
+    for (size_t a = NextSet(populated_, root); a < kFanout; a = NextSet(populated_, a + 1))
+    {
+        const Interior *interior = interiors_[a];
+        size_t b_from = a == root ? InteriorIndex(page) : 0;
+        for (size_t b = NextSet(interior->populated, b_from); b < kFanout; b = NextSet(interior->populated, b + 1))
+        {
+            const Leaf *leaf = interior->leaves[b];
+            size_t c = NextSet(leaf->populated, a == root && b == InteriorIndex(page) ? LeafIndex(page) : 0);
+            if (c < kFanout)
+            {
+                const Page *table = leaf->pages[c];
+                return table->slots[__builtin_ctzll(table->populated)];
+            }
+        }
+    }
+    return high_;
+}
+
+AllocationRecord *RecordPageMap::LastUpTo(uintptr_t page) const
+{
+    size_t root = RootIndex(page);
+    for (size_t a = PrevSet(populated_, root); a < kFanout; a = a ? PrevSet(populated_, a - 1) : kFanout)
+    {
+        const Interior *interior = interiors_[a];
+        size_t b_upto = a == root ? InteriorIndex(page) : kFanout - 1;
+        for (size_t b = PrevSet(interior->populated, b_upto); b < kFanout;
+             b = b ? PrevSet(interior->populated, b - 1) : kFanout)
+        {
+            const Leaf *leaf = interior->leaves[b];
+            size_t c = PrevSet(leaf->populated, a == root && b == InteriorIndex(page) ? LeafIndex(page) : kFanout - 1);
+            if (c < kFanout)
+            {
+                const Page *table = leaf->pages[c];
+                return ChainEnd(table->slots[63 - __builtin_clzll(table->populated)]);
+            }
+        }
+    }
+    return nullptr;
+}
+
+// The overflow list is walked; it only holds what the tree can't
+AllocationRecord *RecordPageMap::FloorHigh(uintptr_t addr) const
+{
+    AllocationRecord *floor = nullptr;
+    for (AllocationRecord *current = high_; current && AddressOf(current) <= addr; current = current->next)
+    {
+        floor = current;
+    }
+    return floor ? floor : LastUpTo(kPageMask);
+}
+
+AllocationRecord *RecordPageMap::Floor(uintptr_t addr) const
+{
+    if (addr >= kAddressLimit)
+    {
+        return FloorHigh(addr);
+    }
+
+    uintptr_t page = PageOf(addr);
+    const Page *table = PageAt(page);
+    if (table)
+    {
+        size_t slot = SlotOf(addr);
+        AllocationRecord *current = table->slots[slot];
+        if (current && AddressOf(current) <= addr)
+        {
+            while (current->next && AddressOf(current->next) <= addr)
+            {
+                current = current->next;
+            }
+            return current;
+        }
+        // Last populated slot before this one
+        uint64_t before = table->populated & ((uint64_t(1) << slot) - 1);
+        if (before)
+        {
+            return ChainEnd(table->slots[63 - __builtin_clzll(before)]);
+        }
+    }
+    return page ? LastUpTo(page - 1) : nullptr;
+}
+
+AllocationRecord *RecordPageMap::First() const
+{
+    return FirstFrom(0);
+}
+
+AllocationRecord *RecordPageMap::Next(const AllocationRecord *record) const
+{
+    if (record->next)
+    {
+        return record->next;
+    }
+    uintptr_t addr = AddressOf(record);
+    if (addr >= kAddressLimit)
+    {
+        return nullptr;
+    }
+    // Next populated slot in the same page
+    const Page *table = PageAt(PageOf(addr));
+    size_t slot = SlotOf(addr);
+    uint64_t after = slot + 1 < kPageSlots ? table->populated & (~uint64_t(0) << (slot + 1)) : 0;
+    if (after)
+    {
+        return table->slots[__builtin_ctzll(after)];
+    }
+    return FirstFrom(PageOf(addr) + 1);
+}
+
+void RecordPageMap::Clear(void (*release)(AllocationRecord *record))
+{
+    for (size_t a = NextSet(populated_, 0); a < kFanout; a = NextSet(populated_, a + 1))
+    {
+        Interior *interior = interiors_[a];
+        for (size_t b = NextSet(interior->populated, 0); b < kFanout; b = NextSet(interior->populated, b + 1))
+        {
+            Leaf *leaf = interior->leaves[b];
+            for (size_t c = NextSet(leaf->populated, 0); c < kFanout; c = NextSet(leaf->populated, c + 1))
+            {
+                Page *table = leaf->pages[c];
+                for (uint64_t slots = table->populated; slots; slots &= slots - 1)
+                {
+                    AllocationRecord *current = table->slots[__builtin_ctzll(slots)];
+                    while (current)
+                    {
+                        AllocationRecord *next = current->next;
+                        release(current);
+                        current = next;
+                    }
+                }
+                RawFree(table);
+                leaf->pages[c] = nullptr;
+                mapped_bytes_ -= sizeof(Page);
+            }
+            std::memset(leaf->populated, 0, sizeof(leaf->populated));
+            leaf->used = 0;
+        }
+        std::memset(interior->populated, 0, sizeof(interior->populated));
+        interior->used = 0;
+    }
+    std::memset(populated_, 0, sizeof(populated_));
+
+    while (high_)
+    {
+        AllocationRecord *next = high_->next;
+        release(high_);
+        high_ = next;
+    }
+}
+
+} // namespace detail
+} // namespace ctracker
+
+#endif
@@ -0,0 +1,99 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+namespace ctracker
+{
+namespace detail
+{
+
+bool Quarantine::Find(const void *ptr, QuarantineEntry *out)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t filled = next_ < kSize ? next_ : kSize;
+    for (size_t i = 1; i <= filled; i++)
+    {
+        const QuarantineEntry &entry = entries_[(next_ - i) & (kSize - 1)];
+        if (entry.ptr == ptr)
+        {
+            *out = entry;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Quarantine::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    next_ = 0;
+    for (size_t i = 0; i < kSize; i++)
+    {
+        entries_[i] = QuarantineEntry();
+    }
+}
+
+std::atomic<uintptr_t> *SkippedBlocks::Bucket(const void *ptr)
+{
+    uint64_t hash = (reinterpret_cast<uintptr_t>(ptr) >> 4) * 0x9E3779B97F4A7C15ull;
+    return &slots_[(hash >> 55) % kBuckets * kWays];
+}
+
+void SkippedBlocks::Note(const void *ptr)
+{
+    uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+    if (!address)
+    {
+        return;
+    }
+    std::atomic<uintptr_t> *bucket = Bucket(ptr);
+    for (size_t i = 0; i < kWays; i++)
+    {
+        if (bucket[i].load(std::memory_order_relaxed) == address)
+        {
+            return; // a stale entry for a block freed without being forgotten
+        }
+    }
+    for (size_t i = 0; i < kWays; i++)
+    {
+        uintptr_t empty = 0;
+        if (bucket[i].compare_exchange_strong(empty, address, std::memory_order_relaxed))
+        {
+            return;
+        }
+    }
+    overflowed_.store(true, std::memory_order_relaxed);
+}
+
+bool SkippedBlocks::Forget(const void *ptr)
+{
+    uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+    if (!address)
+    {
+        return false;
+    }
+    std::atomic<uintptr_t> *bucket = Bucket(ptr);
+    for (size_t i = 0; i < kWays; i++)
+    {
+        uintptr_t expected = address;
+        if (bucket[i].compare_exchange_strong(expected, 0, std::memory_order_relaxed))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SkippedBlocks::Clear()
+{
+    for (std::atomic<uintptr_t> &slot : slots_)
+    {
+        slot.store(0, std::memory_order_relaxed);
+    }
+    overflowed_.store(false, std::memory_order_relaxed);
+}
+
+} // namespace detail
+} // namespace ctracker
+
+#endif
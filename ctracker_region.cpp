@@ -0,0 +1,244 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+#include <cstring>
+#include <unistd.h>
+
+#if C_TRACKER_MMAP_HOOKS
+#include <cstdarg>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifndef MREMAP_DONTUNMAP
+#define MREMAP_DONTUNMAP 4 // Linux 5.7, missing from older headers
+#endif
+#endif
+
+namespace ctracker
+{
+namespace detail
+{
+
+namespace
+{
+
+const size_t kInitialRegions = 16;
+
+} // namespace
+
+RegionMap::RegionMap()
+    : regions_(nullptr), count_(0), capacity_(0), bytes_(0), page_size_(static_cast<size_t>(sysconf(_SC_PAGESIZE)))
+{
+}
+
+RegionMap::~RegionMap()
+{
+    RawFree(regions_);
+}
+
+size_t RegionMap::LowerBound(uintptr_t addr) const
+{
+    size_t lo = 0;
+    size_t hi = count_;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (regions_[mid].start + regions_[mid].length <= addr)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool RegionMap::Reserve(size_t count)
+{
+    if (count <= capacity_)
+    {
+        return true;
+    }
+
+    size_t capacity = capacity_ ? capacity_ * 2 : kInitialRegions;
+    Region *regions = static_cast<Region *>(RawRealloc(regions_, capacity * sizeof(Region)));
+    if (!regions)
+    {
+        return false;
+    }
+    regions_ = regions;
+    capacity_ = capacity;
+    return true;
+}
+
+bool RegionMap::Insert(uintptr_t start, size_t length, ctracker::CallSite *site, uintptr_t chunk)
+{
+    length = (length + page_size_ - 1) & ~(page_size_ - 1);
+    if (length == 0)
+    {
+        return true;
+    }
+
+    size_t partial;
+    Remove(start, length, &partial);
+    if (!Reserve(count_ + 1))
+    {
+        return false;
+    }
+
+    size_t i = LowerBound(start);
+    std::memmove(regions_ + i + 1, regions_ + i, (count_ - i) * sizeof(Region));
+    regions_[i] = {start, length, site, chunk};
+    count_++;
+    bytes_ += length;
+    return true;
+}
+
+size_t RegionMap::Remove(uintptr_t start, size_t length, size_t *partial)
+{
+    *partial = 0;
+    length = (length + page_size_ - 1) & ~(page_size_ - 1);
+    uintptr_t end = start + length;
+    size_t removed = 0;
+
+    size_t i = LowerBound(start);
+    while (i < count_ && regions_[i].start < end)
+    {
+        Region &region = regions_[i];
+        uintptr_t region_end = region.start + region.length;
+
+        if (start <= region.start && region_end <= end)
+        {
+            removed += region.length;
+            std::memmove(regions_ + i, regions_ + i + 1, (count_ - i - 1) * sizeof(Region));
+            count_--;
+            continue;
+        }
+
+        (*partial)++;
+        if (region.start < start && end < region_end)
+        {
+            // Hole punched in the middle: split in two. If the array can't grow
+            // the tail is dropped from the registry.
+            region.length = start - region.start;
+            removed += end - start;
+            Region tail = {end, region_end - end, region.site, region.chunk};
+            if (Reserve(count_ + 1))
+            {
+                std::memmove(regions_ + i + 2, regions_ + i + 1, (count_ - i - 1) * sizeof(Region));
+                regions_[i + 1] = tail;
+                count_++;
+            }
+            else
+            {
+                removed += tail.length;
+            }
+            break;
+        }
+        if (region.start < start)
+        {
+            region.length = start - region.start;
+            removed += region_end - start;
+            i++;
+        }
+        else
+        {
+            removed += end - region.start;
+            region.length = region_end - end;
+            region.start = end;
+            break;
+        }
+    }
+
+    bytes_ -= removed;
+    return removed;
+}
+
+const Region *RegionMap::Find(uintptr_t addr) const
+{
+    size_t i = LowerBound(addr);
+    if (i < count_ && regions_[i].start <= addr)
+    {
+        return &regions_[i];
+    }
+    return nullptr;
+}
+
+void RegionMap::Clear()
+{
+    count_ = 0;
+    bytes_ = 0;
+}
+
+} // namespace detail
+} // namespace ctracker
+
+#if C_TRACKER_MMAP_HOOKS
+
+// Only direct calls are seen: glibc's own mmap()s use internal entry points.
+// Large malloc blocks it maps are recognized from their chunk header instead
+// (see MappedChunk); thread stacks are not tracked.
+extern "C"
+{
+
+void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
+{
+    void *result = reinterpret_cast<void *>(syscall(SYS_mmap, addr, length, prot, flags, fd, offset));
+    if (result != MAP_FAILED)
+    {
+        ctracker::detail::OnMap(result, length, __builtin_return_address(0));
+    }
+    return result;
+}
+
+#if defined(__GLIBC__) && !(defined(_FILE_OFFSET_BITS) && _FILE_OFFSET_BITS == 64)
+// The same call under its large-file name; with _FILE_OFFSET_BITS=64 the
+// headers already redirect mmap() to it
+void *mmap64(void *addr, size_t length, int prot, int flags, int fd, off64_t offset)
+{
+    void *result = reinterpret_cast<void *>(syscall(SYS_mmap, addr, length, prot, flags, fd, offset));
+    if (result != MAP_FAILED)
+    {
+        ctracker::detail::OnMap(result, length, __builtin_return_address(0));
+    }
+    return result;
+}
+#endif
+
+int munmap(void *addr, size_t length)
+{
+    int result = static_cast<int>(syscall(SYS_munmap, addr, length));
+    if (result == 0)
+    {
+        ctracker::detail::OnUnmap(addr, length);
+    }
+    return result;
+}
+
+void *mremap(void *old_addr, size_t old_length, size_t new_length, int flags, ...)
+{
+    void *new_addr = nullptr;
+    if (flags & MREMAP_FIXED)
+    {
+        va_list args;
+        va_start(args, flags);
+        new_addr = va_arg(args, void *);
+        va_end(args);
+    }
+
+    void *result = reinterpret_cast<void *>(syscall(SYS_mremap, old_addr, old_length, new_length, flags, new_addr));
+    if (result != MAP_FAILED)
+    {
+        ctracker::detail::OnRemap(old_addr, old_length, result, new_length, (flags & MREMAP_DONTUNMAP) != 0);
+    }
+    return result;
+}
+
+} // extern "C"
+
+#endif
+
+#endif
@@ -0,0 +1,136 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+// The controller runs on whichever thread's sampled hook timing finds a period
+// due, so it must not allocate or take the tracker lock.
+
+namespace ctracker
+{
+
+namespace
+{
+
+const uint64_t kAdaptPeriodNs = 100000000;
+const size_t kMaxAdaptiveInterval = 1 << 16;
+
+std::atomic<bool> adapting(false);
+std::atomic<uint64_t> next_adapt_ns(0);
+std::atomic<size_t> min_interval(1);
+std::atomic<size_t> overhead_seen_permille(0);
+std::atomic<uint64_t> adjustments(0);
+
+// The previous period's readings, only touched by the thread holding `adapting`
+uint64_t last_wall_ns = 0;
+uint64_t last_cpu_ns = 0;
+uint64_t last_ticks = 0;
+uint64_t last_hook_cycles = 0;
+
+// Interval that would bring `overhead` to `budget`, assuming tracking cost is
+// proportional to the sampling rate. Moves at most 4x up or 2x down per
+// period and holds within 20% of the budget, so it doesn't oscillate.
+size_t NextInterval(size_t interval, double overhead, double budget)
+{
+    double scale = overhead / budget;
+    if (scale > 0.8 && scale < 1.25)
+    {
+        return interval;
+    }
+    scale = scale < 0.5 ? 0.5 : (scale > 4 ? 4 : scale);
+
+    size_t next = static_cast<size_t>(static_cast<double>(interval) * scale + 0.5);
+    size_t floor = min_interval.load(std::memory_order_relaxed);
+    if (next < floor)
+    {
+        next = floor;
+    }
+    return next < kMaxAdaptiveInterval ? next : kMaxAdaptiveInterval;
+}
+
+} // namespace
+
+namespace detail
+{
+
+std::atomic<size_t> overhead_budget_permille(0);
+
+void AdaptSampling()
+{
+    uint64_t now = MonotonicNs();
+    if (now < next_adapt_ns.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    bool expected = false;
+    if (!adapting.compare_exchange_strong(expected, true, std::memory_order_acquire))
+    {
+        return;
+    }
+
+    uint64_t cpu = ClockNs(CLOCK_PROCESS_CPUTIME_ID);
+    uint64_t ticks = ReadCycles();
+    // Only one call in kCycleSampleInterval is timed
+    uint64_t hook_cycles = hook_cycles_total.load(std::memory_order_relaxed) * kCycleSampleInterval;
+    size_t budget = overhead_budget_permille.load(std::memory_order_relaxed);
+
+    if (last_wall_ns && budget && ticks > last_ticks && cpu > last_cpu_ns)
+    {
+        // The cycle counter's rate, calibrated against the monotonic clock
+        double ticks_per_ns = static_cast<double>(ticks - last_ticks) / static_cast<double>(now - last_wall_ns);
+        double tracking_ns = static_cast<double>(hook_cycles - last_hook_cycles) / ticks_per_ns;
+        double overhead = tracking_ns / static_cast<double>(cpu - last_cpu_ns);
+        overhead_seen_permille.store(static_cast<size_t>(overhead * 1000 + 0.5), std::memory_order_relaxed);
+
+        size_t interval = sample_interval.load(std::memory_order_relaxed);
+        size_t next = NextInterval(interval, overhead, static_cast<double>(budget) / 1000);
+        if (next != interval)
+        {
+            sample_interval.store(next, std::memory_order_relaxed);
+            adjustments.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    last_wall_ns = now;
+    last_cpu_ns = cpu;
+    last_ticks = ticks;
+    last_hook_cycles = hook_cycles;
+    next_adapt_ns.store(now + kAdaptPeriodNs, std::memory_order_relaxed);
+    adapting.store(false, std::memory_order_release);
+}
+
+} // namespace detail
+
+} // namespace ctracker
+
+void CTrackerMetrics::SetOverheadBudget(size_t permille)
+{
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    config_.overhead_budget_permille = permille;
+    ctracker::min_interval.store(config_.sample_interval, std::memory_order_relaxed);
+    ctracker::detail::overhead_budget_permille.store(permille, std::memory_order_relaxed);
+    if (!permille)
+    {
+        SetSampleInterval(config_.sample_interval);
+        ctracker::overhead_seen_permille.store(0, std::memory_order_relaxed);
+    }
+}
+
+ctracker::SamplingStats CTrackerMetrics::GetSamplingStats() const
+{
+    ctracker::SamplingStats stats = {};
+    stats.interval = SampleInterval();
+    stats.budget_permille = ctracker::detail::overhead_budget_permille.load(std::memory_order_relaxed);
+    stats.overhead_permille = ctracker::overhead_seen_permille.load(std::memory_order_relaxed);
+    stats.adjustments = ctracker::adjustments.load(std::memory_order_relaxed);
+
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    // A pending session purge would drop every record
+    if (registry_session_.load(std::memory_order_relaxed) == ctracker::detail::session.load(std::memory_order_acquire))
+    {
+        stats.estimated_live_count = ctracker::detail::LoadRelaxed(estimated_live_count_);
+        stats.estimated_live_bytes = ctracker::detail::LoadRelaxed(estimated_live_bytes_);
+    }
+    return stats;
+}
+
+#endif
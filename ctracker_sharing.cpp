@@ -0,0 +1,158 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+namespace
+{
+
+const size_t kPairSlots = 1024;
+const size_t kWindow = 8;
+
+struct SitePair
+{
+    ctracker::CallSite *a;
+    ctracker::CallSite *b;
+    size_t collisions;
+};
+
+// Fixed-size open addressing; pairs beyond 3/4 load are dropped
+void AddPair(SitePair *slots, size_t *used, ctracker::CallSite *a, ctracker::CallSite *b)
+{
+    if (b < a)
+    {
+        ctracker::CallSite *swap = a;
+        a = b;
+        b = swap;
+    }
+
+    uint64_t hash = (reinterpret_cast<uintptr_t>(a) * 0x9E3779B97F4A7C15ull) ^ reinterpret_cast<uintptr_t>(b);
+    size_t slot = static_cast<size_t>(hash ^ (hash >> 29)) & (kPairSlots - 1);
+    while (slots[slot].a)
+    {
+        if (slots[slot].a == a && slots[slot].b == b)
+        {
+            slots[slot].collisions++;
+            return;
+        }
+        slot = (slot + 1) & (kPairSlots - 1);
+    }
+
+    if ((*used + 1) * 4 > kPairSlots * 3)
+    {
+        return;
+    }
+    slots[slot] = {a, b, 1};
+    (*used)++;
+}
+
+// Allocations per second since the site's first one. A site that was busy long
+// ago and a counter churning now can have the same count; the rate tells them apart.
+double AllocationRate(const ctracker::CallSite *site, uint32_t now, uint64_t epoch_ms)
+{
+    double seconds = static_cast<double>(now - ctracker::detail::LoadRelaxed(site->first_epoch) + 1) * static_cast<double>(epoch_ms) / 1000.0;
+    return static_cast<double>(ctracker::detail::LoadRelaxed(site->allocations)) / seconds;
+}
+
+// A live block still touching the line being scanned
+struct Touch
+{
+    uintptr_t last_line;
+    uint32_t thread;
+    ctracker::CallSite *site;
+};
+
+} // namespace
+
+size_t CTrackerMetrics::GetFalseSharingRisks(ctracker::FalseSharingRisk *out, size_t max, size_t max_size)
+{
+    SitePair *slots = static_cast<SitePair *>(ctracker::detail::RawCalloc(kPairSlots, sizeof(SitePair)));
+    if (!slots)
+    {
+        return 0;
+    }
+    size_t used = 0;
+
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex_);
+    SyncSession();
+    ctracker::detail::EpochGuard epoch(skiplist_ != nullptr);
+
+    // Records come in address order, so only blocks still reaching the current
+    // line need to be remembered
+    Touch window[kWindow];
+    size_t filled = 0;
+    for (AllocationRecord *current = FirstRecord(); current; current = NextRecord(current))
+    {
+        if (current->size > max_size || !current->site)
+        {
+            continue;
+        }
+
+        uintptr_t start = reinterpret_cast<uintptr_t>(current->ptr);
+        uintptr_t first_line = start / ctracker::kCacheLineSize;
+        uintptr_t last_line = (start + (current->size ? current->size : 1) - 1) / ctracker::kCacheLineSize;
+
+        size_t kept = 0;
+        for (size_t i = 0; i < filled; i++)
+        {
+            if (window[i].last_line < first_line)
+            {
+                continue;
+            }
+            if (window[i].thread != current->thread)
+            {
+                AddPair(slots, &used, window[i].site, current->site);
+            }
+            window[kept++] = window[i];
+        }
+        filled = kept;
+
+        if (filled == kWindow)
+        {
+            filled--; // drop the oldest
+            for (size_t i = 0; i < filled; i++)
+            {
+                window[i] = window[i + 1];
+            }
+        }
+        window[filled++] = {last_line, current->thread, current->site};
+    }
+
+    // Top `max` by the sites' combined allocation rates
+    uint32_t now = ages_->Now();
+    size_t found = 0;
+    for (size_t slot = 0; slot < kPairSlots; slot++)
+    {
+        if (!slots[slot].a)
+        {
+            continue;
+        }
+
+        ctracker::FalseSharingRisk risk = {{slots[slot].a, slots[slot].b}, slots[slot].collisions, 0, 0};
+        risk.allocations = ctracker::detail::LoadRelaxed(slots[slot].a->allocations);
+        risk.allocations_per_second = AllocationRate(slots[slot].a, now, config_.age_epoch_ms);
+        if (slots[slot].b != slots[slot].a)
+        {
+            risk.allocations += ctracker::detail::LoadRelaxed(slots[slot].b->allocations);
+            risk.allocations_per_second += AllocationRate(slots[slot].b, now, config_.age_epoch_ms);
+        }
+
+        size_t i = found < max ? found++ : max;
+        while (i > 0 && out[i - 1].allocations_per_second < risk.allocations_per_second)
+        {
+            if (i < max)
+            {
+                out[i] = out[i - 1];
+            }
+            i--;
+        }
+        if (i < max)
+        {
+            out[i] = risk;
+        }
+    }
+
+    ctracker::detail::RawFree(slots);
+    return found;
+}
+
+#endif
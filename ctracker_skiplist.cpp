@@ -0,0 +1,336 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+#include <cstddef>
+
+// Lock-free skip list in the style of Herlihy & Shavit: a node is removed by
+// marking its next pointers top-down (the level 0 mark is the linearization
+// point), and whoever walks past a marked node snips it. Neither side waits
+// for the other. A remover marks whatever levels are there, and an inserter
+// sets a node's own next pointer by CAS before linking a level, so it stops at
+// the first marked one. Each side snips the node once it is done with it; the
+// last of the two to finish retires it.
+
+namespace ctracker
+{
+namespace detail
+{
+
+struct SkipNode
+{
+    uintptr_t key;
+    AllocationRecord *record;
+    std::atomic<uint32_t> state; // kInserted | kRemoved, whichever side is done
+    uint32_t height;
+    std::atomic<uintptr_t> next[1]; // `height` entries, low bit marks removal
+};
+
+namespace
+{
+
+const uintptr_t kMark = 1;
+
+const uint32_t kInserted = 1;
+const uint32_t kRemoved = 2;
+
+SkipNode *Unmarked(uintptr_t link)
+{
+    return reinterpret_cast<SkipNode *>(link & ~kMark);
+}
+
+bool Marked(uintptr_t link)
+{
+    return link & kMark;
+}
+
+size_t NodeBytes(uint32_t height)
+{
+    return offsetof(SkipNode, next) + height * sizeof(std::atomic<uintptr_t>);
+}
+
+// Ordered by address, ties (a stale record and its replacement) by record
+bool Before(const SkipNode *node, uintptr_t key, const AllocationRecord *record)
+{
+    return node->key < key ||
+           (node->key == key && reinterpret_cast<uintptr_t>(node->record) < reinterpret_cast<uintptr_t>(record));
+}
+
+// Geometric with p = 1/4
+uint32_t RandomHeight()
+{
+    static thread_local uint64_t state = 0;
+    if (!state)
+    {
+        state = reinterpret_cast<uintptr_t>(&state) * 0x9E3779B97F4A7C15ull | 1;
+    }
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    uint64_t bits = state;
+    uint32_t height = 1;
+    while (height < RecordSkipList::kMaxHeight && (bits & 3) == 0)
+    {
+        height++;
+        bits >>= 2;
+    }
+    return height;
+}
+
+} // namespace
+
+RecordSkipList::RecordSkipList() : head_(static_cast<SkipNode *>(RawCalloc(1, NodeBytes(kMaxHeight)))), node_bytes_(0)
+{
+    head_->height = kMaxHeight;
+}
+
+RecordSkipList::~RecordSkipList()
+{
+    SkipNode *node = Unmarked(head_->next[0].load(std::memory_order_relaxed));
+    while (node)
+    {
+        SkipNode *next = Unmarked(node->next[0].load(std::memory_order_relaxed));
+        RawFree(node);
+        node = next;
+    }
+    RawFree(head_);
+}
+
+SkipNode *RecordSkipList::NewNode(const void *ptr)
+{
+    uint32_t height = RandomHeight();
+    SkipNode *node = static_cast<SkipNode *>(RawMalloc(NodeBytes(height)));
+    if (!node)
+    {
+        return nullptr;
+    }
+    node->key = reinterpret_cast<uintptr_t>(ptr);
+    node->record = nullptr;
+    node->state.store(0, std::memory_order_relaxed);
+    node->height = height;
+    for (uint32_t level = 0; level < height; level++)
+    {
+        node->next[level].store(0, std::memory_order_relaxed);
+    }
+    return node;
+}
+
+void RecordSkipList::DropNode(SkipNode *node)
+{
+    RawFree(node);
+}
+
+// False if a snip lost a race and the search has to restart
+bool RecordSkipList::TryFind(uintptr_t key, const AllocationRecord *record, SkipNode **preds, SkipNode **succs)
+{
+    SkipNode *pred = head_;
+    for (size_t level = kMaxHeight; level-- > 0;)
+    {
+        SkipNode *curr = Unmarked(pred->next[level].load(std::memory_order_acquire));
+        while (curr)
+        {
+            uintptr_t succ = curr->next[level].load(std::memory_order_acquire);
+            if (Marked(succ))
+            {
+                uintptr_t expected = reinterpret_cast<uintptr_t>(curr);
+                if (!pred->next[level].compare_exchange_strong(expected, succ & ~kMark, std::memory_order_acq_rel))
+                {
+                    return false;
+                }
+                curr = Unmarked(succ);
+                continue;
+            }
+            if (!Before(curr, key, record))
+            {
+                break;
+            }
+            pred = curr;
+            curr = Unmarked(succ);
+        }
+        preds[level] = pred;
+        succs[level] = curr;
+    }
+    return true;
+}
+
+void RecordSkipList::Find(uintptr_t key, const AllocationRecord *record, SkipNode **preds, SkipNode **succs)
+{
+    while (!TryFind(key, record, preds, succs))
+    {
+    }
+}
+
+void RecordSkipList::Insert(SkipNode *node, AllocationRecord *record)
+{
+    node->record = record;
+    record->node = node;
+    node_bytes_.fetch_add(NodeBytes(node->height), std::memory_order_relaxed);
+
+    SkipNode *preds[kMaxHeight];
+    SkipNode *succs[kMaxHeight];
+    for (;;)
+    {
+        Find(node->key, record, preds, succs);
+        for (uint32_t level = 0; level < node->height; level++)
+        {
+            node->next[level].store(reinterpret_cast<uintptr_t>(succs[level]), std::memory_order_relaxed);
+        }
+        uintptr_t expected = reinterpret_cast<uintptr_t>(succs[0]);
+        if (preds[0]->next[0].compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(node),
+                                                      std::memory_order_release))
+        {
+            break;
+        }
+    }
+
+    // From here on a remover may mark the upper levels under us, so the node's
+    // own pointer is swung by CAS, which fails once it is marked
+    for (uint32_t level = 1; level < node->height; level++)
+    {
+        bool linked = false;
+        while (!linked)
+        {
+            uintptr_t own = node->next[level].load(std::memory_order_acquire);
+            if (Marked(own))
+            {
+                break;
+            }
+            if (Unmarked(own) != succs[level] &&
+                !node->next[level].compare_exchange_strong(own, reinterpret_cast<uintptr_t>(succs[level]),
+                                                           std::memory_order_acq_rel))
+            {
+                break; // marked since the load
+            }
+            uintptr_t expected = reinterpret_cast<uintptr_t>(succs[level]);
+            linked = preds[level]->next[level].compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(node),
+                                                                       std::memory_order_release);
+            if (!linked)
+            {
+                Find(node->key, record, preds, succs);
+                if (succs[0] != node)
+                {
+                    break; // removed and snipped at level 0 already
+                }
+            }
+        }
+        if (!linked)
+        {
+            break;
+        }
+    }
+
+    Finish(node, kInserted);
+}
+
+// Called by the inserter and the remover once each is done with the node. A
+// level linked after the remover's snip is taken out again here; the second
+// caller retires the node.
+void RecordSkipList::Finish(SkipNode *node, uint32_t done)
+{
+    if (Marked(node->next[0].load(std::memory_order_acquire)))
+    {
+        SkipNode *preds[kMaxHeight];
+        SkipNode *succs[kMaxHeight];
+        Find(node->key, node->record, preds, succs);
+    }
+    if (node->state.fetch_or(done, std::memory_order_acq_rel) & (kInserted | kRemoved) & ~done)
+    {
+        node_bytes_.fetch_sub(NodeBytes(node->height), std::memory_order_relaxed);
+        Retire(node);
+    }
+}
+
+bool RecordSkipList::RemoveNode(SkipNode *node)
+{
+    for (uint32_t level = node->height; level-- > 1;)
+    {
+        uintptr_t succ = node->next[level].load(std::memory_order_acquire);
+        while (!Marked(succ) &&
+               !node->next[level].compare_exchange_weak(succ, succ | kMark, std::memory_order_acq_rel))
+        {
+        }
+    }
+
+    uintptr_t succ = node->next[0].load(std::memory_order_acquire);
+    for (;;)
+    {
+        if (Marked(succ))
+        {
+            return false; // someone else removed it
+        }
+        if (node->next[0].compare_exchange_weak(succ, succ | kMark, std::memory_order_acq_rel))
+        {
+            break;
+        }
+    }
+
+    // Snip it from every level before it can be handed to the reclaimer
+    Finish(node, kRemoved);
+    return true;
+}
+
+bool RecordSkipList::Remove(AllocationRecord *record)
+{
+    return RemoveNode(record->node);
+}
+
+AllocationRecord *RecordSkipList::Floor(uintptr_t addr)
+{
+    // Everything at `addr` sorts before the largest record pointer
+    SkipNode *preds[kMaxHeight];
+    SkipNode *succs[kMaxHeight];
+    Find(addr, reinterpret_cast<const AllocationRecord *>(UINTPTR_MAX), preds, succs);
+    return preds[0] == head_ ? nullptr : preds[0]->record;
+}
+
+SkipNode *RecordSkipList::Live(SkipNode *node)
+{
+    while (node)
+    {
+        uintptr_t succ = node->next[0].load(std::memory_order_acquire);
+        if (!Marked(succ))
+        {
+            return node;
+        }
+        node = Unmarked(succ);
+    }
+    return nullptr;
+}
+
+AllocationRecord *RecordSkipList::First() const
+{
+    SkipNode *node = Live(Unmarked(head_->next[0].load(std::memory_order_acquire)));
+    return node ? node->record : nullptr;
+}
+
+AllocationRecord *RecordSkipList::Next(const AllocationRecord *record) const
+{
+    SkipNode *node = Live(Unmarked(record->node->next[0].load(std::memory_order_acquire)));
+    return node ? node->record : nullptr;
+}
+
+void RecordSkipList::Purge(void (*release)(AllocationRecord *record))
+{
+    SkipNode *node = Unmarked(head_->next[0].load(std::memory_order_acquire));
+    while (node)
+    {
+        AllocationRecord *record = node->record;
+        SkipNode *next = Unmarked(node->next[0].load(std::memory_order_acquire));
+        if (RemoveNode(node))
+        {
+            release(record);
+        }
+        node = next;
+    }
+}
+
+size_t RecordSkipList::MetadataBytes() const
+{
+    return NodeBytes(kMaxHeight) + node_bytes_.load(std::memory_order_relaxed);
+}
+
+} // namespace detail
+} // namespace ctracker
+
+#endif
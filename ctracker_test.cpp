@@ -1,5 +1,22 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <malloc.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <vector>
+#include <unistd.h>
 #include "ctracker.hpp"
+#include "ctracker_internal.hpp"
 
 // #define C_TRACKER_VERBOSE 1
 
@@ -178,6 +195,36 @@ TEST(CTrackerTest, RecordsAreSortedByAddress)
     delete[] c;
 }
 
+// The skip list and page map keep no list; every backend serves the ordered walk
+TEST(CTrackerTest, RegistryWalkIsSortedByAddress)
+{
+    int *a = new int[10];
+    int *b = new int[10];
+    int *c = new int[10];
+
+    auto *t = CTrackerMetrics::GetTracker();
+    ctracker::RegistryKind registry = t->GetConfig().registry;
+    if (registry == ctracker::RegistryKind::SkipList || registry == ctracker::RegistryKind::PageMap)
+    {
+        EXPECT_EQ(t->RecordsHead, nullptr);
+        EXPECT_EQ(t->RecordsTail, nullptr);
+    }
+
+    uintptr_t prev = 0;
+    size_t seen = 0;
+    t->ForEachInRange(nullptr, reinterpret_cast<void *>(UINTPTR_MAX), [&](const ctracker::Allocation &allocation)
+    {
+        EXPECT_LT(prev, reinterpret_cast<uintptr_t>(allocation.ptr));
+        prev = reinterpret_cast<uintptr_t>(allocation.ptr);
+        seen += allocation.ptr == a || allocation.ptr == b || allocation.ptr == c;
+    });
+    EXPECT_EQ(seen, 3u);
+
+    delete[] a;
+    delete[] b;
+    delete[] c;
+}
+
 // --- TotalAllocated ---
 
 TEST(CTrackerTest, TotalAllocatedMatchesKnownSizes)
@@ -194,3 +241,1797 @@ TEST(CTrackerTest, TotalAllocatedMatchesKnownSizes)
     delete[] x;
     delete[] y;
 }
+
+// --- Hot-path counters ---
+
+TEST(CTrackerTest, CountersSeeEveryNewAndDelete)
+{
+    uint64_t allocs_before = CTrackerMetrics::AllocationCount();
+    uint64_t frees_before = CTrackerMetrics::FreeCount();
+    uint64_t bytes_before = CTrackerMetrics::AllocatedBytes();
+
+    char *p = new char[48];
+    delete[] p;
+
+    EXPECT_GE(CTrackerMetrics::AllocationCount(), allocs_before + 1);
+    EXPECT_GE(CTrackerMetrics::FreeCount(), frees_before + 1);
+    EXPECT_GE(CTrackerMetrics::AllocatedBytes(), bytes_before + 48);
+}
+
+// --- Sampling ---
+
+TEST(CTrackerTest, SampleIntervalRecordsOneInN)
+{
+    auto before = TakeSnapshot();
+
+    CTrackerMetrics::SetSampleInterval(2);
+    int *a = new int[1];
+    int *b = new int[1];
+    int *c = new int[1];
+    int *d = new int[1];
+    CTrackerMetrics::SetSampleInterval(1);
+
+    EXPECT_EQ(CTrackerMetrics::GetTracker()->RecordCount, before.record_count + 2);
+
+    delete[] a;
+    delete[] b;
+    delete[] c;
+    delete[] d;
+
+    EXPECT_EQ(CTrackerMetrics::GetTracker()->RecordCount, before.record_count);
+}
+
+// --- Runtime switch ---
+
+TEST(CTrackerTest, DisabledAllocationsAreNotRecorded)
+{
+    uint64_t allocs_before = CTrackerMetrics::AllocationCount();
+
+    CTrackerMetrics::Disable();
+    char *p = new char[32];
+    CTrackerMetrics::Enable();
+
+    auto *t = CTrackerMetrics::GetTracker();
+    EXPECT_EQ(CTrackerMetrics::AllocationCount(), allocs_before);
+    EXPECT_EQ(t->TotalAllocated(), 0u); // new session
+    EXPECT_EQ(t->RecordCount, 0u);
+
+    // Freeing a pointer allocated while disabled is simply ignored
+    delete[] p;
+    EXPECT_EQ(t->RecordCount, 0u);
+}
+
+TEST(CTrackerTest, ReenablingDropsRecordsWithMissedFrees)
+{
+    char *p = new char[64];
+    auto *t = CTrackerMetrics::GetTracker();
+    EXPECT_GE(t->TotalAllocated(), 64u);
+
+    CTrackerMetrics::Disable();
+    delete[] p; // not seen by the tracker
+    CTrackerMetrics::Enable();
+
+    EXPECT_EQ(t->TotalAllocated(), 0u);
+    EXPECT_EQ(t->RecordCount, 0u);
+}
+
+TEST(CTrackerTest, ToggleSignalFlipsTracking)
+{
+    ASSERT_TRUE(CTrackerMetrics::InstallToggleSignal(SIGUSR2));
+    ASSERT_TRUE(CTrackerMetrics::IsEnabled());
+
+    std::raise(SIGUSR2);
+    EXPECT_FALSE(CTrackerMetrics::IsEnabled());
+
+    std::raise(SIGUSR2);
+    EXPECT_TRUE(CTrackerMetrics::IsEnabled());
+
+    std::signal(SIGUSR2, SIG_DFL);
+}
+
+// --- Configuration ---
+
+TEST(CTrackerTest, ParseConfigAppliesKnownKeys)
+{
+    const char text[] = "# tracker settings\n"
+                        "sample_interval = 64\n"
+                        "  shards=5 \n"
+                        "stack_depth = 4   # frames\n"
+                        "registry = list\n"
+                        "output_path = /tmp/ctracker.txt\n"
+                        "\n"
+                        "enabled = off\n";
+    ctracker::Config config;
+    EXPECT_TRUE(ctracker::ParseConfig(text, sizeof(text) - 1, &config));
+
+    EXPECT_EQ(config.sample_interval, 64u);
+    EXPECT_EQ(config.shards, 5u); // normalized only by LoadConfig
+    EXPECT_EQ(config.stack_depth, 4u);
+    EXPECT_EQ(config.registry, ctracker::RegistryKind::List);
+    EXPECT_STREQ(config.output_path, "/tmp/ctracker.txt");
+    EXPECT_FALSE(config.enabled);
+}
+
+TEST(CTrackerTest, ParseConfigRejectsUnknownKeysButKeepsTheRest)
+{
+    const char text[] = "no_such_knob = 1\nsample_interval = abc\nexport_interval_ms = 250\n";
+    ctracker::Config config;
+    EXPECT_FALSE(ctracker::ParseConfig(text, sizeof(text) - 1, &config));
+
+    EXPECT_EQ(config.sample_interval, 1u);
+    EXPECT_EQ(config.export_interval_ms, 250u);
+}
+
+TEST(CTrackerTest, ParseConfigRejectsOutOfRangeNumbers)
+{
+    const char text[] = "shards = 99999999999999999999\n"
+                        "toggle_signal = 4294967308\n"
+                        "dump_signal = 0\n";
+    ctracker::Config config;
+    EXPECT_FALSE(ctracker::ParseConfig(text, sizeof(text) - 1, &config));
+    EXPECT_EQ(config.shards, ctracker::Config().shards);
+    EXPECT_EQ(config.toggle_signal, 0);
+    EXPECT_EQ(config.dump_signal, 0);
+
+    const char valid[] = "shards = 18446744073709551615\ntoggle_signal = 12\n";
+    EXPECT_TRUE(ctracker::ParseConfig(valid, sizeof(valid) - 1, &config));
+    EXPECT_EQ(config.shards, SIZE_MAX);
+    EXPECT_EQ(config.toggle_signal, 12);
+}
+
+TEST(CTrackerTest, EffectiveConfigReflectsRuntimeState)
+{
+    CTrackerMetrics::SetSampleInterval(8);
+    ctracker::Config config = CTrackerMetrics::GetTracker()->GetConfig();
+    CTrackerMetrics::SetSampleInterval(1);
+
+    EXPECT_EQ(config.sample_interval, 8u);
+    EXPECT_TRUE(config.enabled);
+    EXPECT_GE(config.shards, 1u);
+}
+
+TEST(CTrackerTest, WriteReportEmitsMetrics)
+{
+    char path[] = "/tmp/ctracker_reportXXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+
+    EXPECT_TRUE(CTrackerMetrics::GetTracker()->WriteReport(fd));
+
+    char buffer[1024] = {};
+    ASSERT_GT(pread(fd, buffer, sizeof(buffer) - 1, 0), 0);
+    close(fd);
+    unlink(path);
+
+    EXPECT_NE(std::strstr(buffer, "records "), nullptr);
+    EXPECT_NE(std::strstr(buffer, "fragmentation_index "), nullptr);
+}
+
+// --- Crash dumps ---
+
+static std::string ReadDump(int fd)
+{
+    std::string text;
+    char buffer[4096];
+    ssize_t n;
+    for (off_t offset = 0; (n = pread(fd, buffer, sizeof(buffer), offset)) > 0; offset += n)
+    {
+        text.append(buffer, static_cast<size_t>(n));
+    }
+    return text;
+}
+
+TEST(CTrackerTest, CrashDumpListsCountersAndLiveSites)
+{
+    char path[] = "/tmp/ctracker_crashXXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+
+    char *block = new char[1 << 20];
+    EXPECT_TRUE(CTrackerMetrics::GetTracker()->WriteCrashDump(fd, 0));
+    delete[] block;
+
+    std::string dump = ReadDump(fd);
+    close(fd);
+    unlink(path);
+
+    EXPECT_NE(dump.find("crash_signal 0\n"), std::string::npos);
+    EXPECT_NE(dump.find("\nallocations "), std::string::npos);
+    EXPECT_NE(dump.find(".live_bytes "), std::string::npos);
+    EXPECT_NE(dump.find(".frames 0x"), std::string::npos);
+    EXPECT_NE(dump.find("\ncrash_dump_end 1\n"), std::string::npos);
+}
+
+TEST(CTrackerTest, DumpSignalWritesWithoutStopping)
+{
+    char path[] = "/tmp/ctracker_crashXXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+
+    ASSERT_TRUE(CTrackerMetrics::InstallCrashDump(fd, SIGUSR2));
+    EXPECT_FALSE(CTrackerMetrics::InstallCrashDump(fd, SIGSEGV));
+    ASSERT_TRUE(CTrackerMetrics::InstallCrashDump(fd, SIGUSR2));
+    std::raise(SIGUSR2);
+    ASSERT_TRUE(CTrackerMetrics::InstallCrashDump(-1));
+
+    std::string dump = ReadDump(fd);
+    close(fd);
+    unlink(path);
+
+    EXPECT_NE(dump.find("crash_signal " + std::to_string(SIGUSR2) + "\n"), std::string::npos);
+    EXPECT_NE(dump.find("\ncrash_dump_end 1\n"), std::string::npos);
+}
+
+TEST(CTrackerDeathTest, AbortWritesACrashDump)
+{
+    char path[] = "/tmp/ctracker_crashXXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+
+    EXPECT_DEATH(
+        {
+            CTrackerMetrics::InstallCrashDump(fd);
+            std::abort();
+        },
+        "");
+
+    std::string dump = ReadDump(fd);
+    close(fd);
+    unlink(path);
+
+    EXPECT_NE(dump.find("crash_signal " + std::to_string(SIGABRT) + "\n"), std::string::npos);
+    EXPECT_NE(dump.find("\ncrash_dump_end 1\n"), std::string::npos);
+}
+
+// Runs out of stack long before the bound
+static size_t Recurse(size_t depth)
+{
+    if (depth == SIZE_MAX)
+    {
+        return 0;
+    }
+    volatile char frame[1024];
+    frame[0] = static_cast<char>(depth);
+    return Recurse(depth + 1) + frame[0];
+}
+
+// The overflowing thread isn't the one that installed the handlers
+TEST(CTrackerDeathTest, StackOverflowOnAnotherThreadWritesACrashDump)
+{
+    char path[] = "/tmp/ctracker_crashXXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+
+    EXPECT_DEATH(
+        {
+            CTrackerMetrics::InstallCrashDump(fd);
+            std::thread([]
+            {
+                delete new int(1); // first tracked allocation sets up the stack
+                Recurse(0);
+            }).join();
+        },
+        "");
+
+    std::string dump = ReadDump(fd);
+    close(fd);
+    unlink(path);
+
+    EXPECT_NE(dump.find("crash_signal " + std::to_string(SIGSEGV) + "\n"), std::string::npos);
+    EXPECT_NE(dump.find("\ncrash_dump_end 1\n"), std::string::npos);
+}
+
+// --- Invalid-free detection ---
+
+static ctracker::InvalidFree last_invalid_free;
+static int invalid_free_reports = 0;
+
+static void CaptureInvalidFree(const ctracker::InvalidFree &report)
+{
+    last_invalid_free = report;
+    invalid_free_reports++;
+}
+
+// Starts a fresh session with detection on, so the quarantine is trustworthy
+static CTrackerMetrics *StartFreeCheck()
+{
+    CTrackerMetrics::Disable();
+    CTrackerMetrics::Enable();
+    auto *t = CTrackerMetrics::GetTracker();
+    t->SetFreeCheck(ctracker::FreeCheck::Report);
+    t->SetInvalidFreeHandler(CaptureInvalidFree);
+    invalid_free_reports = 0;
+    return t;
+}
+
+static void StopFreeCheck(CTrackerMetrics *t)
+{
+    t->SetFreeCheck(ctracker::FreeCheck::Off);
+    t->SetInvalidFreeHandler(nullptr);
+}
+
+TEST(CTrackerTest, RecordsCarryTheirCallSite)
+{
+    char *p = new char[24];
+
+    auto *t = CTrackerMetrics::GetTracker();
+    const ctracker::CallSite *site = nullptr;
+    for (AllocationRecord *cur = t->RecordsHead; cur; cur = cur->next)
+    {
+        if (cur->ptr == p)
+        {
+            site = cur->site;
+        }
+    }
+    ASSERT_NE(site, nullptr);
+    EXPECT_GE(site->depth, 1u);
+    EXPECT_GE(site->live_bytes, 24u);
+
+    delete[] p;
+}
+
+TEST(CTrackerTest, RegistryWalkCarriesTheCallSite)
+{
+    char *p = new char[24];
+
+    auto *t = CTrackerMetrics::GetTracker();
+    const ctracker::CallSite *site = nullptr;
+    t->ForEachInRange(p, p + 1, [&](const ctracker::Allocation &allocation)
+    {
+        if (allocation.ptr == p)
+        {
+            site = allocation.site;
+        }
+    });
+    ASSERT_NE(site, nullptr);
+    EXPECT_GE(site->depth, 1u);
+    EXPECT_GE(site->live_bytes, 24u);
+
+    delete[] p;
+}
+
+// A return address inside the function calling this
+__attribute__((noinline)) const void *ReturnAddress()
+{
+    return __builtin_return_address(0);
+}
+
+// Two growth loops in different functions; the loop bounds differ so the
+// compiler can't fold them into one
+__attribute__((noinline)) std::vector<int> *GrowOneVector(const void **here)
+{
+    *here = ReturnAddress();
+    auto *v = new std::vector<int>;
+    for (int i = 0; i < 1000; i++)
+    {
+        v->push_back(i);
+    }
+    return v;
+}
+
+__attribute__((noinline)) std::vector<int> *GrowAnotherVector(const void **here)
+{
+    *here = ReturnAddress();
+    auto *v = new std::vector<int>;
+    for (int i = 0; i < 1500; i++)
+    {
+        v->push_back(i);
+    }
+    return v;
+}
+
+// With one frame every vector<int> growth lands in the same libstdc++ frame
+TEST(CTrackerTest, VectorGrowthIsAttributedToTheGrowingFunction)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    const void *here[2];
+    std::vector<int> *vectors[2] = {GrowOneVector(&here[0]), GrowAnotherVector(&here[1])};
+
+    const ctracker::CallSite *sites[2] = {};
+    for (int i = 0; i < 2; i++)
+    {
+        ctracker::Allocation found = {};
+        ASSERT_TRUE(t->FindContaining(vectors[i]->data(), &found));
+        ASSERT_NE(found.site, nullptr);
+        sites[i] = found.site;
+
+        // Some frame returns into the growing function, near the marker call
+        bool attributed = false;
+        for (uint32_t frame = 0; frame < found.site->depth; frame++)
+        {
+            intptr_t distance = reinterpret_cast<intptr_t>(found.site->frames[frame]) - reinterpret_cast<intptr_t>(here[i]);
+            attributed = attributed || (distance > -1024 && distance < 1024);
+        }
+        EXPECT_TRUE(attributed) << "growth " << i << " not attributed to its function";
+    }
+    EXPECT_NE(sites[0], sites[1]);
+
+    delete vectors[0];
+    delete vectors[1];
+}
+
+TEST(CTrackerTest, InteriorFreeIsReportedAndSwallowed)
+{
+    auto *t = StartFreeCheck();
+    char *p = new char[64];
+
+    EXPECT_FALSE(t->CfreeTrack(p + 8));
+    EXPECT_EQ(invalid_free_reports, 1);
+    EXPECT_EQ(last_invalid_free.kind, ctracker::InvalidFreeKind::Interior);
+    EXPECT_EQ(last_invalid_free.block, p);
+    EXPECT_EQ(last_invalid_free.block_size, 64u);
+    EXPECT_NE(last_invalid_free.free_site, nullptr);
+
+    delete[] p;
+    StopFreeCheck(t);
+}
+
+TEST(CTrackerTest, DoubleFreeIsFoundInQuarantine)
+{
+    auto *t = StartFreeCheck();
+    uint64_t double_frees = t->GetInvalidFreeStats().double_frees;
+
+    char *p = new char[40];
+    delete[] p;
+
+    EXPECT_FALSE(t->CfreeTrack(p)); // must not reach free() again
+    EXPECT_EQ(invalid_free_reports, 1);
+    EXPECT_EQ(last_invalid_free.kind, ctracker::InvalidFreeKind::DoubleFree);
+    EXPECT_EQ(last_invalid_free.block_size, 40u);
+    EXPECT_NE(last_invalid_free.previous_free_caller, nullptr);
+    EXPECT_EQ(t->GetInvalidFreeStats().double_frees, double_frees + 1);
+
+    StopFreeCheck(t);
+}
+
+TEST(CTrackerTest, ValidFreeIsNotReported)
+{
+    auto *t = StartFreeCheck();
+
+    // Not from malloc, so the malloc hooks can't have recorded it already
+    alignas(16) char block[16];
+    t->CmallocTrack(block, sizeof(block));
+    EXPECT_TRUE(t->CfreeTrack(block));
+
+    EXPECT_EQ(invalid_free_reports, 0);
+    StopFreeCheck(t);
+}
+
+// A block allocated under the reentrancy guard never reaches the registry, and
+// freeing it later isn't an untracked free. Untracked frees are only reported
+// in a process tracked since startup, so this runs in a fresh one.
+TEST(CTrackerDeathTest, BlocksSkippedInsideTheTrackerFreeWithoutAReport)
+{
+    std::string style = testing::GTEST_FLAG(death_test_style);
+    testing::GTEST_FLAG(death_test_style) = "threadsafe";
+    EXPECT_EXIT(
+        {
+            auto *t = CTrackerMetrics::GetTracker();
+            t->SetFreeCheck(ctracker::FreeCheck::Report);
+            t->SetInvalidFreeHandler(CaptureInvalidFree);
+            int *held;
+            {
+                ctracker::ContextScope scope(ctracker::ContextId(0x054));
+                held = new int(1);
+            }
+            char *skipped = nullptr;
+            t->ForEachContext([&](const ctracker::ContextStats &)
+                              {
+                                  if (!skipped)
+                                  {
+                                      skipped = new char[24];
+                                  }
+                              });
+            delete[] skipped;
+            delete held;
+            if (!skipped || invalid_free_reports)
+            {
+                std::_Exit(1);
+            }
+
+            // Pointers the tracker never allocated are still reported
+            static char unknown[16];
+            t->CfreeTrack(unknown);
+            std::_Exit(invalid_free_reports == 1 && last_invalid_free.kind == ctracker::InvalidFreeKind::Untracked ? 0 : 2);
+        },
+        testing::ExitedWithCode(0), "");
+    testing::GTEST_FLAG(death_test_style) = style;
+}
+
+#if C_TRACKER_MALLOC_HOOKS
+TEST(CTrackerTest, HookedAlignedBlocksFreeCleanly)
+{
+    auto *t = StartFreeCheck();
+
+    void *blocks[6] = {};
+    blocks[0] = std::malloc(16);
+    ASSERT_EQ(posix_memalign(&blocks[1], 64, 100), 0);
+    blocks[2] = aligned_alloc(256, 512);
+    blocks[3] = memalign(128, 40);
+    blocks[4] = valloc(10);
+    blocks[5] = pvalloc(10);
+    for (void *block : blocks)
+    {
+        ASSERT_NE(block, nullptr);
+        EXPECT_TRUE(t->IsTracked(block));
+    }
+    EXPECT_EQ(t->SizeOf(blocks[5]), static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+
+    for (void *block : blocks)
+    {
+        std::free(block);
+        EXPECT_FALSE(t->IsTracked(block));
+    }
+    EXPECT_EQ(invalid_free_reports, 0);
+    StopFreeCheck(t);
+}
+#endif
+
+// --- Address queries ---
+
+TEST(CTrackerTest, FindContainingResolvesInteriorPointers)
+{
+    char *p = new char[100];
+    auto *t = CTrackerMetrics::GetTracker();
+
+    ctracker::Allocation found = {};
+    ASSERT_TRUE(t->FindContaining(p + 57, &found));
+    EXPECT_EQ(found.ptr, p);
+    EXPECT_EQ(found.size, 100u);
+
+    ASSERT_TRUE(t->FindContaining(p, &found));
+    EXPECT_EQ(found.ptr, p);
+
+    ctracker::Allocation other = {};
+    if (t->FindContaining(p + 100, &other))
+    {
+        EXPECT_NE(other.ptr, p); // one past the end belongs to someone else, if anyone
+    }
+
+    // Only the address is looked at once the block is gone
+    uintptr_t address = reinterpret_cast<uintptr_t>(p);
+    delete[] p;
+    if (t->FindContaining(reinterpret_cast<const void *>(address + 57), &found))
+    {
+        EXPECT_NE(reinterpret_cast<uintptr_t>(found.ptr), address);
+    }
+}
+
+TEST(CTrackerTest, ForEachInRangeVisitsOverlappingBlocksInOrder)
+{
+    int *a = new int[16];
+    int *b = new int[16];
+    int *c = new int[16];
+    auto *t = CTrackerMetrics::GetTracker();
+
+    int *lo = std::min({a, b, c});
+    int *hi = std::max({a, b, c});
+
+    // Start inside the lowest block so it is only partially covered
+    size_t visited = 0;
+    size_t ours = 0;
+    uintptr_t last = 0;
+    t->ForEachInRange(lo + 4, hi + 1, [&](const ctracker::Allocation &allocation)
+    {
+        EXPECT_GT(reinterpret_cast<uintptr_t>(allocation.ptr), last);
+        last = reinterpret_cast<uintptr_t>(allocation.ptr);
+        visited++;
+        if (allocation.ptr == a || allocation.ptr == b || allocation.ptr == c)
+        {
+            ours++;
+        }
+    });
+    EXPECT_EQ(ours, 3u);
+    EXPECT_GE(visited, 3u);
+
+    // Bytes in [lo + 4, hi + 1): 12 ints of the first block, one int of the last,
+    // plus whole blocks in between (the middle one and anyone else's)
+    size_t bytes = t->BytesInRange(lo + 4, hi + 1);
+    EXPECT_GE(bytes, sizeof(int) * (12 + 16 + 1));
+    EXPECT_EQ(t->BytesInRange(lo + 4, lo + 8), sizeof(int) * 4);
+    EXPECT_EQ(t->BytesInRange(lo, lo), 0u);
+
+    delete[] a;
+    delete[] b;
+    delete[] c;
+}
+
+// --- Pointer queries ---
+
+TEST(CTrackerTest, SizeOfReportsRequestedSize)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    char *p = new char[77];
+
+    EXPECT_TRUE(t->IsTracked(p));
+    EXPECT_EQ(t->SizeOf(p), 77u);
+    EXPECT_FALSE(t->IsTracked(p + 1)); // only the start of a block is indexed
+    EXPECT_EQ(t->SizeOf(p + 1), 0u);
+
+    // Only the address is looked up once the block is gone
+    volatile uintptr_t address = reinterpret_cast<uintptr_t>(p);
+    delete[] p;
+    EXPECT_FALSE(t->IsTracked(reinterpret_cast<const void *>(address)));
+    EXPECT_EQ(t->SizeOf(reinterpret_cast<const void *>(address)), 0u);
+    EXPECT_FALSE(t->IsTracked(nullptr));
+}
+
+TEST(CTrackerTest, SizeOfIsZeroWhileDisabled)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    char *p = new char[32];
+    ASSERT_EQ(t->SizeOf(p), 32u);
+
+    CTrackerMetrics::Disable();
+    EXPECT_FALSE(t->IsTracked(p));
+    CTrackerMetrics::Enable();
+
+    // New session: the old records are gone even before anything else is tracked
+    EXPECT_EQ(t->SizeOf(p), 0u);
+    delete[] p;
+}
+
+TEST(CTrackerTest, ReallocInPlaceResizesTheRecord)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    alignas(16) static char block[128];
+    void *p = block;
+    t->CmallocTrack(p, 64);
+    ctracker::ReallocStats before = t->GetReallocStats();
+    size_t live = t->TotalAllocated();
+
+    t->CreallocTrack(p, p, 128);
+    EXPECT_EQ(t->SizeOf(p), 128u);
+    EXPECT_EQ(t->TotalAllocated(), live + 64);
+    EXPECT_EQ(t->GetReallocStats().in_place, before.in_place + 1);
+    EXPECT_EQ(t->GetReallocStats().moved, before.moved);
+
+    t->CfreeTrack(p);
+}
+
+TEST(CTrackerTest, ReallocMoveRekeysTheRecord)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    alignas(16) static char blocks[2][256];
+    void *p = blocks[0];
+    void *q = blocks[1];
+    t->CmallocTrack(p, 64);
+    ctracker::ReallocStats before = t->GetReallocStats();
+    size_t records = (t->TotalAllocated(), t->RecordCount);
+
+    t->CreallocTrack(p, q, 256);
+    EXPECT_FALSE(t->IsTracked(p));
+    EXPECT_EQ(t->SizeOf(q), 256u);
+    EXPECT_EQ(t->RecordCount, records);
+    EXPECT_EQ(t->GetReallocStats().moved, before.moved + 1);
+    EXPECT_EQ(t->GetReallocStats().bytes_copied, before.bytes_copied + 64);
+
+    // Blocks the tracker never saw stay untracked
+    t->CreallocTrack(p, p, 32);
+    EXPECT_FALSE(t->IsTracked(p));
+
+    t->CfreeTrack(q);
+}
+
+#if C_TRACKER_MALLOC_HOOKS
+// Through the real realloc: whether glibc grows in place or moves is its call,
+// the counters have to agree with what it did
+TEST(CTrackerTest, HookedReallocCountsInPlaceAndMoved)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    char *p = static_cast<char *>(std::malloc(256));
+    ASSERT_NE(p, nullptr);
+    size_t records = (t->TotalAllocated(), t->RecordCount);
+
+    for (size_t size : {size_t(128), size_t(1) << 20, size_t(64)})
+    {
+        ctracker::ReallocStats before = t->GetReallocStats();
+        uintptr_t old_address = reinterpret_cast<uintptr_t>(p);
+        p = static_cast<char *>(std::realloc(p, size));
+        ASSERT_NE(p, nullptr);
+        bool moved = reinterpret_cast<uintptr_t>(p) != old_address;
+
+        ctracker::ReallocStats after = t->GetReallocStats();
+        EXPECT_EQ(after.in_place, before.in_place + (moved ? 0 : 1));
+        EXPECT_EQ(after.moved, before.moved + (moved ? 1 : 0));
+        EXPECT_EQ(t->SizeOf(p), size);
+        EXPECT_EQ(t->RecordCount, records);
+    }
+
+    std::free(p);
+    EXPECT_EQ(t->RecordCount, records - 1);
+}
+#endif
+
+// Straight to the kernel, so the mmap hooks leave the tracking to the test
+static void *MapPages(size_t length)
+{
+    return reinterpret_cast<void *>(
+        syscall(SYS_mmap, nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+}
+
+static void UnmapPages(void *addr, size_t length)
+{
+    syscall(SYS_munmap, addr, length);
+}
+
+TEST(CTrackerTest, PartialUnmapSplitsRegion)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    char *base = static_cast<char *>(MapPages(4 * page));
+    ASSERT_NE(base, MAP_FAILED);
+
+    ctracker::RegionStats before = t->GetRegionStats();
+    size_t records = (t->TotalAllocated(), t->RecordCount);
+    t->CmmapTrack(base, 4 * page - 1); // rounded up to whole pages
+    EXPECT_EQ(t->GetRegionStats().regions, before.regions + 1);
+    EXPECT_EQ(t->GetRegionStats().mapped_bytes, before.mapped_bytes + 4 * page);
+    EXPECT_EQ(t->RecordCount, records); // not part of the heap registry
+
+    // Punch out the second page: one region becomes two
+    UnmapPages(base + page, page);
+    t->CmunmapTrack(base + page, page);
+    ctracker::RegionStats after = t->GetRegionStats();
+    EXPECT_EQ(after.regions, before.regions + 2);
+    EXPECT_EQ(after.mapped_bytes, before.mapped_bytes + 3 * page);
+    EXPECT_EQ(after.partial_unmaps, before.partial_unmaps + 1);
+
+    UnmapPages(base, 4 * page);
+    t->CmunmapTrack(base, 4 * page);
+    after = t->GetRegionStats();
+    EXPECT_EQ(after.regions, before.regions);
+    EXPECT_EQ(after.mapped_bytes, before.mapped_bytes);
+    EXPECT_EQ(after.unmaps, before.unmaps + 2);
+}
+
+TEST(CTrackerTest, RemapMovesRegion)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    void *p = MapPages(page);
+    ASSERT_NE(p, MAP_FAILED);
+
+    ctracker::RegionStats before = t->GetRegionStats();
+    t->CmmapTrack(p, page);
+    void *q = reinterpret_cast<void *>(syscall(SYS_mremap, p, page, 16 * page, MREMAP_MAYMOVE, nullptr));
+    ASSERT_NE(q, MAP_FAILED);
+    t->CmremapTrack(p, page, q, 16 * page);
+
+    ctracker::RegionStats after = t->GetRegionStats();
+    EXPECT_EQ(after.regions, before.regions + 1);
+    EXPECT_EQ(after.mapped_bytes, before.mapped_bytes + 16 * page);
+    EXPECT_EQ(after.remaps, before.remaps + 1);
+
+    UnmapPages(q, 16 * page);
+    t->CmunmapTrack(q, 16 * page);
+    EXPECT_EQ(t->GetRegionStats().mapped_bytes, before.mapped_bytes);
+}
+
+#if defined(__GLIBC__)
+TEST(CTrackerTest, MappedMallocChunksAreRegionsNotHeapRecords)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    if (!ctracker::detail::glibc_chunks.load())
+    {
+        GTEST_SKIP() << "malloc is not glibc's";
+    }
+    // A fixed threshold: frees of mapped chunks would otherwise raise it. glibc
+    // still serves a request from free heap memory if it has enough, so the
+    // block is larger than the heap could have free; it is never touched.
+    mallopt(M_MMAP_THRESHOLD, 128 * 1024);
+    const size_t big_size = size_t(256) << 20;
+    ctracker::RegionStats before = t->GetRegionStats();
+    size_t total_before = t->TotalAllocated();
+
+    char *big = new char[big_size];
+    ctracker::RegionStats during = t->GetRegionStats();
+    EXPECT_EQ(during.regions, before.regions + 1);
+    EXPECT_GE(during.mapped_bytes, before.mapped_bytes + big_size);
+    EXPECT_EQ(during.chunk_maps, before.chunk_maps + 1);
+    EXPECT_EQ(t->TotalAllocated(), total_before);
+
+    delete[] big;
+    ctracker::RegionStats after = t->GetRegionStats();
+    EXPECT_EQ(after.regions, before.regions);
+    EXPECT_EQ(after.mapped_bytes, before.mapped_bytes);
+
+#if C_TRACKER_MALLOC_HOOKS
+    // A heap block grown into a mapping of its own moves registries
+    char *block = static_cast<char *>(std::malloc(64));
+    EXPECT_EQ(t->TotalAllocated(), total_before + 64);
+    block = static_cast<char *>(std::realloc(block, big_size));
+    ASSERT_NE(block, nullptr);
+    EXPECT_EQ(t->GetRegionStats().regions, before.regions + 1);
+    EXPECT_EQ(t->TotalAllocated(), total_before);
+    std::free(block);
+    EXPECT_EQ(t->GetRegionStats().regions, before.regions);
+#endif
+}
+#endif
+
+#if C_TRACKER_MMAP_HOOKS
+TEST(CTrackerTest, HookedMapUnmapAndRemap)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    ctracker::RegionStats before = t->GetRegionStats();
+
+    char *base = static_cast<char *>(mmap(nullptr, 4 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    ASSERT_NE(base, MAP_FAILED);
+    EXPECT_EQ(t->GetRegionStats().regions, before.regions + 1);
+    EXPECT_EQ(t->GetRegionStats().mapped_bytes, before.mapped_bytes + 4 * page);
+
+    ASSERT_EQ(munmap(base + page, page), 0);
+    ctracker::RegionStats after = t->GetRegionStats();
+    EXPECT_EQ(after.regions, before.regions + 2);
+    EXPECT_EQ(after.partial_unmaps, before.partial_unmaps + 1);
+
+    void *moved = mremap(base + 2 * page, 2 * page, 8 * page, MREMAP_MAYMOVE);
+    ASSERT_NE(moved, MAP_FAILED);
+    after = t->GetRegionStats();
+    EXPECT_EQ(after.remaps, before.remaps + 1);
+    EXPECT_EQ(after.mapped_bytes, before.mapped_bytes + 9 * page);
+
+    munmap(base, page);
+    munmap(moved, 8 * page);
+    after = t->GetRegionStats();
+    EXPECT_EQ(after.regions, before.regions);
+    EXPECT_EQ(after.mapped_bytes, before.mapped_bytes);
+}
+
+TEST(CTrackerTest, HookedRemapDontUnmapKeepsTheOldRegion)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    ctracker::RegionStats before = t->GetRegionStats();
+
+    void *p = mmap(nullptr, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_NE(p, MAP_FAILED);
+    void *q = mremap(p, 2 * page, 2 * page, MREMAP_MAYMOVE | MREMAP_DONTUNMAP);
+    if (q == MAP_FAILED)
+    {
+        munmap(p, 2 * page);
+        GTEST_SKIP() << "MREMAP_DONTUNMAP needs Linux 5.7";
+    }
+
+    ctracker::RegionStats after = t->GetRegionStats();
+    EXPECT_EQ(after.regions, before.regions + 2);
+    EXPECT_EQ(after.mapped_bytes, before.mapped_bytes + 4 * page);
+    EXPECT_EQ(after.remaps, before.remaps + 1);
+
+    munmap(p, 2 * page);
+    munmap(q, 2 * page);
+    EXPECT_EQ(t->GetRegionStats().mapped_bytes, before.mapped_bytes);
+}
+#endif
+
+struct Order : ctracker::Tracked<Order>
+{
+    char payload[40];
+};
+
+TEST(CTrackerTest, TrackedTypeCountsLiveObjects)
+{
+    ctracker::TypeStats before = Order::Stats();
+    EXPECT_STREQ(before.name, "Order");
+
+    Order *a = new Order;
+    Order *b = new Order;
+    Order *many = new Order[10];
+    ctracker::TypeStats live = Order::Stats();
+    EXPECT_EQ(live.live_count, before.live_count + 3);
+    EXPECT_GE(live.live_bytes, before.live_bytes + 12 * sizeof(Order));
+    EXPECT_EQ(live.allocations, before.allocations + 3);
+    // The underlying allocation is still tracked as usual
+    EXPECT_EQ(CTrackerMetrics::GetTracker()->SizeOf(a), sizeof(Order));
+
+    delete a;
+    delete b;
+    delete[] many;
+    ctracker::TypeStats after = Order::Stats();
+    EXPECT_EQ(after.live_count, before.live_count);
+    EXPECT_EQ(after.live_bytes, before.live_bytes);
+    EXPECT_EQ(after.frees, before.frees + 3);
+}
+
+TEST(CTrackerTest, ForEachTrackedTypeListsAllocatedTypes)
+{
+    delete new Order;
+
+    size_t live = ~size_t(0);
+    ctracker::ForEachTrackedType([&](const ctracker::TypeStats &stats)
+                                 {
+                                     if (std::strcmp(stats.name, "Order") == 0)
+                                     {
+                                         live = stats.live_count;
+                                     }
+                                 });
+    EXPECT_EQ(live, 0u);
+}
+
+// A minimal eager coroutine whose frames are attributed to RequestStage
+struct RequestStage
+{
+    struct promise_type : ctracker::TrackedFrame<RequestStage>
+    {
+        RequestStage get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() {}
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+static RequestStage RunStage(int value)
+{
+    volatile int local = value;
+    (void)local;
+    co_return;
+}
+
+TEST(CTrackerTest, CoroutineFramesAreCountedPerTag)
+{
+    using Stats = ctracker::FrameStats;
+    Stats before = RequestStage::promise_type::Stats();
+    EXPECT_STREQ(before.name, "RequestStage");
+
+    RequestStage a = RunStage(1);
+    RequestStage b = RunStage(2);
+    Stats live = RequestStage::promise_type::Stats();
+    EXPECT_EQ(live.live_count, before.live_count + 2);
+    EXPECT_EQ(live.frames, before.frames + 2);
+    EXPECT_GT(live.max_frame_size, 0u);
+
+    a.handle.destroy();
+    b.handle.destroy();
+    Stats after = RequestStage::promise_type::Stats();
+    EXPECT_EQ(after.live_count, before.live_count);
+    EXPECT_EQ(after.live_bytes, before.live_bytes);
+    EXPECT_EQ(after.frames_freed, before.frames_freed + 2);
+    EXPECT_GT(after.total_lifetime_ns, before.total_lifetime_ns);
+
+    bool listed = false;
+    ctracker::ForEachCoroutineType([&](const Stats &stats) { listed |= std::strcmp(stats.name, "RequestStage") == 0; });
+    EXPECT_TRUE(listed);
+}
+
+TEST(CTrackerTest, ContextScopeAttributesAllocations)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    const ctracker::ContextId tenant = 0x7e1a;
+
+    char *outside = new char[10];
+    char *inside;
+    {
+        ctracker::ContextScope scope(tenant);
+        EXPECT_EQ(ctracker::CurrentContext(), tenant);
+        inside = new char[100];
+    }
+    EXPECT_EQ(ctracker::CurrentContext(), 0u);
+
+    ctracker::ContextStats stats;
+    ASSERT_TRUE(t->GetContextStats(tenant, &stats));
+    EXPECT_EQ(stats.live_count, 1u);
+    EXPECT_EQ(stats.live_bytes, 100u);
+
+    ctracker::Allocation block;
+    ASSERT_TRUE(t->FindContaining(inside, &block));
+    EXPECT_EQ(block.context, tenant);
+    ASSERT_TRUE(t->FindContaining(outside, &block));
+    EXPECT_EQ(block.context, 0u);
+
+    delete[] inside;
+    delete[] outside;
+    EXPECT_FALSE(t->GetContextStats(tenant, &stats));
+}
+
+// Per-request IDs must not pile up once their memory is gone
+TEST(CTrackerTest, ContextsAreDroppedWithTheirLastBlock)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    const ctracker::ContextId first = 0x5eed0000;
+    const size_t contexts = 2000;
+
+    std::vector<char *> blocks(contexts);
+    for (size_t i = 0; i < contexts; i++)
+    {
+        ctracker::ContextScope scope(first + i);
+        blocks[i] = new char[8];
+    }
+    size_t metadata = t->GetOverheadStats().metadata_bytes;
+
+    // Freeing every other one shifts the survivors within their probe runs
+    for (size_t i = 0; i < contexts; i += 2)
+    {
+        delete[] blocks[i];
+    }
+    ctracker::ContextStats stats;
+    for (size_t i = 0; i < contexts; i++)
+    {
+        bool live = t->GetContextStats(first + i, &stats);
+        EXPECT_EQ(live, i % 2 == 1) << i;
+        if (live)
+        {
+            EXPECT_EQ(stats.live_count, 1u);
+        }
+    }
+
+    for (size_t i = 1; i < contexts; i += 2)
+    {
+        delete[] blocks[i];
+    }
+    size_t left = 0;
+    t->ForEachContext([&](const ctracker::ContextStats &stats)
+                      {
+                          left += stats.id >= first && stats.id < first + contexts;
+                      });
+    EXPECT_EQ(left, 0u);
+
+    // A second round reuses the freed slots
+    for (size_t i = 0; i < contexts; i++)
+    {
+        ctracker::ContextScope scope(first + contexts + i);
+        blocks[i] = new char[8];
+    }
+    EXPECT_LE(t->GetOverheadStats().metadata_bytes, metadata + 4096);
+    for (char *block : blocks)
+    {
+        delete[] block;
+    }
+}
+
+TEST(CTrackerTest, WithContextPropagatesAcrossThreads)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    const ctracker::ContextId request = 0xbeef01;
+
+    int *result = nullptr;
+    std::function<void()> task;
+    {
+        ctracker::ContextScope scope(request);
+        task = ctracker::WithContext([&] { result = new int(42); });
+    }
+    std::thread worker(task);
+    worker.join();
+
+    ctracker::ContextStats stats;
+    ASSERT_TRUE(t->GetContextStats(request, &stats));
+    EXPECT_EQ(stats.live_bytes, sizeof(int));
+    delete result;
+}
+
+TEST(CTrackerTest, AgeDistributionBucketsLiveBytes)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    const uint64_t forever = ~uint64_t(0);
+    ctracker::AgeDistribution before = t->GetAgeDistribution(forever, forever);
+
+    char *p = new char[100]; // size class 2: up to 256 bytes
+    ctracker::AgeDistribution young = t->GetAgeDistribution(forever, forever);
+    EXPECT_EQ(young.young.live_count, before.young.live_count + 1);
+    EXPECT_EQ(young.young.live_bytes, before.young.live_bytes + 100);
+    EXPECT_EQ(young.young.bytes_by_class[2], before.young.bytes_by_class[2] + 100);
+    EXPECT_EQ(young.old.live_bytes, 0u);
+
+    // Every live byte lands in exactly one generation
+    ctracker::AgeDistribution old = t->GetAgeDistribution(0, 0);
+    EXPECT_EQ(old.young.live_bytes, 0u);
+    EXPECT_EQ(old.middle.live_bytes, 0u);
+    EXPECT_EQ(old.old.live_bytes, young.young.live_bytes);
+    EXPECT_EQ(old.old.live_bytes, t->TotalAllocated());
+
+    delete[] p;
+    EXPECT_EQ(t->GetAgeDistribution(forever, forever).young.live_bytes, before.young.live_bytes);
+}
+
+TEST(CTrackerTest, ChurnPairsAreDetected)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    const size_t churn_size = 4093; // unlikely to collide with anything else
+    for (int i = 0; i < 1000; i++)
+    {
+        delete[] new char[churn_size];
+    }
+
+    ctracker::ChurnCandidate candidates[256];
+    size_t found = t->GetChurnCandidates(candidates, 256);
+    ASSERT_GT(found, 0u);
+
+    const ctracker::ChurnCandidate *pair = nullptr;
+    for (size_t i = 0; i < found; i++)
+    {
+        if (candidates[i].size == churn_size)
+        {
+            pair = &candidates[i];
+        }
+        if (i > 0)
+        {
+            EXPECT_GE(candidates[i - 1].frees_per_second, candidates[i].frees_per_second);
+        }
+    }
+    ASSERT_NE(pair, nullptr);
+    EXPECT_GE(pair->short_lived_frees, 1000u);
+    EXPECT_DOUBLE_EQ(pair->bytes_per_second, pair->frees_per_second * churn_size);
+}
+
+// Thousands of one-off pairs from one site keep evicting each other; none may
+// be credited with the frees of the pairs it replaced
+TEST(CTrackerTest, EvictingChurnPairsReportOnlyTheirOwnFrees)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    const size_t first_size = 20011;
+    const size_t pairs = 3000;
+    for (size_t size = first_size; size < first_size + pairs; size++)
+    {
+        delete[] new char[size];
+    }
+
+    ctracker::ChurnCandidate candidates[256];
+    size_t found = t->GetChurnCandidates(candidates, 256);
+    for (size_t i = 0; i < found; i++)
+    {
+        if (candidates[i].size >= first_size && candidates[i].size < first_size + pairs)
+        {
+            EXPECT_LE(candidates[i].short_lived_frees, 1u);
+        }
+    }
+}
+
+TEST(CTrackerTest, VectorGrowthIsReportedAsAChain)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    ctracker::GrowthSite before[256];
+    size_t before_count = t->GetGrowthSites(before, 256);
+
+    std::vector<int> values;
+    for (int i = 0; i < 1024; i++)
+    {
+        values.push_back(i); // capacity 1, 2, 4, ..., 1024: ten growth steps
+    }
+
+    ctracker::GrowthSite after[256];
+    size_t after_count = t->GetGrowthSites(after, 256);
+    ASSERT_GT(after_count, 0u);
+
+    // Find the site that grew, net of what earlier tests left behind
+    uint64_t steps = 0;
+    uint64_t copied = 0;
+    for (size_t i = 0; i < after_count; i++)
+    {
+        uint64_t prior_steps = 0;
+        uint64_t prior_copied = 0;
+        for (size_t j = 0; j < before_count; j++)
+        {
+            if (before[j].site == after[i].site)
+            {
+                prior_steps = before[j].steps;
+                prior_copied = before[j].bytes_copied;
+            }
+        }
+        if (after[i].steps - prior_steps > steps)
+        {
+            steps = after[i].steps - prior_steps;
+            copied = after[i].bytes_copied - prior_copied;
+        }
+    }
+    EXPECT_EQ(steps, 10u);
+    EXPECT_EQ(copied, (1024u - 1) * sizeof(int));
+}
+
+TEST(CTrackerTest, CacheLineSharedAcrossThreadsIsFlagged)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    // One 64-byte line, split between two threads' "allocations"
+    alignas(ctracker::kCacheLineSize) static char line[2 * ctracker::kCacheLineSize];
+    t->CmallocTrack(line, 16);
+    std::thread([&] { t->CmallocTrack(line + 32, 16); }).join();
+    t->CmallocTrack(line + ctracker::kCacheLineSize, 16); // next line, same thread as the first
+
+    ctracker::Allocation mine, theirs;
+    ASSERT_TRUE(t->FindContaining(line, &mine));
+    ASSERT_TRUE(t->FindContaining(line + 32, &theirs));
+
+    ctracker::FalseSharingRisk risks[256];
+    size_t found = t->GetFalseSharingRisks(risks, 256);
+
+    const ctracker::FalseSharingRisk *risk = nullptr;
+    for (size_t i = 0; i < found; i++)
+    {
+        if ((risks[i].sites[0] == mine.site && risks[i].sites[1] == theirs.site) ||
+            (risks[i].sites[0] == theirs.site && risks[i].sites[1] == mine.site))
+        {
+            risk = &risks[i];
+        }
+        if (i > 0)
+        {
+            EXPECT_GE(risks[i - 1].allocations_per_second, risks[i].allocations_per_second);
+        }
+    }
+    ASSERT_NE(risk, nullptr);
+    EXPECT_EQ(risk->collisions, 1u);
+    EXPECT_GT(risk->allocations_per_second, 0.0);
+
+    t->CfreeTrack(line);
+    t->CfreeTrack(line + 32);
+    t->CfreeTrack(line + ctracker::kCacheLineSize);
+}
+
+TEST(CTrackerTest, AlignmentReportCountsStraddlesAndPadding)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    ctracker::AlignmentReport before = t->GetAlignmentReport();
+
+    // A 32-byte object placed across a line boundary, tracked by hand
+    alignas(ctracker::kCacheLineSize) static char block[2 * ctracker::kCacheLineSize];
+    t->CmallocTrack(block + 48, 32);
+
+    void *wide = ::operator new(100, std::align_val_t(128)); // 28 bytes of padding
+
+    ctracker::AlignmentReport after = t->GetAlignmentReport();
+    EXPECT_EQ(after.records, before.records + 2);
+    EXPECT_EQ(after.line_straddles[1], before.line_straddles[1] + 1); // 32 bytes: class 1
+    EXPECT_EQ(after.padding_bytes[2], before.padding_bytes[2] + 28); // 100 bytes: class 2
+    EXPECT_EQ(after.over_aligned, before.over_aligned + 1);
+    EXPECT_EQ(after.extra_alignment_bytes, before.extra_alignment_bytes + 128 - __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+
+    ::operator delete(wide, std::align_val_t(128));
+    t->CfreeTrack(block + 48);
+    EXPECT_EQ(t->GetAlignmentReport().over_aligned, before.over_aligned);
+}
+
+TEST(CTrackerTest, OverheadStatsCountHookSamplesAndMetadata)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    ctracker::OverheadStats before = t->GetOverheadStats();
+
+    for (int i = 0; i < 1000; i++)
+    {
+        delete new int(i);
+    }
+
+    ctracker::OverheadStats after = t->GetOverheadStats();
+    // 2000 hooks sampled 1 in 64 per thread
+    EXPECT_GE(after.hook_samples, before.hook_samples + 2000 / ctracker::kCycleSampleInterval - 1);
+    EXPECT_GT(after.metadata_bytes, 0u);
+    EXPECT_GT(after.lock_acquisitions, before.lock_acquisitions);
+
+    uint64_t bucketed = 0;
+    for (size_t i = 0; i < ctracker::kCycleBuckets; i++)
+    {
+        bucketed += after.hook_cycles[i];
+    }
+    EXPECT_EQ(bucketed, after.hook_samples);
+}
+
+TEST(CTrackerTest, AllocationsInsideTheTrackerAreCountedAsSkipped)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    int *held;
+    {
+        ctracker::ContextScope scope(ctracker::ContextId(0x067));
+        held = new int(1); // keeps the context in the table
+    }
+    uint64_t before = t->GetOverheadStats().reentrant_skips;
+
+    size_t visited = 0;
+    t->ForEachContext([&](const ctracker::ContextStats &)
+                      {
+                          delete new int(2); // runs under the reentrancy guard
+                          visited++;
+                      });
+
+    EXPECT_GT(visited, 0u);
+    EXPECT_GE(t->GetOverheadStats().reentrant_skips, before + visited);
+    delete held;
+}
+
+TEST(CTrackerTest, AllocatorLatencyIsRecordedBySizeClassAndThread)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    uint32_t thread = ctracker::CurrentThreadId();
+    ctracker::LatencyHistogram class_before, thread_before;
+    ASSERT_TRUE(t->GetAllocatorLatency(ctracker::AllocatorOp::Malloc, 2, &class_before));
+    ASSERT_TRUE(t->GetThreadAllocatorLatency(ctracker::AllocatorOp::Free, thread, &thread_before));
+
+    t->SetAllocatorLatency(true, 0); // every call is an outlier
+    char *block = new char[100];     // size class 2
+    delete[] block;
+    t->SetAllocatorLatency(false, 1000000);
+
+    ctracker::LatencyHistogram class_after, thread_after;
+    t->GetAllocatorLatency(ctracker::AllocatorOp::Malloc, 2, &class_after);
+    t->GetThreadAllocatorLatency(ctracker::AllocatorOp::Free, thread, &thread_after);
+    EXPECT_EQ(class_after.calls, class_before.calls + 1);
+    EXPECT_EQ(class_after.outliers, class_before.outliers + 1);
+    EXPECT_EQ(thread_after.calls, thread_before.calls + 1);
+
+    ctracker::LatencyOutlier outliers[2];
+    ASSERT_EQ(t->GetLatencyOutliers(outliers, 2), 2u);
+    EXPECT_EQ(outliers[0].op, ctracker::AllocatorOp::Free);
+    EXPECT_GE(outliers[0].size, 100u); // usable size
+    EXPECT_EQ(outliers[1].op, ctracker::AllocatorOp::Malloc);
+    EXPECT_EQ(outliers[1].size, 100u);
+    EXPECT_EQ(outliers[1].thread, thread);
+
+    // Off again: nothing more is recorded
+    delete[] new char[100];
+    t->GetAllocatorLatency(ctracker::AllocatorOp::Malloc, 2, &class_before);
+    EXPECT_EQ(class_before.calls, class_after.calls);
+}
+
+TEST(CTrackerTest, LatencyPercentileUsesLogLinearBuckets)
+{
+    EXPECT_EQ(ctracker::LatencyBucketStart(3), 3u);
+    EXPECT_EQ(ctracker::LatencyBucketStart(4), 4u);
+    EXPECT_EQ(ctracker::LatencyBucketStart(8), 8u);
+    EXPECT_EQ(ctracker::LatencyBucketStart(9), 10u);
+
+    ctracker::LatencyHistogram histogram = {};
+    histogram.counts[36] = 99; // [1024, 1280)
+    histogram.counts[56] = 1;  // [32768, 40960)
+    histogram.calls = 100;
+    histogram.max_ns = 35000;
+    EXPECT_EQ(ctracker::LatencyPercentile(histogram, 50), 1280u);
+    EXPECT_EQ(ctracker::LatencyPercentile(histogram, 99), 1280u);
+    EXPECT_EQ(ctracker::LatencyPercentile(histogram, 100), 35000u);
+}
+
+TEST(CTrackerTest, TimedMutexCountsContendedAcquisitions)
+{
+    ctracker::detail::TimedMutex mutex;
+    mutex.lock();
+    std::thread waiter([&]
+                       {
+                           std::lock_guard<ctracker::detail::TimedMutex> lock(mutex);
+                       });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    mutex.unlock();
+    waiter.join();
+
+    std::lock_guard<ctracker::detail::TimedMutex> lock(mutex);
+    ctracker::LockStats stats = mutex.Stats();
+    EXPECT_EQ(stats.acquisitions, 3u);
+    EXPECT_EQ(stats.contended, 1u);
+    EXPECT_GE(stats.wait_ns, 10000000u);
+}
+
+TEST(CTrackerTest, ShardLocksCountAcquisitions)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    ctracker::LockStats before[256], after[256];
+    size_t shards = t->GetShardLockStats(before, 256);
+    ASSERT_GT(shards, 0u);
+
+    delete new int(1); // one insert, one remove
+
+    ASSERT_EQ(t->GetShardLockStats(after, 256), shards);
+    uint64_t acquired = 0;
+    for (size_t i = 0; i < shards; i++)
+    {
+        acquired += after[i].acquisitions - before[i].acquisitions;
+    }
+    EXPECT_GE(acquired, 2u);
+    EXPECT_GT(t->GetLockStats().acquisitions, 0u);
+}
+
+TEST(CTrackerTest, SampledRecordsAreWeightedByTheirInterval)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    ctracker::SamplingStats before = t->GetSamplingStats();
+
+    char *blocks[400];
+    CTrackerMetrics::SetSampleInterval(4);
+    for (char *&block : blocks)
+    {
+        block = new char[8];
+    }
+    CTrackerMetrics::SetSampleInterval(1);
+
+    ctracker::SamplingStats after = t->GetSamplingStats();
+    EXPECT_NEAR(static_cast<double>(after.estimated_live_count - before.estimated_live_count), 400, 4);
+    EXPECT_NEAR(static_cast<double>(after.estimated_live_bytes - before.estimated_live_bytes), 3200, 32);
+
+    for (char *block : blocks)
+    {
+        delete[] block;
+    }
+    EXPECT_EQ(t->GetSamplingStats().estimated_live_bytes, before.estimated_live_bytes);
+}
+
+TEST(CTrackerTest, SampleWeightsAboveThirtyTwoBitsAreKept)
+{
+    if (sizeof(size_t) < 8)
+    {
+        GTEST_SKIP() << "needs a 64-bit size_t";
+    }
+    auto *t = CTrackerMetrics::GetTracker();
+    ctracker::SamplingStats before = t->GetSamplingStats();
+
+    // The first allocation still counting down from an earlier interval is
+    // picked; the rest of these are skipped
+    const size_t interval = (size_t(1) << 32) + 3;
+    char *blocks[16];
+    CTrackerMetrics::SetSampleInterval(interval);
+    for (char *&block : blocks)
+    {
+        block = new char[8];
+    }
+    CTrackerMetrics::SetSampleInterval(1);
+
+    ctracker::SamplingStats after = t->GetSamplingStats();
+    EXPECT_EQ(after.estimated_live_count - before.estimated_live_count, interval);
+    EXPECT_EQ(after.estimated_live_bytes - before.estimated_live_bytes, 8 * interval);
+
+    for (char *block : blocks)
+    {
+        delete[] block;
+    }
+    EXPECT_EQ(t->GetSamplingStats().estimated_live_count, before.estimated_live_count);
+}
+
+#if defined(__x86_64__) || defined(__aarch64__)
+TEST(CTrackerTest, OverheadBudgetRaisesTheSampleInterval)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    t->SetOverheadBudget(1); // 0.1%: far below what a new/delete loop costs
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (CTrackerMetrics::SampleInterval() == 1 && std::chrono::steady_clock::now() < deadline)
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            delete new int(i);
+        }
+    }
+
+    ctracker::SamplingStats stats = t->GetSamplingStats();
+    t->SetOverheadBudget(0);
+
+    EXPECT_GT(stats.interval, 1u);
+    EXPECT_GT(stats.overhead_permille, 1u);
+    EXPECT_GT(stats.adjustments, 0u);
+    EXPECT_EQ(CTrackerMetrics::SampleInterval(), 1u);
+}
+#endif
+
+TEST(CTrackerTest, ConcurrentNewDeleteKeepsTheRegistryOrdered)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    size_t records_before = t->RecordCount;
+
+    {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; i++)
+        {
+            threads.emplace_back([]
+            {
+                std::vector<char *> blocks;
+                for (int round = 0; round < 2000; round++)
+                {
+                    blocks.push_back(new char[16 + round % 64]);
+                    if (round % 3 == 0)
+                    {
+                        delete[] blocks[blocks.size() / 2];
+                        blocks.erase(blocks.begin() + blocks.size() / 2);
+                    }
+                }
+                for (char *block : blocks)
+                {
+                    delete[] block;
+                }
+            });
+        }
+
+        // Walk while the writers run
+        for (int i = 0; i < 20; i++)
+        {
+            uintptr_t prev = 0;
+            t->ForEachInRange(nullptr, reinterpret_cast<void *>(UINTPTR_MAX), [&](const ctracker::Allocation &allocation)
+            {
+                EXPECT_LT(prev, reinterpret_cast<uintptr_t>(allocation.ptr));
+                prev = reinterpret_cast<uintptr_t>(allocation.ptr);
+            });
+        }
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    // With the malloc hooks each thread leaves its libc bookkeeping behind
+    EXPECT_LT(t->RecordCount, records_before + 16);
+    size_t walked = 0;
+    t->ForEachInRange(nullptr, reinterpret_cast<void *>(UINTPTR_MAX), [&](const ctracker::Allocation &)
+    {
+        walked++;
+    });
+    EXPECT_EQ(walked, t->RecordCount);
+}
+
+TEST(CTrackerTest, SkipListRetiredRecordsAreReclaimed)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    if (t->GetConfig().registry != ctracker::RegistryKind::SkipList)
+    {
+        GTEST_SKIP() << "run with CTRACKER_REGISTRY=skiplist";
+    }
+
+    for (int i = 0; i < 10000; i++)
+    {
+        delete new int(i);
+    }
+    // Freed records wait for the epoch to move on, not for the end of the run
+    EXPECT_GT(t->GetOverheadStats().retired_blocks, 0u);
+    EXPECT_LT(t->GetOverheadStats().retired_blocks, 1000u);
+}
+
+TEST(CTrackerTest, ContainingLookupsCrossPageBoundaries)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+
+    // Small blocks share pages, large ones span several
+    std::vector<char *> blocks;
+    std::vector<size_t> sizes;
+    for (size_t i = 0; i < 64; i++)
+    {
+        size_t size = i % 4 == 0 ? 3 * 4096 + i : 16 + i;
+        blocks.push_back(new char[size]);
+        sizes.push_back(size);
+    }
+
+    for (size_t i = 0; i < blocks.size(); i++)
+    {
+        for (size_t offset : {size_t(0), sizes[i] / 2, sizes[i] - 1})
+        {
+            ctracker::Allocation found = {};
+            ASSERT_TRUE(t->FindContaining(blocks[i] + offset, &found));
+            EXPECT_EQ(found.ptr, blocks[i]);
+            EXPECT_EQ(found.size, sizes[i]);
+        }
+        EXPECT_EQ(t->BytesInRange(blocks[i], blocks[i] + sizes[i]), sizes[i]);
+    }
+
+    uintptr_t prev = 0;
+    size_t ours = 0;
+    t->ForEachInRange(nullptr, reinterpret_cast<void *>(UINTPTR_MAX), [&](const ctracker::Allocation &allocation)
+    {
+        EXPECT_LT(prev, reinterpret_cast<uintptr_t>(allocation.ptr));
+        prev = reinterpret_cast<uintptr_t>(allocation.ptr);
+        ours += std::find(blocks.begin(), blocks.end(), allocation.ptr) != blocks.end();
+    });
+    EXPECT_EQ(ours, blocks.size());
+
+    for (char *block : blocks)
+    {
+        delete[] block;
+    }
+}
+
+TEST(CTrackerTest, AddressesAboveFortyEightBitsKeepTheirOwnRecords)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+
+    // Never dereferenced: with 5-level paging or pointer tags the upper bits
+    // are set, and a 48-bit page number would alias these onto low pages
+    const uintptr_t high = (uintptr_t(1) << 56) | 0x1000;
+    char *low = new char[64];
+    char *a = reinterpret_cast<char *>(high);
+    char *b = reinterpret_cast<char *>(high + 4096);
+    t->CmallocTrack(b, 32);
+    t->CmallocTrack(a, 64);
+
+    ctracker::Allocation found = {};
+    ASSERT_TRUE(t->FindContaining(a + 10, &found));
+    EXPECT_EQ(found.ptr, a);
+    ASSERT_TRUE(t->FindContaining(b + 31, &found));
+    EXPECT_EQ(found.ptr, b);
+    EXPECT_FALSE(t->FindContaining(a + 100, &found));
+    ASSERT_TRUE(t->FindContaining(low, &found));
+    EXPECT_EQ(found.ptr, low);
+    EXPECT_EQ(t->BytesInRange(reinterpret_cast<void *>(high & ~uintptr_t(0xFFF)), reinterpret_cast<void *>(UINTPTR_MAX)),
+              96u);
+
+    std::vector<void *> walked;
+    t->ForEachInRange(low, reinterpret_cast<void *>(UINTPTR_MAX), [&](const ctracker::Allocation &allocation)
+    {
+        walked.push_back(allocation.ptr);
+    });
+    ASSERT_GE(walked.size(), 3u);
+    EXPECT_EQ(walked.front(), low);
+    EXPECT_EQ(walked[walked.size() - 2], a);
+    EXPECT_EQ(walked.back(), b);
+
+    EXPECT_TRUE(t->CfreeTrack(a));
+    EXPECT_TRUE(t->CfreeTrack(b));
+    EXPECT_FALSE(t->FindContaining(a, &found));
+    delete[] low;
+}
+
+TEST(CTrackerTest, OccupancyBitmapMatchesTheRecordWalk)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    char *a = new char[100];
+    char *b = new char[4000];
+    char *c = new char[100];
+    delete[] b; // a gap of at least 4000 bytes, unless something else fills it
+
+    size_t total = t->TotalAllocated();
+    float fragmentation = t->FragmentationIndex();
+    size_t gap = t->FindLargestFreeBlock();
+
+    t->SetOccupancyBitmap(true);
+    size_t bitmap_total = t->TotalAllocated();
+    float bitmap_fragmentation = t->FragmentationIndex();
+    size_t bitmap_gap = t->FindLargestFreeBlock();
+
+    // Maintained across frees, not only built on enable
+    delete[] a;
+    size_t bitmap_total_after = t->TotalAllocated();
+    t->SetOccupancyBitmap(false);
+    size_t total_after = t->TotalAllocated();
+
+    EXPECT_EQ(bitmap_total, total);
+    EXPECT_EQ(bitmap_total_after, total_after);
+    EXPECT_NEAR(bitmap_fragmentation, fragmentation, 0.01f);
+    // Gaps start at the end of a block's last granule
+    EXPECT_LE(bitmap_gap, gap);
+    EXPECT_GE(bitmap_gap + 16, gap);
+    EXPECT_FALSE(t->OccupancyBitmapEnabled());
+
+    delete[] c;
+}
+
+TEST(CTrackerTest, OccupancyBitmapKeepsGranulesSharedWithANeighbour)
+{
+    ctracker::detail::OccupancyMap map;
+    map.SetEnabled(true);
+
+    // Never dereferenced; the map only looks at addresses
+    const uintptr_t base = uintptr_t(1) << 40;
+    const char *arena = reinterpret_cast<const char *>(base);
+    map.Add(arena, 24);       // granules 0-1
+    map.Add(arena + 24, 40);  // granules 1-3, sharing 1
+    map.Add(arena + 256, 16); // granule 16
+
+    map.Remove(arena, 24);
+    uintptr_t start, end;
+    ASSERT_TRUE(map.Span(&start, &end));
+    EXPECT_EQ(start, base + 16); // granule 1 is still the neighbour's
+    EXPECT_EQ(end, base + 272);
+    EXPECT_EQ(map.LargestGap(), 256u - 64u);
+    EXPECT_EQ(map.LiveBytes(), 56u);
+
+    map.Remove(arena + 24, 40);
+    ASSERT_TRUE(map.Span(&start, &end));
+    EXPECT_EQ(start, base + 256);
+    EXPECT_EQ(map.LargestGap(), 0u);
+
+    map.Remove(arena + 256, 16);
+    EXPECT_FALSE(map.Span(&start, &end));
+}
+
+TEST(CTrackerTest, OccupancyBitmapCountsManySharersOfOneGranule)
+{
+    ctracker::detail::OccupancyMap map;
+    map.SetEnabled(true);
+    const uintptr_t base = uintptr_t(1) << 40;
+    const char *arena = reinterpret_cast<const char *>(base);
+    map.Add(arena + 4096, 4096); // aligned: no sharer entries at all
+    size_t aligned_bytes = map.MetadataBytes();
+
+    // Zero-byte blocks all hold their first granule, more than a byte can count
+    for (int i = 0; i < 300; i++)
+    {
+        map.Add(arena + 8, 0);
+    }
+    for (int i = 0; i < 299; i++)
+    {
+        map.Remove(arena + 8, 0);
+    }
+    uintptr_t start, end;
+    ASSERT_TRUE(map.Span(&start, &end));
+    EXPECT_EQ(start, base);
+
+    map.Remove(arena + 8, 0);
+    ASSERT_TRUE(map.Span(&start, &end));
+    EXPECT_EQ(start, base + 4096);
+    // Only the shared granules cost anything beyond the bits
+    EXPECT_LT(map.MetadataBytes(), aligned_bytes + 1024);
+    EXPECT_LT(aligned_bytes, 16u * 1024);
+}
+
+TEST(CTrackerTest, SummariesRunWhileWritersResizeAndFree)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    size_t total_before = t->TotalAllocated();
+
+    {
+        std::atomic<bool> done(false);
+        std::vector<std::thread> writers;
+        for (int i = 0; i < 3; i++)
+        {
+            writers.emplace_back([t]
+            {
+                for (int round = 0; round < 3000; round++)
+                {
+                    char *p = new char[64];
+                    t->CreallocTrack(p, p, 32 + round % 64);
+                    delete[] p;
+                }
+            });
+        }
+        std::thread reader([&]
+        {
+            while (!done.load())
+            {
+                t->TotalAllocated();
+                t->FragmentationIndex();
+                t->FindLargestFreeBlock();
+            }
+        });
+        for (std::thread &writer : writers)
+        {
+            writer.join();
+        }
+        done = true;
+        reader.join();
+    }
+
+    EXPECT_EQ(t->TotalAllocated(), total_before);
+}
+
+TEST(CTrackerTest, SkipListSummariesSkipTheTrackerLock)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    if (t->GetConfig().registry != ctracker::RegistryKind::SkipList)
+    {
+        GTEST_SKIP() << "run with CTRACKER_REGISTRY=skiplist";
+    }
+
+    int *p = new int(1);
+    uint64_t before = t->GetLockStats().acquisitions;
+    t->TotalAllocated();
+    t->FragmentationIndex();
+    t->FindLargestFreeBlock();
+    uint64_t after = t->GetLockStats().acquisitions;
+    delete p;
+
+    EXPECT_EQ(after - before, 1u); // GetLockStats itself
+}
+
+TEST(CTrackerTest, SkipListWritersSkipTheTrackerLock)
+{
+    auto *t = CTrackerMetrics::GetTracker();
+    if (t->GetConfig().registry != ctracker::RegistryKind::SkipList)
+    {
+        GTEST_SKIP() << "run with CTRACKER_REGISTRY=skiplist";
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(4);
+    size_t total_before = t->TotalAllocated();
+    uint64_t before = t->GetLockStats().acquisitions;
+    for (int i = 0; i < 4; i++)
+    {
+        threads.emplace_back([] {
+            for (int j = 0; j < 2000; j++)
+            {
+                char *block = new char[16 + j % 64];
+                char *grown = static_cast<char *>(std::realloc(std::malloc(8), 64));
+                delete[] block;
+                std::free(grown);
+            }
+        });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    uint64_t after = t->GetLockStats().acquisitions;
+
+    EXPECT_EQ(after - before, 1u); // GetLockStats itself
+    EXPECT_EQ(t->TotalAllocated(), total_before);
+}
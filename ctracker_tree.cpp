@@ -0,0 +1,175 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+namespace ctracker
+{
+namespace detail
+{
+
+namespace
+{
+
+inline uintptr_t Key(const AllocationRecord *record)
+{
+    return reinterpret_cast<uintptr_t>(record->ptr);
+}
+
+inline int Height(const AllocationRecord *node)
+{
+    return node ? node->height : 0;
+}
+
+inline void UpdateHeight(AllocationRecord *node)
+{
+    int left = Height(node->left);
+    int right = Height(node->right);
+    node->height = (left > right ? left : right) + 1;
+}
+
+AllocationRecord *RotateRight(AllocationRecord *node)
+{
+    AllocationRecord *pivot = node->left;
+    node->left = pivot->right;
+    pivot->right = node;
+    UpdateHeight(node);
+    UpdateHeight(pivot);
+    return pivot;
+}
+
+AllocationRecord *RotateLeft(AllocationRecord *node)
+{
+    AllocationRecord *pivot = node->right;
+    node->right = pivot->left;
+    pivot->left = node;
+    UpdateHeight(node);
+    UpdateHeight(pivot);
+    return pivot;
+}
+
+AllocationRecord *Balance(AllocationRecord *node)
+{
+    UpdateHeight(node);
+    int balance = Height(node->left) - Height(node->right);
+    if (balance > 1)
+    {
+        if (Height(node->left->left) < Height(node->left->right))
+        {
+            node->left = RotateLeft(node->left);
+        }
+        return RotateRight(node);
+    }
+    if (balance < -1)
+    {
+        if (Height(node->right->right) < Height(node->right->left))
+        {
+            node->right = RotateRight(node->right);
+        }
+        return RotateLeft(node);
+    }
+    return node;
+}
+
+AllocationRecord *InsertAt(AllocationRecord *node, AllocationRecord *record, AllocationRecord **predecessor)
+{
+    if (!node)
+    {
+        return record;
+    }
+    if (Key(record) < Key(node))
+    {
+        node->left = InsertAt(node->left, record, predecessor);
+    }
+    else
+    {
+        *predecessor = node;
+        node->right = InsertAt(node->right, record, predecessor);
+    }
+    return Balance(node);
+}
+
+AllocationRecord *RemoveMin(AllocationRecord *node, AllocationRecord **min)
+{
+    if (!node->left)
+    {
+        *min = node;
+        return node->right;
+    }
+    node->left = RemoveMin(node->left, min);
+    return Balance(node);
+}
+
+AllocationRecord *RemoveAt(AllocationRecord *node, AllocationRecord *record)
+{
+    if (!node)
+    {
+        return nullptr;
+    }
+    if (node != record)
+    {
+        if (Key(record) < Key(node))
+        {
+            node->left = RemoveAt(node->left, record);
+        }
+        else
+        {
+            node->right = RemoveAt(node->right, record);
+        }
+        return Balance(node);
+    }
+
+    // Records are identities, so the successor is moved into place rather than copied
+    AllocationRecord *left = node->left;
+    AllocationRecord *right = node->right;
+    if (!right)
+    {
+        return left;
+    }
+    AllocationRecord *successor;
+    right = RemoveMin(right, &successor);
+    successor->left = left;
+    successor->right = right;
+    return Balance(successor);
+}
+
+} // namespace
+
+AllocationRecord *RecordTree::Insert(AllocationRecord *record)
+{
+    record->left = nullptr;
+    record->right = nullptr;
+    record->height = 1;
+
+    AllocationRecord *predecessor = nullptr;
+    root_ = InsertAt(root_, record, &predecessor);
+    return predecessor;
+}
+
+void RecordTree::Remove(AllocationRecord *record)
+{
+    root_ = RemoveAt(root_, record);
+}
+
+AllocationRecord *RecordTree::Floor(uintptr_t addr) const
+{
+    AllocationRecord *floor = nullptr;
+    AllocationRecord *node = root_;
+    while (node)
+    {
+        if (Key(node) <= addr)
+        {
+            floor = node;
+            node = node->right;
+        }
+        else
+        {
+            node = node->left;
+        }
+    }
+    return floor;
+}
+
+} // namespace detail
+} // namespace ctracker
+
+#endif
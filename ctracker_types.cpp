@@ -0,0 +1,160 @@
+#include "ctracker_internal.hpp"
+
+#if C_TRACKER
+
+#include <cstring>
+#include <new>
+
+namespace ctracker
+{
+
+namespace
+{
+
+std::atomic<detail::TypeCounters *> types_head(nullptr);
+std::atomic<detail::FrameCounters *> frames_head(nullptr);
+
+template <typename U>
+void StoreMax(std::atomic<U> &target, U value)
+{
+    U current = target.load(std::memory_order_relaxed);
+    while (current < value && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+// Pulls the type out of Tracked<T>::Signature()'s __PRETTY_FUNCTION__, e.g.
+// "static const char* ctracker::Tracked<T>::Signature() [with T = Order]"
+void TypeName(const char *signature, char *out)
+{
+    const char *begin = std::strstr(signature, "T = ");
+    if (!begin)
+    {
+        std::strncpy(out, signature, kMaxTypeName - 1);
+        out[kMaxTypeName - 1] = '\0';
+        return;
+    }
+    begin += 4;
+
+    const char *end = begin + std::strcspn(begin, ";]");
+    size_t length = static_cast<size_t>(end - begin);
+    if (length >= kMaxTypeName)
+    {
+        length = kMaxTypeName - 1;
+    }
+    std::memcpy(out, begin, length);
+    out[length] = '\0';
+}
+
+// Pushes node onto head the first time type is seen; the signature is
+// stored before the node becomes reachable
+template <typename Node>
+void RegisterOnce(std::atomic<Node *> &head, Node *node, detail::TypeCounters &type, const char *signature)
+{
+    if (type.registered.exchange(true, std::memory_order_acq_rel))
+    {
+        return;
+    }
+
+    type.signature = signature;
+    Node *current = head.load(std::memory_order_relaxed);
+    do
+    {
+        node->next = current;
+    } while (!head.compare_exchange_weak(current, node, std::memory_order_release, std::memory_order_relaxed));
+}
+
+} // namespace
+
+namespace detail
+{
+
+void RegisterType(TypeCounters *counters, const char *signature)
+{
+    RegisterOnce(types_head, counters, *counters, signature);
+}
+
+void ReadTypeStats(const TypeCounters &counters, const char *signature, TypeStats *out)
+{
+    // Read independently of each other: a racing new/delete could make live
+    // briefly negative, so clamp at zero
+    uint64_t frees = counters.frees.load(std::memory_order_relaxed);
+    size_t freed_bytes = counters.freed_bytes.load(std::memory_order_relaxed);
+    uint64_t allocations = counters.allocations.load(std::memory_order_relaxed);
+    size_t allocated_bytes = counters.allocated_bytes.load(std::memory_order_relaxed);
+
+    TypeName(signature, out->name);
+    out->allocations = allocations;
+    out->frees = frees;
+    out->live_count = allocations > frees ? static_cast<size_t>(allocations - frees) : 0;
+    out->live_bytes = allocated_bytes > freed_bytes ? allocated_bytes - freed_bytes : 0;
+}
+
+void *AllocateFrame(FrameCounters *counters, const char *signature, size_t size)
+{
+    RegisterOnce(frames_head, counters, counters->type, signature);
+
+    unsigned char *block = static_cast<unsigned char *>(::operator new(size + kFrameHeader));
+    uint64_t now = detail::MonotonicNs();
+    std::memcpy(block, &now, sizeof(now));
+
+    counters->type.allocations.fetch_add(1, std::memory_order_relaxed);
+    counters->type.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    StoreMax(counters->max_frame_size, size);
+    return block + kFrameHeader;
+}
+
+void FreeFrame(FrameCounters *counters, void *frame, size_t size)
+{
+    unsigned char *block = static_cast<unsigned char *>(frame) - kFrameHeader;
+    uint64_t allocated;
+    std::memcpy(&allocated, block, sizeof(allocated));
+    uint64_t lifetime = detail::MonotonicNs() - allocated;
+
+    counters->type.frees.fetch_add(1, std::memory_order_relaxed);
+    counters->type.freed_bytes.fetch_add(size, std::memory_order_relaxed);
+    counters->total_lifetime_ns.fetch_add(lifetime, std::memory_order_relaxed);
+    StoreMax(counters->max_lifetime_ns, lifetime);
+    ::operator delete(block);
+}
+
+void ReadFrameStats(const FrameCounters &counters, const char *signature, FrameStats *out)
+{
+    TypeStats type;
+    ReadTypeStats(counters.type, signature, &type);
+
+    std::memcpy(out->name, type.name, sizeof(out->name));
+    out->live_count = type.live_count;
+    out->live_bytes = type.live_bytes;
+    out->frames = type.allocations;
+    out->frames_freed = type.frees;
+    out->max_frame_size = counters.max_frame_size.load(std::memory_order_relaxed);
+    out->total_lifetime_ns = counters.total_lifetime_ns.load(std::memory_order_relaxed);
+    out->max_lifetime_ns = counters.max_lifetime_ns.load(std::memory_order_relaxed);
+}
+
+} // namespace detail
+
+void ForEachTrackedType(TypeVisitor visitor, void *context)
+{
+    for (detail::TypeCounters *current = types_head.load(std::memory_order_acquire); current; current = current->next)
+    {
+        TypeStats stats;
+        detail::ReadTypeStats(*current, current->signature, &stats);
+        visitor(stats, context);
+    }
+}
+
+void ForEachCoroutineType(FrameVisitor visitor, void *context)
+{
+    for (detail::FrameCounters *current = frames_head.load(std::memory_order_acquire); current; current = current->next)
+    {
+        FrameStats stats;
+        detail::ReadFrameStats(*current, current->type.signature, &stats);
+        visitor(stats, context);
+    }
+}
+
+} // namespace ctracker
+
+#endif